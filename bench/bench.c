@@ -0,0 +1,429 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "nfa.h"
+#include "dfa.h"
+#include "dfa_table.h"
+#include "dfa_parallel.h"
+#include "lazy_dfa.h"
+#include "glushkov.h"
+#include "stats.h"
+
+
+/* Benchmark of every stage of the pipeline over a parameterized corpus of
+ * patterns. Each measurement is repeated and the fastest run is reported as
+ * a JSON object per line, so the output can be diffed and post-processed
+ * easily. Every pattern of the corpus matches arbitrarily long texts, which
+ * are generated along with it to measure matching throughput. */
+
+
+/* A pattern in the corpus along with the text to be matched against it */
+struct bench_case
+{
+    const char *family;     /* name of the pattern family */
+    int n;                  /* size parameter of the family */
+    char *regexp;
+    char *text;             /* NUL terminated */
+    size_t text_len;
+};
+
+/* Growable string buffer for generating patterns and texts */
+struct strbuf
+{
+    char *s;
+    size_t length, capacity;
+};
+
+static void __strbuf_init(struct strbuf *buf)
+{
+    buf->capacity = 64;
+    buf->length   = 0;
+    buf->s        = (char*)malloc(buf->capacity);
+    buf->s[0]     = '\0';
+}
+
+static void __strbuf_append(struct strbuf *buf, const char *s, size_t len)
+{
+    while (buf->length + len + 1 > buf->capacity)
+    {
+        buf->capacity *= 2;
+        buf->s = (char*)realloc(buf->s, buf->capacity);
+    }
+
+    memcpy(buf->s + buf->length, s, len);
+    buf->length += len;
+    buf->s[buf->length] = '\0';
+}
+
+static void __strbuf_puts(struct strbuf *buf, const char *s) {
+    __strbuf_append(buf, s, strlen(s));
+}
+
+
+/* Deterministic pseudo random numbers, so that every run of the benchmark
+ * sees exactly the same texts */
+static unsigned long __rand_state = 1;
+
+static unsigned long __rand(void)
+{
+    __rand_state =
+        __rand_state * 6364136223846793005UL + 1442695040888963407UL;
+    return (__rand_state >> 33) & 0x7fffffff;
+}
+
+/* Text of len random characters in alphabet */
+static char *__random_text(const char *alphabet, size_t len)
+{
+    size_t n_chars = strlen(alphabet), i = 0;
+    char *text = (char*)malloc(len + 1);
+
+    for ( ; i < len; i++)  text[i] = alphabet[__rand() % n_chars];
+    text[len] = '\0';
+
+    return text;
+}
+
+/* The i-th word of the alternation family, words are 3 alnums long and all
+ * distinct for i < 26 * 26 * 10 */
+static void __word(int i, char *word)
+{
+    word[0] = (char)('a' + i % 26);
+    word[1] = (char)('a' + i / 26 % 26);
+    word[2] = (char)('0' + i / 676 % 10);
+    word[3] = '\0';
+}
+
+
+/* ((w0)|((w1)|(...|(wn-1))))+ : nested alternation of n words, the text is
+ * a sequence of random words. Words are parenthesized since alternation binds
+ * tighter than concatenation in our grammar. */
+static void __make_alternation(int n, size_t text_len, struct bench_case *bc)
+{
+    struct strbuf re, text;
+    char word[4];
+    int i;
+
+    __strbuf_init(&re);
+    __strbuf_puts(&re, "(");
+    for (i = 0; i < n; i++)
+    {
+        __word(i, word);
+        __strbuf_puts(&re, i + 1 < n ? "((" : "(");
+        __strbuf_puts(&re, word);
+        __strbuf_puts(&re, i + 1 < n ? ")|" : ")");
+    }
+    for (i = 0; i < n; i++)  __strbuf_puts(&re, ")");
+    __strbuf_puts(&re, "+");
+
+    __strbuf_init(&text);
+    while (text.length + 3 <= text_len)
+    {
+        __word((int)(__rand() % n), word);
+        __strbuf_puts(&text, word);
+    }
+
+    bc->regexp   = re.s;
+    bc->text     = text.s;
+    bc->text_len = text.length;
+}
+
+/* (a|b)*a(a|b)(a|b)... : the n-th symbol from the end is an a, the DFA of it
+ * has 2^(n+1) states */
+static void __make_exponential(int n, size_t text_len, struct bench_case *bc)
+{
+    struct strbuf re;
+    int i;
+
+    __strbuf_init(&re);
+    __strbuf_puts(&re, "(a|b)*a");
+    for (i = 0; i < n; i++)  __strbuf_puts(&re, "(a|b)");
+
+    bc->regexp   = re.s;
+    bc->text     = __random_text("ab", text_len);
+    bc->text_len = text_len;
+}
+
+/* (c0c1...cn-1)+ : a long literal, the text repeats it */
+static void __make_literal(int n, size_t text_len, struct bench_case *bc)
+{
+    static const char alnums[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    struct strbuf re, text;
+    int i;
+
+    __strbuf_init(&re);
+    __strbuf_puts(&re, "(");
+    for (i = 0; i < n; i++)  __strbuf_append(&re, alnums + i % 62, 1);
+    __strbuf_puts(&re, ")+");
+
+    __strbuf_init(&text);
+    while (text.length + n <= text_len)
+        __strbuf_append(&text, re.s + 1, n);
+
+    bc->regexp   = re.s;
+    bc->text     = text.s;
+    bc->text_len = text.length;
+}
+
+/* P0 = a, Pk = (Pk-1|ck)* : stars and alternations nested n levels deep */
+static void __make_nesting(int n, size_t text_len, struct bench_case *bc)
+{
+    struct strbuf re, alphabet;
+    char c[2] = {0, 0};
+    int i;
+
+    __strbuf_init(&re);
+    __strbuf_init(&alphabet);
+    for (i = 0; i < n; i++)  __strbuf_puts(&re, "(");
+    __strbuf_puts(&re, "a");
+    __strbuf_puts(&alphabet, "a");
+    for (i = 0; i < n; i++)
+    {
+        c[0] = (char)('b' + i % 25);
+        __strbuf_puts(&re, "|");
+        __strbuf_puts(&re, c);
+        __strbuf_puts(&re, ")*");
+        if (i < 25)  __strbuf_puts(&alphabet, c);
+    }
+
+    bc->regexp   = re.s;
+    bc->text     = __random_text(alphabet.s, text_len);
+    bc->text_len = text_len;
+    free(alphabet.s);
+}
+
+
+/* Families of patterns and the sizes each family is measured at */
+struct bench_family
+{
+    const char *name;
+    void (*make)(int n, size_t text_len, struct bench_case *bc);
+    int sizes[4];   /* terminated by 0 */
+};
+
+static const struct bench_family __families[] = {
+    {"alternation", __make_alternation, {16, 64, 256, 0}},
+    {"exponential", __make_exponential, {4, 8, 12, 0}},
+    {"literal",     __make_literal,     {64, 1024, 4096, 0}},
+    {"nesting",     __make_nesting,     {8, 32, 128, 0}},
+    {NULL, NULL, {0}}
+};
+
+
+/* Seconds elapsed since "since" */
+static double __elapsed(const struct stats_time *since)
+{
+    struct stats_time now;
+    stats_now(&now);
+    return now.wall - since->wall;
+}
+
+/* Print a measurement of a phase, throughput is printed if bytes != 0 */
+static void __report(const struct bench_case *bc, const char *phase,
+    double seconds, long states, size_t bytes)
+{
+    printf("{\"family\": \"%s\", \"n\": %d, \"phase\": \"%s\", "
+        "\"seconds\": %.6f", bc->family, bc->n, phase, seconds);
+
+    if (states >= 0)  printf(", \"states\": %ld", states);
+    if (bytes != 0)
+    {
+        printf(", \"bytes\": %lu, \"mb_per_s\": %.2f", (unsigned long) bytes,
+            seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+    }
+
+    printf("}\n");
+    fflush(stdout);
+}
+
+/* Measure every phase of the pipeline on the case, each phase is repeated
+ * reps times and the fastest run is reported */
+static void __run_case(const struct bench_case *bc, int reps, int n_threads,
+    FILE *fp_null)
+{
+    struct NFA nfa, reduced, lazy_nfa;
+    struct DFA *dfa, *dfa_opt, *dfa_deriv, *dfa_reduced;
+    struct DFA_table table;
+    struct lazy_DFA lazy;
+    struct glushkov_NFA glushkov;
+    struct stats_time since;
+    double best[13], t;
+    int rep, phase, is_matched = 0;
+
+    enum { CONSTRUCT, DETERMINIZE, REDUCE, DETERMINIZE_REDUCED, DERIVE,
+           MINIMIZE, DUMP, COMPILE, MATCH_TABLE, MATCH_PARALLEL,
+           MATCH_LAZY, MATCH_GLUSHKOV, MATCH_NFA, N_PHASES };
+
+    for (phase = 0; phase < N_PHASES; phase++)  best[phase] = 1e30;
+
+    /* the lazy DFA is created once, so its cache is warm after the first
+     * run and the fastest run shows the steady state */
+    lazy_nfa = reg_to_NFA(bc->regexp);
+    create_lazy_DFA(&lazy_nfa, LAZY_DFA_DEFAULT_MEMORY, &lazy);
+    create_glushkov_NFA(&lazy_nfa, &glushkov);
+
+    for (rep = 0; rep < reps; rep++)
+    {
+        /* parse and Thompson construction are done in a single pass */
+        stats_now(&since);
+        nfa = reg_to_NFA(bc->regexp);
+        if ((t = __elapsed(&since)) < best[CONSTRUCT])  best[CONSTRUCT] = t;
+
+        stats_now(&since);
+        dfa = NFA_to_DFA(&nfa);
+        if ((t = __elapsed(&since)) < best[DETERMINIZE]) best[DETERMINIZE] = t;
+
+        /* the same NFA reduced first, subset construction of it is timed
+         * apart from the reduction itself */
+        reduced = reg_to_NFA(bc->regexp);
+        stats_now(&since);
+        NFA_reduce(&reduced);
+        if ((t = __elapsed(&since)) < best[REDUCE])  best[REDUCE] = t;
+
+        stats_now(&since);
+        dfa_reduced = NFA_to_DFA(&reduced);
+        if ((t = __elapsed(&since)) < best[DETERMINIZE_REDUCED])
+            best[DETERMINIZE_REDUCED] = t;
+
+        /* the derivative engine goes from the regexp to a DFA at once */
+        stats_now(&since);
+        dfa_deriv = regs_to_DFA_by_derivatives(
+            (const char *const *) &bc->regexp, 1);
+        if ((t = __elapsed(&since)) < best[DERIVE])  best[DERIVE] = t;
+
+        stats_now(&since);
+        dfa_opt = DFA_optimize(dfa);
+        if ((t = __elapsed(&since)) < best[MINIMIZE])  best[MINIMIZE] = t;
+
+        stats_now(&since);
+        NFA_dump_graphviz_code(&nfa, fp_null);
+        DFA_dump_graphviz_code(dfa, fp_null);
+        DFA_dump_graphviz_code(dfa_opt, fp_null);
+        if ((t = __elapsed(&since)) < best[DUMP])  best[DUMP] = t;
+
+        stats_now(&since);
+        DFA_compile(dfa_opt, &table);
+        if ((t = __elapsed(&since)) < best[COMPILE])  best[COMPILE] = t;
+
+        stats_now(&since);
+        is_matched += DFA_match(&table, bc->text, bc->text_len);
+        if ((t = __elapsed(&since)) < best[MATCH_TABLE]) best[MATCH_TABLE] = t;
+
+        stats_now(&since);
+        is_matched += DFA_parallel_match(
+            &table, bc->text, bc->text_len, n_threads);
+        if ((t = __elapsed(&since)) < best[MATCH_PARALLEL])
+            best[MATCH_PARALLEL] = t;
+
+        stats_now(&since);
+        is_matched += lazy_DFA_match(&lazy, bc->text, bc->text_len);
+        if ((t = __elapsed(&since)) < best[MATCH_LAZY])  best[MATCH_LAZY] = t;
+
+        stats_now(&since);
+        is_matched += glushkov_NFA_match(&glushkov, bc->text, bc->text_len);
+        if ((t = __elapsed(&since)) < best[MATCH_GLUSHKOV])
+            best[MATCH_GLUSHKOV] = t;
+
+        stats_now(&since);
+        is_matched += NFA_pattern_match(&nfa, bc->text);
+        if ((t = __elapsed(&since)) < best[MATCH_NFA])  best[MATCH_NFA] = t;
+
+        if (rep + 1 < reps)
+        {
+            DFA_table_dispose(&table);
+            DFA_dispose(dfa);
+            DFA_dispose(dfa_deriv);
+            DFA_dispose(dfa_reduced);
+            DFA_dispose(dfa_opt);
+            NFA_dispose(&nfa);
+            NFA_dispose(&reduced);
+        }
+    }
+
+    /* all 5 matchers should agree with each other */
+    if (is_matched % (5 * reps) != 0)
+        fprintf(stderr, "%s/%d: matchers disagree\n", bc->family, bc->n);
+
+    __report(bc, "construct", best[CONSTRUCT], nfa.arena->n_states, 0);
+    __report(bc, "determinize", best[DETERMINIZE], dfa->n_states, 0);
+    __report(bc, "reduce", best[REDUCE], reduced.arena->n_states, 0);
+    __report(bc, "determinize_reduced", best[DETERMINIZE_REDUCED],
+        dfa_reduced->n_states, 0);
+    __report(bc, "derive", best[DERIVE], dfa_deriv->n_states, 0);
+    __report(bc, "minimize", best[MINIMIZE], dfa_opt->n_states, 0);
+    __report(bc, "dump", best[DUMP], -1, 0);
+    __report(bc, "compile", best[COMPILE], table.n_states, 0);
+    __report(bc, "match_table", best[MATCH_TABLE], -1, bc->text_len);
+    __report(bc, "match_parallel", best[MATCH_PARALLEL], -1,
+        bc->text_len);
+    __report(bc, "match_lazy", best[MATCH_LAZY], lazy.n_states,
+        bc->text_len);
+    __report(bc, "match_glushkov", best[MATCH_GLUSHKOV], glushkov.n_positions,
+        bc->text_len);
+    __report(bc, "match_nfa", best[MATCH_NFA], -1, bc->text_len);
+
+    DFA_table_dispose(&table);
+    DFA_dispose(dfa);
+    DFA_dispose(dfa_deriv);
+    DFA_dispose(dfa_reduced);
+    DFA_dispose(dfa_opt);
+    destroy_lazy_DFA(&lazy);
+    destroy_glushkov_NFA(&glushkov);
+    NFA_dispose(&lazy_nfa);
+    NFA_dispose(&nfa);
+    NFA_dispose(&reduced);
+}
+
+
+int main(int argc, char *argv[])
+{
+    const struct bench_family *family;
+    struct bench_case bc;
+    const char *only = NULL;
+    size_t text_len = 1 << 20;
+    int reps = 3, n_threads = 0, opt, i_size;
+    FILE *fp_null;
+
+    while ((opt = getopt(argc, argv, "r:t:f:j:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r': reps     = atoi(optarg);               break;
+        case 't': text_len = (size_t) atol(optarg);      break;
+        case 'f': only     = optarg;                     break;
+        case 'j': n_threads = atoi(optarg);              break;
+        default:
+            fprintf(stderr, "usage: %s [-r reps] [-t text_bytes] "
+                "[-f family] [-j threads]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1)  reps = 1;
+    if (n_threads < 1)  n_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1)  n_threads = 1;
+
+    if ( (fp_null = fopen("/dev/null", "w")) == NULL) {
+        perror("fopen /dev/null error"); exit(-1);
+    }
+
+    for (family = __families; family->name != NULL; family++)
+    {
+        if (only != NULL && strcmp(only, family->name) != 0)  continue;
+
+        for (i_size = 0; family->sizes[i_size] != 0; i_size++)
+        {
+            bc.family = family->name;
+            bc.n      = family->sizes[i_size];
+            family->make(bc.n, text_len, &bc);
+
+            __run_case(&bc, reps, n_threads, fp_null);
+            free(bc.regexp);
+            free(bc.text);
+        }
+    }
+
+    fclose(fp_null);
+    return 0;
+}
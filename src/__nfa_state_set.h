@@ -0,0 +1,58 @@
+#ifndef __NFA_STATE_SET_HEADER__
+#define __NFA_STATE_SET_HEADER__
+
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sset.h"
+
+
+/* A set of NFA states merged to a DFA state is kept as a bitset over NFA state
+ * ids, which is the canonical form of the set, so hashing and comparing sets
+ * both run on words. This header is shared by the subset construction and
+ * the lazy DFA. */
+
+/* num of words in a bitset of NFA states */
+#define NFA_STATE_SET_WORDS(n_states)  (((n_states) + 31) / 32)
+
+/* Test if NFA state id is in the bitset */
+#define BITSET_CONTAINS(bits, id)  (((bits)[(id) >> 5] >> ((id) & 31)) & 1)
+
+
+/* Hash a bitset of n_words words */
+static inline uint64_t __hash_bitset(const uint32_t *bits, int n_words)
+{
+    uint64_t h = 14695981039346656037ULL;   /* FNV-1a offset basis */
+    int i_word = 0;
+
+    for ( ; i_word < n_words; i_word++) {
+        h = (h ^ bits[i_word]) * 1099511628211ULL;
+    }
+
+    /* mix the high bits down since only the low bits are used to address
+     * the slots */
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93ULL;
+    h ^= h >> 32;
+
+    return h;
+}
+
+/* Convert a sparse set of NFA states to its canonical bitset form */
+static inline void __sparse_set_to_bitset(
+    const struct sparse_set *states, uint32_t *bits, int n_words)
+{
+    int i_state = 0, id;
+
+    memset(bits, 0, n_words * sizeof(uint32_t));
+    for ( ; i_state < states->length; i_state++)
+    {
+        id = states->dense[i_state];
+        bits[id >> 5] |= (uint32_t)1 << (id & 31);
+    }
+}
+
+
+
+#endif /* __NFA_STATE_SET_HEADER__ */
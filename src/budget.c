@@ -0,0 +1,58 @@
+#include "mem.h"
+#include "budget.h"
+
+
+/* messages of the errors */
+static const char *__error_strings[COMPILE_N_ERRORS] = {
+    "no error",
+    "unrecognized escape",
+    "no matching ')' found",
+    "no matching ']' found",
+    "invalid range in brackets",
+    "unexpected character",
+    "too many NFA states",
+    "too many DFA states",
+    "too many bytes allocated",
+    "out of memory",
+    "no patterns given"
+};
+
+
+/* Get a message describing the error */
+const char *compile_error_string(enum compile_error error)
+{
+    if ((int) error < 0 || error >= COMPILE_N_ERRORS)
+        return "unknown error";
+    return __error_strings[error];
+}
+
+/* Get the num of bytes the calling thread uses now, it is the base the
+ * bytes taken by a step of the compilation are counted from */
+size_t budget_bytes_base(void) {
+    return mem_get_usage()->current;
+}
+
+/* Check a compilation step against the budget, given the num of NFA and
+ * DFA states it has (0 if it doesn't build any) and the base of its bytes.
+ * It returns COMPILE_OK, or the error of the first limit exceeded. */
+enum compile_error budget_check(const struct compile_budget *budget,
+    int n_NFA_states, int n_DFA_states, size_t base)
+{
+    size_t growth;
+
+    if (budget == NULL)  return COMPILE_OK;
+
+    if (budget->max_NFA_states > 0 && n_NFA_states > budget->max_NFA_states)
+        return COMPILE_TOO_MANY_NFA_STATES;
+    if (budget->max_DFA_states > 0 && n_DFA_states > budget->max_DFA_states)
+        return COMPILE_TOO_MANY_DFA_STATES;
+
+    /* the usage may wrap around, and memory freed by the step may bring it
+     * below the base, which is a negative growth */
+    growth = mem_get_usage()->current - base;
+    if (budget->max_bytes > 0 && (ptrdiff_t) growth > 0 &&
+        growth > budget->max_bytes)
+        return COMPILE_TOO_MANY_BYTES;
+
+    return COMPILE_OK;
+}
@@ -0,0 +1,67 @@
+#ifndef __BUDGET_HEADER__
+#define __BUDGET_HEADER__
+
+
+#include <stddef.h>
+
+
+/* Limits on what compiling a regexp may take. The size of a DFA may be
+ * exponential in the length of its regexp, so a compilation given a budget
+ * stops once a limit is exceeded, frees what it has built so far and returns
+ * the error of that limit. A limit of 0 means unlimited, and so does a NULL
+ * budget. */
+struct compile_budget
+{
+    int max_NFA_states;     /* num of states of the NFA */
+    int max_DFA_states;     /* num of states of the DFA */
+    size_t max_bytes;       /* num of bytes a single step of the compilation
+                             * may hold at the same time */
+};
+
+/* Results of compilation */
+enum compile_error {
+    COMPILE_OK,                     /* no error */
+
+    /* the regexp is malformed */
+    COMPILE_BAD_ESCAPE,             /* unrecognized escape sequence */
+    COMPILE_UNMATCHED_PAREN,        /* no matching ')' */
+    COMPILE_UNMATCHED_BRACKET,      /* no matching ']' */
+    COMPILE_BAD_RANGE,              /* range like z-a in brackets */
+    COMPILE_UNEXPECTED_CHAR,        /* an operator where it can't be */
+
+    /* a limit of the budget is exceeded */
+    COMPILE_TOO_MANY_NFA_STATES,
+    COMPILE_TOO_MANY_DFA_STATES,
+    COMPILE_TOO_MANY_BYTES,
+
+    COMPILE_OUT_OF_MEMORY,          /* an allocation failed */
+    COMPILE_NO_PATTERNS,            /* a set of no regexps at all */
+
+    COMPILE_N_ERRORS
+};
+
+
+/* Check if the error is a limit exceeded rather than a malformed regexp, in
+ * which case the regexp may still be run by a cheaper engine */
+static inline int compile_error_is_limit(enum compile_error error) {
+    return error >= COMPILE_TOO_MANY_NFA_STATES &&
+        error <= COMPILE_TOO_MANY_BYTES;
+}
+
+/* Get a message describing the error */
+const char *compile_error_string(enum compile_error error);
+
+
+/* Get the num of bytes the calling thread uses now, it is the base the
+ * bytes taken by a step of the compilation are counted from */
+size_t budget_bytes_base(void);
+
+/* Check a compilation step against the budget, given the num of NFA and
+ * DFA states it has (0 if it doesn't build any) and the base of its bytes.
+ * It returns COMPILE_OK, or the error of the first limit exceeded. */
+enum compile_error budget_check(const struct compile_budget *budget,
+    int n_NFA_states, int n_DFA_states, size_t base);
+
+
+
+#endif /* __BUDGET_HEADER__ */
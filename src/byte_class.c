@@ -0,0 +1,67 @@
+#include <string.h>
+#include <ctype.h>
+
+#include "byte_class.h"
+
+
+
+/* Start building byte classes, all bytes are in one class initially */
+void byte_classes_init(struct byte_classes *bc)
+{
+    memset(bc->_boundary, 0, sizeof(bc->_boundary));
+    bc->_boundary[0] = 1;
+}
+
+/* Split classes so that bytes in [lo, hi] are separated from the others */
+void byte_classes_add_range(struct byte_classes *bc, int lo, int hi)
+{
+    bc->_boundary[lo] = 1;
+    if (hi < 255)  bc->_boundary[hi + 1] = 1;
+}
+
+/* Number the classes after all ranges are added */
+void byte_classes_finish(struct byte_classes *bc)
+{
+    int c = 0, k = -1;
+
+    for ( ; c < 256; c++)
+    {
+        if (bc->_boundary[c])  bc->first[++k] = (unsigned char) c;
+        bc->map[c] = (unsigned char) k;
+    }
+
+    bc->n_classes = k + 1;
+}
+
+/* Get the largest byte in the k-th class */
+int byte_class_last(const struct byte_classes *bc, int k)
+{
+    return k + 1 < bc->n_classes ? bc->first[k + 1] - 1 : 255;
+}
+
+
+/* Print a byte of a label, characters having special meanings in DOT strings
+ * are escaped */
+static void __fprint_byte(FILE *fp, int c)
+{
+    if (c == '"')
+        fprintf(fp, "\\\"");
+    else if (c == '\\')
+        fprintf(fp, "\\\\");
+    else if (isgraph(c))
+        fputc(c, fp);
+    else
+        fprintf(fp, "\\\\x%02x", c);
+}
+
+/* Print a byte range as a label of DOT code, it is a single character if
+ * lo == hi, unprintable bytes are escaped */
+void fprint_byte_range(FILE *fp, int lo, int hi)
+{
+    __fprint_byte(fp, lo);
+    if (lo != hi)
+    {
+        fputc('-', fp);
+        __fprint_byte(fp, hi);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef __BYTE_CLASS_HEADER__
+#define __BYTE_CLASS_HEADER__
+
+
+#include <stdio.h>
+
+
+/* Byte equivalence classes. Transitions of an automaton are labelled by byte
+ * ranges, and two bytes are equivalent if every label either contains both of
+ * them or neither of them, so the automaton can not tell them apart. Each
+ * class is a contiguous range of bytes since it's bounded by the boundaries
+ * of the labels, and automatons can be driven by class ids instead of raw
+ * bytes, which makes their transition tables a lot narrower. */
+struct byte_classes
+{
+    int n_classes;              /* num of classes, at most 256 */
+    unsigned char map[256];     /* map[c] is the class byte c belongs to */
+    unsigned char first[256];   /* first[k] is the smallest byte in class k */
+
+    unsigned char _boundary[256];   /* _boundary[c] is 1 if a class begins
+                                     * at byte c */
+};
+
+
+/* Start building byte classes, all bytes are in one class initially */
+void byte_classes_init(struct byte_classes *bc);
+
+/* Split classes so that bytes in [lo, hi] are separated from the others */
+void byte_classes_add_range(struct byte_classes *bc, int lo, int hi);
+
+/* Number the classes after all ranges are added */
+void byte_classes_finish(struct byte_classes *bc);
+
+/* Get the largest byte in the k-th class */
+int byte_class_last(const struct byte_classes *bc, int k);
+
+
+/* Print a byte range as a label of DOT code, it is a single character if
+ * lo == hi, unprintable bytes are escaped */
+void fprint_byte_range(FILE *fp, int lo, int hi);
+
+
+
+#endif /* __BYTE_CLASS_HEADER__ */
@@ -2,203 +2,246 @@
 #include <string.h>
 #include <stdio.h>
 
-#include "glist.h"
+#include "mem.h"
 #include "dfa.h"
 
 
-MAKE_COMPARE_FUNCTION(addr, struct DFA_state*)
+/* Create a DFA without any state */
+struct DFA *create_DFA(void)
+{
+    struct DFA *dfa = (struct DFA*)mem_alloc(sizeof(struct DFA));
+
+    dfa->start = -1;
+
+    dfa->_states_capacity = 16;
+    dfa->n_states = 0;
+    dfa->states = (struct DFA_state*)mem_alloc(
+        dfa->_states_capacity * sizeof(struct DFA_state));
 
+    dfa->_trans_capacity = 64;
+    dfa->n_trans = 0;
+    dfa->trans = (struct DFA_transition*)mem_alloc(
+        dfa->_trans_capacity * sizeof(struct DFA_transition));
+
+    dfa->_accepts_capacity = 16;
+    dfa->n_accepts = 0;
+    dfa->accepts = (int*)mem_alloc(dfa->_accepts_capacity * sizeof(int));
+
+    return dfa;
+}
 
-/* Create an empty (isolated), non-acceptable state */
-struct DFA_state *alloc_DFA_state(void)
+/* Create an empty (isolated), non-acceptable state in the DFA and return its
+ * id */
+int alloc_DFA_state(struct DFA *dfa)
 {
-    struct DFA_state *state = 
-        (struct DFA_state*)malloc(sizeof(struct DFA_state));
+    struct DFA_state *state;
 
-    state->_capacity = 4;
-    state->n_transitions = 0;   /* isolated  */
+    /* If we're running out of space */
+    if (dfa->n_states == dfa->_states_capacity)
+    {
+        dfa->_states_capacity *= 2;   /* expand two-fold */
+        dfa->states = (struct DFA_state*)mem_realloc(dfa->states,
+            dfa->_states_capacity * sizeof(struct DFA_state));
+    }
+
+    state = dfa->states + dfa->n_states;
     state->is_acceptable = 0;   /* non-acceptable */
-    state->trans = (struct DFA_transition*)malloc(
-        state->_capacity * sizeof(struct DFA_transition));
+    state->accepts   = 0;
+    state->n_accepts = 0;
+    state->trans = 0;
+    state->n_transitions = 0;   /* isolated  */
 
-    return state;
+    return dfa->n_states++;
 }
 
-/* Free allocated space for specified DFA state */
-void free_DFA_state(struct DFA_state *state)
+/* Destroy the entire DFA */
+void DFA_dispose(struct DFA *dfa)
 {
-    free(state->trans);         /* free array of transitions */
-    free(state);                /* free the state object */
+    mem_free(dfa->states);
+    mem_free(dfa->trans);
+    mem_free(dfa->accepts);
+    mem_free(dfa);
 }
 
 
-/* Traverse from specified state and add all reachable states to a generic
- * list */
-void DFA_traverse(
-    struct DFA_state *state, struct generic_list *visited)
+/* Compute the byte equivalence classes of all transitions of the DFA */
+void DFA_byte_classes(const struct DFA *dfa, struct byte_classes *bc)
 {
-    int i_trans = 0, n_trans = state->n_transitions;
-    for ( ; i_trans < n_trans; i_trans++)
+    const struct DFA_state *state = dfa->states;
+    const struct DFA_transition *trans;
+    int i_state = 0, i_trans;
+
+    byte_classes_init(bc);
+    for ( ; i_state < dfa->n_states; i_state++, state++)
     {
-        /* DFS */
-        if (generic_list_add(
-                visited, &state->trans[i_trans].to, __cmp_addr) != 0) {
-            DFA_traverse(state->trans[i_trans].to, visited);
-        }
+        trans = DFA_TRANSITIONS(dfa, state);
+        for (i_trans = 0; i_trans < state->n_transitions; i_trans++)
+            byte_classes_add_range(bc, trans[i_trans].lo, trans[i_trans].hi);
     }
+    byte_classes_finish(bc);
 }
 
-/* Destroy the entire DFA */
-void DFA_dispose(struct DFA_state *start)
+/* Turn specified DFA state to an acceptable one for the pattern, patterns
+ * must be added to a state in ascending order */
+void DFA_make_acceptable(struct DFA *dfa, int state, int pattern)
 {
-    struct generic_list state_list;
-    struct DFA_state **cur;
-    int i_state = 0;
+    struct DFA_state *s = DFA_STATE(dfa, state);
 
-    create_generic_list(struct DFA_state*, &state_list);
-    generic_list_push_back(&state_list, &start);
-    DFA_traverse(start, &state_list);
+    s->is_acceptable = 1;
 
-    for (cur = (struct DFA_state**) state_list.p_dat; 
-         i_state < state_list.length; i_state++, cur++)
+    /* make room at the tail of the pool, and move the run of the state
+     * there unless it is the last one already */
+    if (dfa->n_accepts + s->n_accepts + 1 > dfa->_accepts_capacity)
     {
-        free_DFA_state(*cur);
+        while (dfa->n_accepts + s->n_accepts + 1 > dfa->_accepts_capacity)
+            dfa->_accepts_capacity *= 2;
+        dfa->accepts = (int*)mem_realloc(dfa->accepts,
+            dfa->_accepts_capacity * sizeof(int));
+    }
+    if (s->n_accepts == 0 || s->accepts + s->n_accepts != dfa->n_accepts)
+    {
+        memmove(dfa->accepts + dfa->n_accepts, dfa->accepts + s->accepts,
+            s->n_accepts * sizeof(int));
+        s->accepts = dfa->n_accepts;
+        dfa->n_accepts += s->n_accepts;
     }
 
-    destroy_generic_list(&state_list);
-}
-
-/* Turn specified DFA state to an acceptable one */
-void DFA_make_acceptable(struct DFA_state *state)
-{
-    state->is_acceptable = 1;
+    dfa->accepts[dfa->n_accepts++] = pattern;
+    s->n_accepts++;
 }
 
-/* Add transition between specified DFA states
+/* Add transition between specified DFA states on bytes in [lo, hi], it is
+ * merged to the last transition of "from" if they are adjacent ranges going
+ * to the same state
 
-       /----\  trans_char  /--\
+       /----\   [lo, hi]   /--\
        |from|------------>>|to|
        \----/              \--/
 */
-void DFA_add_transition(
-    struct DFA_state *from, struct DFA_state *to, char trans_char)
+void DFA_add_transition(struct DFA *dfa, int from, int to, int lo, int hi)
 {
-    /* If we're running out of space */
-    if (from->n_transitions == from->_capacity)
+    struct DFA_state *s = DFA_STATE(dfa, from);
+    struct DFA_transition *last;
+
+    if (s->n_transitions != 0)
     {
-        from->_capacity *= 2;   /* expand two-fold */
-        from->trans = (struct DFA_transition*)realloc(
-            from->trans, from->_capacity * sizeof(struct DFA_transition));
+        last = DFA_TRANSITIONS(dfa, s) + s->n_transitions - 1;
+        if (last->to == to && last->hi + 1 == lo) {
+            last->hi = (unsigned char) hi;
+            return;
+        }
+    }
+
+    /* make room at the tail of the pool, and move the run of the state
+     * there unless it is the last one already */
+    if (dfa->n_trans + s->n_transitions + 1 > dfa->_trans_capacity)
+    {
+        while (dfa->n_trans + s->n_transitions + 1 > dfa->_trans_capacity)
+            dfa->_trans_capacity *= 2;
+        dfa->trans = (struct DFA_transition*)mem_realloc(dfa->trans,
+            dfa->_trans_capacity * sizeof(struct DFA_transition));
+    }
+    if (s->n_transitions == 0 || s->trans + s->n_transitions != dfa->n_trans)
+    {
+        memmove(dfa->trans + dfa->n_trans, DFA_TRANSITIONS(dfa, s),
+            s->n_transitions * sizeof(struct DFA_transition));
+        s->trans = dfa->n_trans;
+        dfa->n_trans += s->n_transitions;
     }
 
     /* add transition */
-    from->trans[from->n_transitions].to = to;
-    from->trans[from->n_transitions].trans_char = trans_char;
+    dfa->trans[dfa->n_trans].to = to;
+    dfa->trans[dfa->n_trans].lo = (unsigned char) lo;
+    dfa->trans[dfa->n_trans].hi = (unsigned char) hi;
 
-    from->n_transitions++;    
+    dfa->n_trans++;
+    s->n_transitions++;
 }
 
 /* Get the target state of specified state under certain transition, if there's
- * no such transition then NULL is returned */
-struct DFA_state *DFA_target_of_trans(struct DFA_state *state, char trans_char)
+ * no such transition then -1 is returned */
+int DFA_target_of_trans(const struct DFA *dfa, int state, char trans_char)
 {
     /* we have to iterate through all transitions to find the one we want */
-    int i_trans = 0, n_trans = state->n_transitions;
+    const struct DFA_state *s = DFA_STATE(dfa, state);
+    const struct DFA_transition *trans = DFA_TRANSITIONS(dfa, s);
+    int i_trans = 0, n_trans = s->n_transitions;
+    unsigned char c = (unsigned char) trans_char;
 
     /* , so here we have to do a bad linear search */
     for ( ; i_trans < n_trans; i_trans++)
     {
-        if (state->trans[i_trans].trans_char == trans_char) {
-            return state->trans[i_trans].to;  /* transition found */
+        if (trans[i_trans].lo <= c && c <= trans[i_trans].hi) {
+            return trans[i_trans].to;   /* transition found */
         }
     }
 
-    return NULL;                /* we haven't found specified transition */
+    return -1;                  /* we haven't found specified transition */
 }
 
 
-/* dump the transitions to *all reachable* states from specified state */
-static void __DFA_reachable_states_dump_graphviz(
-    const struct DFA_state *state, struct generic_list *visited, FILE *fp)
+/* Check if any state accepts a pattern other than pattern 0, which means
+ * the DFA is built from a set of patterns */
+static int __has_many_patterns(const struct DFA *dfa)
 {
-    /* we'll storm down each way (transition) and dump each target state
-     * recursively */
-    int n_trans = state->n_transitions;
-    int i_trans = 0;
+    const struct DFA_state *state = dfa->states;
+    int i_state = 0, i;
 
-    for ( ; i_trans < n_trans; i_trans++)
+    for ( ; i_state < dfa->n_states; i_state++, state++)
     {
-        /* dump source state and target state, acceptable states are presented
-         * as double circles */
-        if (state->is_acceptable)   /* source state */
-            fprintf(fp,
-                "    node [shape = doublecircle label=\"\"]; addr_%p\n",
-                (void*)state);      /* target state */
-
-        if (state->trans[i_trans].to->is_acceptable)
-            fprintf(fp,
-                "    node [shape = doublecircle label=\"\"]; addr_%p\n",
-                (void*)state->trans[i_trans].to);
-
-        fprintf(fp, "    node [shape = circle label=\"\"]\n");
-
-
-        /* if (state->is_acceptable)   /\* source state *\/ */
-        /*     fprintf(fp, */
-        /*         "    node [shape = doublecircle label=\"%p\"]; addr_%p\n", */
-        /*         (void*) state, (void*) state);      /\* target state *\/ */
-        /* else */
-        /*     fprintf(fp, "    node [shape = circle label=\"%p\"]; addr_%p\n",  */
-        /*         (void*) state, (void*) state); */
-
-        /* if (state->trans[i_trans].to->is_acceptable) */
-        /*     fprintf(fp, */
-        /*         "    node [shape = doublecircle label=\"%p\"]; addr_%p\n", */
-        /*         (void*)state->trans[i_trans].to, */
-        /*         (void*)state->trans[i_trans].to); */
-        /* else */
-        /*     fprintf(fp, "    node [shape = circle label=\"%p\"]; addr_%p\n",  */
-        /*         (void*)state->trans[i_trans].to, */
-        /*         (void*)state->trans[i_trans].to); */
-
-
-        /* dump the transition from source state and target state */
-        fprintf(fp, "    addr_%p -> addr_%p [ label = \"%c\" ]\n", 
-            (void*) state, 
-            (void*) state->trans[i_trans].to, 
-            state->trans[i_trans].trans_char);
-
-        /* dump the successor states of this target state (in recursive
-         * fashion) */
-        if (generic_list_add(
-                visited, &state->trans[i_trans].to, __cmp_addr) != 0)
-        {
-            __DFA_reachable_states_dump_graphviz(
-                state->trans[i_trans].to, visited, fp);
-        }
+        for (i = 0; i < state->n_accepts; i++)
+            if (DFA_ACCEPTS(dfa, state)[i] != 0)  return 1;
     }
+
+    return 0;
 }
 
-/* Generate DOT code to vizualize the DFA */
-void DFA_dump_graphviz_code(const struct DFA_state *start_state, FILE *fp)
+/* Generate DOT code to vizualize the DFA, states are named after their ids,
+ * and acceptable states are labelled by the patterns they accept if the DFA
+ * is built from a set of patterns */
+void DFA_dump_graphviz_code(const struct DFA *dfa, FILE *fp)
 {
-    struct generic_list visited_state;
-    create_generic_list(struct DFA_state *, &visited_state);
+    const struct DFA_state *state;
+    const struct DFA_transition *trans;
+    int i_state, i_trans, i, has_many_patterns;
 
     fprintf(fp, 
         "digraph finite_state_machine {\n"
         "    rankdir=LR;\n"
-        "    size=\"8,5\"\n"
-        "    node [shape = circle label=\"\"]\n");
+        "    size=\"8,5\"\n");
+
+    /* acceptable states are presented as double circles */
+    has_many_patterns = __has_many_patterns(dfa);
+    for (i_state = 0; i_state < dfa->n_states; i_state++)
+    {
+        state = DFA_STATE(dfa, i_state);
+        if (!state->is_acceptable)  continue;
+
+        fprintf(fp, "    node [shape = doublecircle label=\"");
+        for (i = 0; has_many_patterns && i < state->n_accepts; i++)
+            fprintf(fp, i == 0 ? "%d" : ",%d", DFA_ACCEPTS(dfa, state)[i]);
+        fprintf(fp, "\"]; s%d\n", i_state);
+    }
+    fprintf(fp, "    node [shape = circle label=\"\"]\n");
 
-    generic_list_push_back(&visited_state, &start_state);
-    __DFA_reachable_states_dump_graphviz(start_state, &visited_state, fp);
+    /* dump transitions of each state */
+    for (i_state = 0; i_state < dfa->n_states; i_state++)
+    {
+        state = DFA_STATE(dfa, i_state);
+        trans = DFA_TRANSITIONS(dfa, state);
+        for (i_trans = 0; i_trans < state->n_transitions; i_trans++)
+        {
+            fprintf(fp, "    s%d -> s%d [ label = \"",
+                i_state, trans[i_trans].to);
+            fprint_byte_range(fp, trans[i_trans].lo, trans[i_trans].hi);
+            fprintf(fp, "\" ]\n");
+        }
+    }
 
     /* dump start mark */
     fprintf(fp, "    node [shape = none label=\"\"]; start\n");
-    fprintf(fp, "    start -> addr_%p [ label = \"start\" ]\n", (void*)start_state);
+    fprintf(fp, "    start -> s%d [ label = \"start\" ]\n", dfa->start);
 
     /* done */
     fprintf(fp, "}\n");
-    destroy_generic_list(&visited_state);
 }
@@ -5,66 +5,171 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-#include "glist.h"
+#include "nfa.h"
+#include "byte_class.h"
+#include "reg_ast.h"
 
 
-struct DFA_state;   /* forward type declaration */
-
-/* Transition of a DFA state */
+/* Transition of a DFA state, it is taken on any byte in [lo, hi] */
 struct DFA_transition
 {
-    struct DFA_state *to;   /* destination of the transition */
-    char trans_char;        /* transition character */
+    int to;                   /* id of the destination state */
+    unsigned char lo, hi;     /* range of transition characters */
 };
 
-/* State in DFA, it can also be used to represent an entire DFA if it is a
- * start state */
+/* State in DFA. Transitions and accepted patterns of the state are runs in
+ * the pools of the DFA it belongs to, rather than arrays of its own. */
 struct DFA_state
 {
     int is_acceptable;      /* if this state is an acceptable state */
-
-    struct DFA_transition *trans;  /* an array of transitions going out from
-                                    * this state */
-    int n_transitions;             /* number of transitions  */
-    int _capacity;                 /* reserved space for transitions */
+    int accepts;            /* patterns accepted in this state are
+                             * dfa->accepts[accepts .. accepts+n_accepts-1],
+                             * in ascending order. A DFA of a single regexp
+                             * accepts the pattern numbered 0 only */
+    int n_accepts;          /* num of patterns accepted in this state */
+
+    int trans;              /* transitions going out from this state are
+                             * dfa->trans[trans .. trans+n_transitions-1] */
+    int n_transitions;      /* number of transitions  */
 };
 
+/* Deterministic finite automaton (DFA). All states live in one array and are
+ * numbered densely in the order they are created, transitions of all states
+ * live in one shared pool and so do the accepted patterns, so traversing the
+ * DFA is a loop over arrays and disposing it costs O(1). */
+struct DFA
+{
+    int start;                      /* start state */
 
-/* Create an empty (isolated), non-acceptable state */
-struct DFA_state *alloc_DFA_state(void);
+    struct DFA_state *states;       /* states[id] is the state numbered id */
+    int n_states;
+    int _states_capacity;
 
-/* Free allocated space for specified DFA state */
-void free_DFA_state(struct DFA_state *state);
+    struct DFA_transition *trans;   /* pool of transitions */
+    int n_trans;
+    int _trans_capacity;
 
-/* Destroy the entire DFA */
-void DFA_dispose(struct DFA_state *start);
+    int *accepts;                   /* pool of accepted patterns */
+    int n_accepts;
+    int _accepts_capacity;
+};
+
+/* Get the address of state numbered id in the DFA, the address is invalidated
+ * once more states are allocated */
+#define DFA_STATE(dfa, id)  ((dfa)->states + (id))
+
+/* Get the transitions and the accepted patterns of a state of the DFA, they
+ * are invalidated once more transitions or patterns are added */
+#define DFA_TRANSITIONS(dfa, state)  ((dfa)->trans + (state)->trans)
+#define DFA_ACCEPTS(dfa, state)      ((dfa)->accepts + (state)->accepts)
 
 
-/* Turn specified DFA state to an acceptable one */
-void DFA_make_acceptable(struct DFA_state *state);
+/* Create a DFA without any state */
+struct DFA *create_DFA(void);
 
-/* Add transition between specified DFA states
+/* Create an empty (isolated), non-acceptable state in the DFA and return its
+ * id */
+int alloc_DFA_state(struct DFA *dfa);
 
-       /----\  trans_char  /--\
+/* Destroy the entire DFA */
+void DFA_dispose(struct DFA *dfa);
+
+
+/* Convert an NFA to DFA */
+struct DFA *NFA_to_DFA(const struct NFA *nfa);
+
+/* Convert the NFA of a set of patterns to one DFA, each state of it knows
+ * which patterns are accepted there */
+struct DFA *NFA_set_to_DFA(const struct NFA_set *set);
+
+/* Convert an NFA to DFA within the budget, the DFA is stored to *dfa on
+ * success. It returns COMPILE_OK, or the error of the limit exceeded and
+ * then nothing is left allocated. */
+enum compile_error NFA_to_DFA_within(const struct NFA *nfa,
+    const struct compile_budget *budget, struct DFA **dfa);
+
+/* Convert the NFA of a set of patterns to one DFA within the budget, just
+ * like NFA_to_DFA_within */
+enum compile_error NFA_set_to_DFA_within(const struct NFA_set *set,
+    const struct compile_budget *budget, struct DFA **dfa);
+
+/* Build the DFA of an AST made by regs_to_AST directly by Brzozowski
+ * derivatives, without any NFA. The DFA accepts the same patterns as the one
+ * NFA_set_to_DFA makes, and it is often close to minimal already. */
+struct DFA *AST_to_DFA(struct reg_pool *pool, int root);
+
+/* Build the DFA of the AST by derivatives within the budget, the DFA is
+ * stored to *dfa on success. It returns COMPILE_OK, or the error of the
+ * limit exceeded and then nothing is left allocated. */
+enum compile_error AST_to_DFA_within(struct reg_pool *pool, int root,
+    const struct compile_budget *budget, struct DFA **dfa);
+
+/* Parse a set of regexps and convert them to one DFA by derivatives */
+struct DFA *regs_to_DFA_by_derivatives(const char *const *regexps,
+    int n_regexps);
+
+/* Parse a set of regexps and convert them to one DFA by derivatives within
+ * the budget, the DFA is stored to *dfa on success. It returns COMPILE_OK,
+ * or the error found and then nothing is left allocated. */
+enum compile_error regs_to_DFA_by_derivatives_within(
+    const char *const *regexps, int n_regexps,
+    const struct compile_budget *budget, struct DFA **dfa);
+
+/* Simplify DFA by merging undistinguishable states, states accepting
+ * different sets of patterns are never merged */
+struct DFA *DFA_optimize(const struct DFA *dfa);
+
+/* Simplify DFA within the budget, the optimized DFA is stored to *dfa_opt on
+ * success. The memory the optimization takes is known before it begins, so
+ * it returns COMPILE_TOO_MANY_BYTES without doing anything if that exceeds
+ * the budget, or COMPILE_OK otherwise. */
+enum compile_error DFA_optimize_within(const struct DFA *dfa,
+    const struct compile_budget *budget, struct DFA **dfa_opt);
+
+
+/* Turn specified DFA state to an acceptable one for the pattern, patterns
+ * must be added to a state in ascending order */
+void DFA_make_acceptable(struct DFA *dfa, int state, int pattern);
+
+/* Add transition between specified DFA states on bytes in [lo, hi], it is
+ * merged to the last transition of "from" if they are adjacent ranges going
+ * to the same state. Adding all transitions of a state before moving on to
+ * the next one keeps the pool compact.
+
+       /----\   [lo, hi]   /--\
        |from|------------>>|to|
        \----/              \--/
 */
-void DFA_add_transition(
-    struct DFA_state *from, struct DFA_state *to, char trans_char);
+void DFA_add_transition(struct DFA *dfa, int from, int to, int lo, int hi);
 
 /* Get the target state of specified state under certain transition, if there's
- * no such transition then NULL is returned */
-struct DFA_state *DFA_target_of_trans(
-    struct DFA_state *state, char trans_char);
+ * no such transition then -1 is returned */
+int DFA_target_of_trans(const struct DFA *dfa, int state, char trans_char);
 
+/* Compute the byte equivalence classes of all transitions of the DFA */
+void DFA_byte_classes(const struct DFA *dfa, struct byte_classes *bc);
 
-/* Traverse from specified state and add all reachable states to a generic
- * list */
-void DFA_traverse(
-    struct DFA_state *state, struct generic_list *visited);
 
 /* Generate DOT code to vizualize the DFA */
-void DFA_dump_graphviz_code(const struct DFA_state *start_state, FILE *fp);
+void DFA_dump_graphviz_code(const struct DFA *dfa, FILE *fp);
+
+/* Designs of the matcher generated by DFA_dump_c_code */
+enum DFA_codegen_style
+{
+    DFA_CODEGEN_GOTO,   /* each state is a label, and bytes are dispatched
+                         * by a switch with gotos */
+    DFA_CODEGEN_TABLE   /* static const tables of the smallest integer type
+                         * holding every state */
+};
+
+/* Generate a standalone C source file matching the DFA, it defines
+
+       int name(const char *buf, size_t len);
+
+ * which returns 1 if the whole buffer matches the DFA (any of its patterns),
+ * or 0 if not. The code depends on nothing but <stddef.h> and <stdint.h>. */
+void DFA_dump_c_code(const struct DFA *dfa, const char *name,
+    enum DFA_codegen_style style, FILE *fp);
 
 
 
@@ -0,0 +1,230 @@
+#include <stdio.h>
+
+#include "mem.h"
+#include "dfa.h"
+#include "dfa_table.h"
+
+
+/* A range of bytes going to the same state of a compiled DFA */
+struct __byte_range
+{
+    int lo, hi;
+    int to;
+};
+
+
+/* Split the row of state s into maximal ranges of bytes going to the same
+ * state, it returns the num of ranges, which is at most 256 */
+static int __row_ranges(const struct DFA_table *table, int s,
+    struct __byte_range *ranges)
+{
+    const int *row = table->next + s * table->n_classes;
+    int c, to, n_ranges = 0;
+
+    for (c = 0; c < 256; c++)
+    {
+        to = row[table->classmap[c]];
+        if (n_ranges != 0 && ranges[n_ranges - 1].to == to)
+        {
+            ranges[n_ranges - 1].hi = c;
+            continue;
+        }
+
+        ranges[n_ranges].lo = ranges[n_ranges].hi = c;
+        ranges[n_ranges].to = to;
+        n_ranges++;
+    }
+
+    return n_ranges;
+}
+
+/* Find the state most bytes of the row go to */
+static int __most_common_target(const struct __byte_range *ranges,
+    int n_ranges)
+{
+    int i, k, n_bytes, max_bytes = -1, target = DFA_DEAD_STATE;
+
+    for (i = 0; i < n_ranges; i++)
+    {
+        n_bytes = 0;
+        for (k = 0; k < n_ranges; k++)
+        {
+            if (ranges[k].to == ranges[i].to)
+                n_bytes += ranges[k].hi - ranges[k].lo + 1;
+        }
+        if (n_bytes > max_bytes) {
+            max_bytes = n_bytes; target = ranges[i].to;
+        }
+    }
+
+    return target;
+}
+
+/* Emit the jump to a state, or a return if it is the dead state */
+static void __emit_jump(int to, FILE *fp)
+{
+    if (to == DFA_DEAD_STATE)
+        fprintf(fp, "        return 0;\n");
+    else
+        fprintf(fp, "        goto s%d;\n", to);
+}
+
+/* Emit a switch on the next byte, bytes going to the state most of them go
+ * to are left to the default label. The compiler picks jump tables, bit
+ * tests or compare trees for it as it sees fit. */
+static void __emit_switch(const struct __byte_range *ranges, int n_ranges,
+    FILE *fp)
+{
+    int dflt = __most_common_target(ranges, n_ranges), i, c;
+
+    fprintf(fp, "    switch (*p++)\n    {\n");
+    for (i = 0; i < n_ranges; i++)
+    {
+        if (ranges[i].to == dflt)  continue;
+
+        for (c = ranges[i].lo; c <= ranges[i].hi; c++)
+            fprintf(fp, "    case 0x%02x:\n", c);
+        __emit_jump(ranges[i].to, fp);
+    }
+    fprintf(fp, "    default:\n");
+    __emit_jump(dflt, fp);
+    fprintf(fp, "    }\n");
+}
+
+/* Direct-coded matcher, every state but the dead one is a label */
+static void __dump_goto_code(const struct DFA_table *table, const char *name,
+    FILE *fp)
+{
+    struct __byte_range *ranges = (struct __byte_range*)mem_alloc(
+        256 * sizeof(struct __byte_range));
+    int s, n_ranges;
+
+    fprintf(fp,
+        "int %s(const char *buf, size_t len)\n"
+        "{\n"
+        "    const unsigned char *p = (const unsigned char *) buf;\n"
+        "    const unsigned char *end = p + len;\n"
+        "\n"
+        "    goto s%d;\n", name, table->start);
+
+    for (s = 0; s < table->n_states; s++)
+    {
+        if (s == DFA_DEAD_STATE)  continue;
+
+        fprintf(fp, "s%d:\n", s);
+        n_ranges = __row_ranges(table, s, ranges);
+
+        /* nothing but the end of input can follow a state going nowhere */
+        if (n_ranges == 1 && ranges[0].to == DFA_DEAD_STATE)
+        {
+            fprintf(fp, "    return %s;\n",
+                DFA_table_is_acceptable(table, s) ? "p == end" : "0");
+            continue;
+        }
+
+        fprintf(fp, "    if (p == end)  return %d;\n",
+            DFA_table_is_acceptable(table, s));
+        __emit_switch(ranges, n_ranges, fp);
+    }
+
+    fprintf(fp, "}\n");
+    mem_free(ranges);
+}
+
+/* Emit an array of integers, 12 per line */
+static void __emit_array(const char *type, const char *name,
+    const char *suffix, const int *v, int n, FILE *fp)
+{
+    int i;
+
+    fprintf(fp, "static const %s %s%s[%d] = {", type, name, suffix, n);
+    for (i = 0; i < n; i++)
+    {
+        fprintf(fp, i % 12 == 0 ? "\n    " : " ");
+        fprintf(fp, "%d%s", v[i], i + 1 < n ? "," : "");
+    }
+    fprintf(fp, "\n};\n\n");
+}
+
+/* Table-driven matcher, the table holds states in the smallest unsigned
+ * integer type wide enough. A DFA of up to 256 states gets a row of 256
+ * bytes per state, which is at most 64KB, so each input byte costs a single
+ * table load. Larger DFAs keep the byte classes to save space. */
+static void __dump_table_code(const struct DFA_table *table,
+    const char *name, FILE *fp)
+{
+    const char *type = table->n_states <= 256 ? "uint8_t" :
+        table->n_states <= 65536 ? "uint16_t" : "uint32_t";
+    int is_full = table->n_states <= 256;
+    int n_entries = table->n_states * (is_full ? 256 : table->n_classes);
+    int *v = (int*)mem_alloc(n_entries * sizeof(int));
+    int s, c;
+
+    for (s = 0; s < table->n_states; s++)
+        v[s] = DFA_table_is_acceptable(table, s);
+    __emit_array("uint8_t", name, "_accept", v, table->n_states, fp);
+
+    if (is_full)
+    {
+        for (s = 0; s < table->n_states; s++)
+            for (c = 0; c < 256; c++)
+            {
+                v[s * 256 + c] =
+                    table->next[s * table->n_classes + table->classmap[c]];
+            }
+        __emit_array(type, name, "_next", v, n_entries, fp);
+    }
+    else {
+        for (c = 0; c < 256; c++)  v[c] = table->classmap[c];
+        __emit_array("uint8_t", name, "_classmap", v, 256, fp);
+        __emit_array(type, name, "_next", table->next, n_entries, fp);
+    }
+
+    fprintf(fp,
+        "int %s(const char *buf, size_t len)\n"
+        "{\n"
+        "    const unsigned char *p = (const unsigned char *) buf;\n"
+        "    const unsigned char *end = p + len;\n"
+        "    unsigned s = %d;\n"
+        "\n"
+        "    for ( ; p != end; p++)\n"
+        "    {\n", name, table->start);
+    if (is_full)
+        fprintf(fp, "        s = %s_next[s << 8 | *p];\n", name);
+    else
+    {
+        fprintf(fp, "        s = %s_next[s * %d + %s_classmap[*p]];\n",
+            name, table->n_classes, name);
+    }
+    fprintf(fp,
+        "        if (s == %d)  return 0;\n"
+        "    }\n"
+        "\n"
+        "    return %s_accept[s];\n"
+        "}\n", DFA_DEAD_STATE, name);
+
+    mem_free(v);
+}
+
+/* Generate a standalone C source file matching the DFA */
+void DFA_dump_c_code(const struct DFA *dfa, const char *name,
+    enum DFA_codegen_style style, FILE *fp)
+{
+    struct DFA_table table;
+
+    DFA_compile(dfa, &table);
+
+    fprintf(fp,
+        "/* Generated by redot, matcher of a DFA with %d states */\n"
+        "\n"
+        "#include <stddef.h>\n"
+        "#include <stdint.h>\n"
+        "\n", table.n_states);
+
+    if (style == DFA_CODEGEN_GOTO)
+        __dump_goto_code(&table, name, fp);
+    else
+        __dump_table_code(&table, name, fp);
+
+    DFA_table_dispose(&table);
+}
@@ -0,0 +1,268 @@
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mem.h"
+#include "dfa_image.h"
+
+
+#define __MAGIC        "REDOTDFA"
+#define __HEADER_SIZE  40           /* bytes before the classmap */
+
+/* Round n up to a multiple of 4 */
+#define __ALIGN4(n)  (((n) + 3) & ~(uint64_t)3)
+
+
+/* Write integers in little-endian */
+static void __put_u32(uint32_t v, FILE *fp)
+{
+    unsigned char b[4];
+
+    b[0] = (unsigned char) v;         b[1] = (unsigned char)(v >> 8);
+    b[2] = (unsigned char)(v >> 16);  b[3] = (unsigned char)(v >> 24);
+    fwrite(b, 1, 4, fp);
+}
+
+static void __put_u64(uint64_t v, FILE *fp)
+{
+    __put_u32((uint32_t) v, fp);
+    __put_u32((uint32_t)(v >> 32), fp);
+}
+
+static void __put_ints(const int *v, size_t n, FILE *fp)
+{
+    size_t i = 0;
+    for ( ; i < n; i++)  __put_u32((uint32_t) v[i], fp);
+}
+
+/* Read integers in little-endian */
+static uint32_t __get_u32(const unsigned char *b)
+{
+    return (uint32_t) b[0] | (uint32_t) b[1] << 8 |
+        (uint32_t) b[2] << 16 | (uint32_t) b[3] << 24;
+}
+
+static uint64_t __get_u64(const unsigned char *b)
+{
+    return (uint64_t) __get_u32(b) | (uint64_t) __get_u32(b + 4) << 32;
+}
+
+/* Check if the arrays of the image can be used in place, which needs ints
+ * to be 32-bit little-endian */
+static int __is_native_layout(void)
+{
+    const uint32_t one = 1;
+    return sizeof(int) == 4 && *(const unsigned char*) &one == 1;
+}
+
+
+/* Hash a set of regexps, which tells if an image is built from them */
+uint64_t DFA_image_hash(const char *const *regexps, int n_regexps)
+{
+    uint64_t h = 14695981039346656037ULL;   /* FNV-1a offset basis */
+    const char *p;
+    int i = 0;
+
+    /* the terminating NULs are hashed as well, so that splitting a regexp
+     * in two makes a different hash */
+    for ( ; i < n_regexps; i++)
+    {
+        p = regexps[i];
+        do {
+            h = (h ^ (unsigned char) *p) * 1099511628211ULL;
+        } while (*p++ != '\0');
+    }
+
+    return h;
+}
+
+/* Write the image of the compiled DFA to fp, it returns 0 on success or -1
+ * on failure */
+static int __write_image(const struct DFA_table *table, int n_patterns,
+    uint64_t pattern_hash, FILE *fp)
+{
+    static const unsigned char zeros[4] = {0, 0, 0, 0};
+    size_t accept_len = (table->n_states + 7) / 8;
+    int n_ids = table->accept_begin[table->n_states];
+
+    fwrite(__MAGIC, 1, 8, fp);
+    __put_u32(DFA_IMAGE_VERSION, fp);
+    __put_u32(table->n_states, fp);
+    __put_u32(table->start, fp);
+    __put_u32(table->n_classes, fp);
+    __put_u32(n_patterns, fp);
+    __put_u32(n_ids, fp);
+    __put_u64(pattern_hash, fp);
+
+    fwrite(table->classmap, 1, 256, fp);
+    __put_ints(table->next, (size_t) table->n_states * table->n_classes, fp);
+    fwrite(table->accept, 1, accept_len, fp);
+    fwrite(zeros, 1, __ALIGN4(accept_len) - accept_len, fp);
+    __put_ints(table->accept_begin, table->n_states + 1, fp);
+    __put_ints(table->accept_ids, n_ids, fp);
+
+    return (fflush(fp) != 0 || ferror(fp)) ? -1 : 0;
+}
+
+/* Save the compiled DFA of n_patterns patterns to an image file at path, it
+ * returns 0 on success or -1 on failure with errno set. The image is written
+ * to a temporary file next to path, which is then renamed to path, so a
+ * process having the old image mapped keeps it intact, and path never holds
+ * a partial image. */
+int DFA_image_save(const struct DFA_table *table, int n_patterns,
+    uint64_t pattern_hash, const char *path)
+{
+    char *tmp_path;
+    int fd, is_failed, error;
+    FILE *fp;
+
+    if ((tmp_path = (char*)mem_alloc(strlen(path) + 32)) == NULL) {
+        errno = ENOMEM; return -1;
+    }
+    sprintf(tmp_path, "%s.%ld.tmp", path, (long) getpid());
+
+    if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0666)) == -1) {
+        mem_free(tmp_path); return -1;
+    }
+    if ((fp = fdopen(fd, "wb")) == NULL) {
+        close(fd); is_failed = 1;
+    }
+    else
+    {
+        /* the image reaches the disk before it replaces the old one */
+        is_failed = __write_image(table, n_patterns, pattern_hash, fp) == -1
+            || fsync(fd) == -1;
+        if (fclose(fp) != 0)  is_failed = 1;
+    }
+
+    if (is_failed || rename(tmp_path, path) == -1)
+    {
+        error = errno;
+        unlink(tmp_path);
+        mem_free(tmp_path);
+        errno = error;
+        return -1;
+    }
+
+    mem_free(tmp_path);
+    return 0;
+}
+
+/* Check that matching with the table of an image never reads out of its
+ * arrays: every byte class and every target state is in range, and the
+ * accepted patterns of the states are consecutive slices of accept_ids. It
+ * returns 0 if the table is sound or -1 if it isn't. */
+static int __check_image_table(const struct DFA_table *table,
+    int n_patterns, int n_ids)
+{
+    size_t i, n_next = (size_t) table->n_states * table->n_classes;
+    int s;
+
+    for (i = 0; i < 256; i++)
+        if (table->classmap[i] >= table->n_classes)  return -1;
+
+    for (i = 0; i < n_next; i++)
+        if ((uint32_t) table->next[i] >= (uint32_t) table->n_states)
+            return -1;
+
+    if (table->accept_begin[0] != 0 ||
+        table->accept_begin[table->n_states] != n_ids)
+        return -1;
+    for (s = 0; s < table->n_states; s++)
+        if (table->accept_begin[s] > table->accept_begin[s + 1])  return -1;
+
+    for (s = 0; s < n_ids; s++)
+        if ((uint32_t) table->accept_ids[s] >= (uint32_t) n_patterns)
+            return -1;
+
+    return 0;
+}
+
+/* Point the table of the image into the mapped file after checking that the
+ * header is sane, the file is as long as the header says and the arrays are
+ * sound, it returns 0 on success or -1 if the file is not a valid image */
+static int __map_image_table(struct DFA_image *image)
+{
+    const unsigned char *base = (const unsigned char*) image->map;
+    struct DFA_table *table = &image->table;
+    uint64_t n_states, n_classes, n_ids, offset;
+    uint64_t next_at, accept_at, begin_at, ids_at;
+
+    if (image->map_len < __HEADER_SIZE + 256)  return -1;
+    if (memcmp(base, __MAGIC, 8) != 0)  return -1;
+    if (__get_u32(base + 8) != DFA_IMAGE_VERSION)  return -1;
+
+    n_states  = __get_u32(base + 12);
+    n_classes = __get_u32(base + 20);
+    n_ids     = __get_u32(base + 28);
+    if (n_states == 0 || n_states > INT32_MAX)  return -1;
+    if (n_classes == 0 || n_classes > 256)  return -1;
+    if (n_ids > INT32_MAX)  return -1;
+    if (__get_u32(base + 16) >= n_states)  return -1;
+
+    next_at   = __HEADER_SIZE + 256;
+    accept_at = next_at + n_states * n_classes * 4;
+    begin_at  = accept_at + __ALIGN4((n_states + 7) / 8);
+    ids_at    = begin_at + (n_states + 1) * 4;
+    offset    = ids_at + n_ids * 4;
+    if (offset != image->map_len)  return -1;
+
+    table->n_states  = (int) n_states;
+    table->start     = (int) __get_u32(base + 16);
+    table->n_classes = (int) n_classes;
+    memcpy(table->classmap, base + __HEADER_SIZE, 256);
+    table->next         = (int*)(base + next_at);
+    table->accept       = (unsigned char*)(base + accept_at);
+    table->accept_begin = (int*)(base + begin_at);
+    table->accept_ids   = (int*)(base + ids_at);
+
+    image->n_patterns   = (int) __get_u32(base + 24);
+    image->pattern_hash = __get_u64(base + 32);
+    if (image->n_patterns < 0)  return -1;
+
+    return __check_image_table(table, image->n_patterns, (int) n_ids);
+}
+
+/* Map an image file into memory, it returns 0 on success or -1 on failure
+ * with errno set */
+int DFA_image_load(const char *path, struct DFA_image *image)
+{
+    struct stat st;
+    int fd;
+
+    if (!__is_native_layout()) {
+        errno = EINVAL; return -1;
+    }
+
+    if ((fd = open(path, O_RDONLY)) == -1)  return -1;
+    if (fstat(fd, &st) == -1) {
+        close(fd); return -1;
+    }
+    if (st.st_size < __HEADER_SIZE + 256) {
+        close(fd); errno = EINVAL; return -1;
+    }
+
+    image->map_len = (size_t) st.st_size;
+    image->map = mmap(NULL, image->map_len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image->map == MAP_FAILED)  return -1;
+
+    if (__map_image_table(image) == -1)
+    {
+        munmap(image->map, image->map_len);
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Unmap an image loaded by DFA_image_load */
+void DFA_image_unload(struct DFA_image *image)
+{
+    munmap(image->map, image->map_len);
+}
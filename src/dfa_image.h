@@ -0,0 +1,66 @@
+#ifndef __DFA_IMAGE_HEADER__
+#define __DFA_IMAGE_HEADER__
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfa_table.h"
+
+
+/* Version of the image format, bumped on every incompatible change */
+#define DFA_IMAGE_VERSION  1
+
+/* A compiled DFA saved to a file, which can be mapped into memory and used
+ * as it is. All integers of the file are little-endian, laid out as below,
+ * and each array starts at a multiple of 4 bytes:
+ *
+ *     "REDOTDFA"                   magic, 8 bytes
+ *     version                      uint32
+ *     n_states, start, n_classes   uint32 each
+ *     n_patterns, n_accept_ids     uint32 each
+ *     pattern_hash                 uint64
+ *     classmap                     256 bytes
+ *     next                         n_states * n_classes int32
+ *     accept                       (n_states + 7) / 8 bytes, padded to 4
+ *     accept_begin                 n_states + 1 int32
+ *     accept_ids                   n_accept_ids int32
+ *
+ * The arrays of the table point right into the mapped file, so loading an
+ * image copies nothing, and processes loading the same image share its
+ * pages. Loading checks the arrays once, so that a corrupt image is
+ * rejected rather than read out of bounds while matching. */
+struct DFA_image
+{
+    struct DFA_table table;     /* read only, it must not be disposed */
+    int n_patterns;             /* num of patterns the DFA is built from */
+    uint64_t pattern_hash;      /* hash of the patterns, see DFA_image_hash */
+
+    void  *map;                 /* the mapped file */
+    size_t map_len;
+};
+
+
+/* Hash a set of regexps, which tells if an image is built from them */
+uint64_t DFA_image_hash(const char *const *regexps, int n_regexps);
+
+/* Save the compiled DFA of n_patterns patterns to an image file at path, it
+ * returns 0 on success or -1 on failure with errno set. The image is written
+ * to a temporary file next to path, which is then renamed to path, so a
+ * process having the old image mapped keeps it intact, and path never holds
+ * a partial image. */
+int DFA_image_save(const struct DFA_table *table, int n_patterns,
+    uint64_t pattern_hash, const char *path);
+
+/* Map an image file into memory, it returns 0 on success or -1 on failure
+ * with errno set. A file that isn't an image of this version fails with
+ * EINVAL, and so does any image on a big-endian machine or any image with a
+ * target state, byte class or pattern id out of range. */
+int DFA_image_load(const char *path, struct DFA_image *image);
+
+/* Unmap an image loaded by DFA_image_load */
+void DFA_image_unload(struct DFA_image *image);
+
+
+
+#endif /* __DFA_IMAGE_HEADER__ */
@@ -1,245 +1,480 @@
-#include "__dfa_state_set.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "vec.h"
+#include "stats.h"
+#include "dfa.h"
+
+
+/* DFA optimization is done by Hopcroft's partition refinement. States of the
+ * DFA are numbered densely and the partition of them is kept in a single
+ * permutation array, each block of the partition occupies a contiguous range
+ * of the array and every state knows its block and position, so moving a
+ * state between blocks costs O(1).
+ *
+ * The DFA might be partial (missing transitions), so an extra dead state is
+ * added to make it complete, all missing transitions go to the dead state.
+ */
+struct __DFA_partition
+{
+    int n_states;        /* num of states, including the dead state */
+    int n_blocks;        /* num of blocks in the partition */
+
+    int *elems;          /* states ordered by block */
+    int *pos;            /* pos[q] is the index of state q in elems */
+    int *block_of;       /* block_of[q] is the block containing state q */
+
+    int *first;          /* block b occupies elems[first[b] .. end[b]-1] */
+    int *end;
+    int *marked;         /* elems[first[b] .. marked[b]-1] are marked */
+};
+
+/* Inverse transitions of a complete DFA, for each character index a and
+ * state q, pred[begin[a * n_states + q] .. begin[a * n_states + q + 1]-1]
+ * are the states that go to q under the a-th character */
+struct __DFA_inverse
+{
+    int *begin;
+    int *pred;
+};
 
 
-/* stuff all transition characters emitted by specified state to trans_chars */
-static void __DFA_state_collect_transition_chars(
-    const struct DFA_state *state, struct generic_list *trans_chars)
+static void __create_partition(int n_states, struct __DFA_partition *p)
 {
-    int i_trans = 0;
-    for ( ; i_trans < state->n_transitions; i_trans++)
-    {
-        generic_list_add(
-            trans_chars, &state->trans[i_trans].trans_char, 
-            __cmp_char);
-    }
+    p->n_states = n_states;
+    p->n_blocks = 0;
+
+    p->elems    = (int*)mem_alloc(n_states * sizeof(int));
+    p->pos      = (int*)mem_alloc(n_states * sizeof(int));
+    p->block_of = (int*)mem_alloc(n_states * sizeof(int));
+    p->first    = (int*)mem_alloc(n_states * sizeof(int));
+    p->end      = (int*)mem_alloc(n_states * sizeof(int));
+    p->marked   = (int*)mem_alloc(n_states * sizeof(int));
 }
 
-/* Collect all transition chars of states in specified state set */
-static void DFA_states_collect_transition_chars(
-    const struct generic_list *states, struct generic_list *trans_chars)
+static void __destroy_partition(struct __DFA_partition *p)
 {
-    struct DFA_state **state = (struct DFA_state **) states->p_dat;
-    int i_state = 0, n_states = states->length;
-
-    for ( ; i_state < n_states; i_state++, state++) {
-        __DFA_state_collect_transition_chars(*state, trans_chars);
-    }
+    mem_free(p->elems);
+    mem_free(p->pos);
+    mem_free(p->block_of);
+    mem_free(p->first);
+    mem_free(p->end);
+    mem_free(p->marked);
 }
 
-
-/* Initialize 2 state sets for DFA optimization process, one for all
- * non-acceptable states, one for the rest of them (acceptable states). */
-static struct __DFA_state_set *initialize_DFA_state_set(
-    struct DFA_state *dfa_start)
+/* Append a new block containing the states for which is_in[q] == value, it
+ * returns the index of the new block, or -1 if the block would be empty */
+static int __partition_add_block(
+    struct __DFA_partition *p, const char *is_in, char value, int *n_placed)
 {
-    int i_state = 0, n_state;
-    struct generic_list state_list, acceptable, nonacceptable;
-    struct DFA_state **state;
-    struct __DFA_state_set *ll_state_set = __create_empty_stateset_list();
-
-    create_generic_list(struct DFA_state *, &state_list);
-    create_generic_list(struct DFA_state *, &acceptable);
-    create_generic_list(struct DFA_state *, &nonacceptable);
+    int q, b = p->n_blocks;
 
-    /* get all states in the DFA */
-    generic_list_push_back(&state_list, &dfa_start);
-    DFA_traverse(dfa_start, &state_list);
-
-    /* Initialize state sets by placing all acceptable states to the acceptable
-     * list, non-acceptable states goes to nonacceptable list */
-    n_state = state_list.length;
-    for (state = (struct DFA_state **) state_list.p_dat; 
-         i_state < n_state; i_state++, state++)
+    p->first[b] = p->marked[b] = *n_placed;
+    for (q = 0; q < p->n_states; q++)
     {
-        (*state)->is_acceptable ? 
-            generic_list_push_back(&acceptable,    state):
-            generic_list_push_back(&nonacceptable, state);
+        if (is_in[q] != value) continue;
+
+        p->elems[*n_placed] = q;
+        p->pos[q]      = *n_placed;
+        p->block_of[q] = b;
+        (*n_placed)++;
     }
+    p->end[b] = *n_placed;
 
-    /* we've done constructing the 2 initial state sets */
-    (acceptable.length != 0) ?
-        __insert_states_after(&acceptable, ll_state_set):
-        destroy_generic_list(&acceptable);
+    if (p->end[b] == p->first[b]) return -1;
+    return p->n_blocks++;
+}
+
+/* Mark state q by moving it to the marked part of its block */
+static void __partition_mark(struct __DFA_partition *p, int q)
+{
+    int b = p->block_of[q];
+    int i = p->pos[q], j = p->marked[b];
+    int r = p->elems[j];
 
-    (nonacceptable.length != 0) ?
-        __insert_states_after(&nonacceptable, ll_state_set):
-        destroy_generic_list(&nonacceptable);
+    if (i < j) return;      /* already marked */
 
-    destroy_generic_list(&state_list);
-    return ll_state_set;
+    p->elems[i] = r;  p->pos[r] = i;
+    p->elems[j] = q;  p->pos[q] = j;
+    p->marked[b]++;
 }
 
+/* Split the marked states in block b off to a new block. It returns the index
+ * of the new block, or -1 if b is not split since all of its states are
+ * marked. Marks of block b are cleared either way. */
+static int __partition_split(struct __DFA_partition *p, int b)
+{
+    int nb, i;
 
-/* Split state_set to 2 distinguishable state sets by looking at if states in
- * state_set are distinguishable under transition c 
+    if (p->marked[b] == p->end[b])
+    {
+        p->marked[b] = p->first[b];
+        return -1;
+    }
 
-                   c   state_split_0
-       state_set ----<
-                       state_split_1
- */
-static int split_distinguishable_states(
-    struct __DFA_state_set *ll_head,
-    struct __DFA_state_set *state_set, char c)
-{
-    struct generic_list state_split_0, state_split_1;
+    nb = p->n_blocks++;
+    p->first[nb] = p->marked[nb] = p->first[b];
+    p->end[nb]   = p->marked[b];
+    p->first[b]  = p->marked[b];
 
-    struct DFA_state
-        **state = (struct DFA_state**)(state_set->dfa_states.p_dat),
-        *target;
+    for (i = p->first[nb]; i < p->end[nb]; i++) {
+        p->block_of[p->elems[i]] = nb;
+    }
 
-    struct __DFA_state_set *ref;
+    return nb;
+}
 
-    int i_state = 0, n_states = state_set->dfa_states.length;
+/* Split blocks of the partition so that states accepting different sets of
+ * patterns never share a block. For each pattern in turn, the states
+ * accepting it are marked and split off from the rest of their blocks. */
+static void __partition_split_by_patterns(
+    struct __DFA_partition *p, const struct DFA *dfa)
+{
+    const struct DFA_state *state;
+    const int *accepts;
+    int n_patterns = 0, i_state, i, b, *begin, *members;
 
-    create_generic_list(struct DFA_state *, &state_split_0);
-    create_generic_list(struct DFA_state *, &state_split_1);
+    for (i_state = 0; i_state < dfa->n_states; i_state++)
+    {
+        state   = DFA_STATE(dfa, i_state);
+        accepts = DFA_ACCEPTS(dfa, state);
+        for (i = 0; i < state->n_accepts; i++)
+        {
+            if (accepts[i] >= n_patterns)  n_patterns = accepts[i] + 1;
+        }
+    }
 
-    /* use the first state as reference state, all states transiting to ref
-     * goes to state_split_0, otherwise pushed to state_split_1 */
-    ref = __find_state_set(ll_head, DFA_target_of_trans(*state, c));
-    generic_list_push_back(&state_split_0, state);
+    /* a single regexp, acceptable states are already in one block */
+    if (n_patterns <= 1)  return;
 
-    i_state++, state++;    
-    for ( ; i_state < n_states; i_state++, state++)
+    /* counting sort of the states by the patterns they accept, states
+     * accepting pattern i are members[begin[i] .. begin[i+1]-1] */
+    begin = (int*)mem_calloc(n_patterns + 1, sizeof(int));
+    for (i_state = 0; i_state < dfa->n_states; i_state++)
     {
-        target = DFA_target_of_trans(*state, c);
-
-        if (ref != NULL)
-            if (target != NULL)
-                /* test if this state is distinguishable with ref state under
-                 * transition c */
-                ref == __find_state_set(ll_head, target) ?
-                    generic_list_push_back(&state_split_0, state):
-                    generic_list_push_back(&state_split_1, state);
-
-            else   /* no such transition, distinguishable */
-                generic_list_push_back(&state_split_1, state);
-
-        else
-            target != NULL ?
-                generic_list_push_back(&state_split_1, state):
-                generic_list_push_back(&state_split_0, state);
+        state   = DFA_STATE(dfa, i_state);
+        accepts = DFA_ACCEPTS(dfa, state);
+        for (i = 0; i < state->n_accepts; i++)  begin[accepts[i] + 1]++;
     }
+    for (i = 0; i < n_patterns; i++)  begin[i + 1] += begin[i];
 
-    /* we're done splitting the state set, now it's time to submit our 
-     * changes */
-    if (state_split_1.length != 0) /* if we really splitted state_set to 2
-                                    * distinguishable states */
+    members = (int*)mem_alloc((begin[n_patterns] + 1) * sizeof(int));
+    for (i_state = 0; i_state < dfa->n_states; i_state++)
     {
-        __insert_states_after(&state_split_1, state_set);
-        __insert_states_after(&state_split_0, state_set);
-        __remove_DFA_state_set(state_set);
-        return 1;
+        state   = DFA_STATE(dfa, i_state);
+        accepts = DFA_ACCEPTS(dfa, state);
+        for (i = 0; i < state->n_accepts; i++)
+            members[begin[accepts[i]]++] = i_state;
     }
-    else                        /* not splitted, no change to commit */
+    for (i = n_patterns; i > 0; i--)  begin[i] = begin[i - 1];
+    begin[0] = 0;
+
+    for (i = 0; i < n_patterns; i++)
     {
-        destroy_generic_list(&state_split_0);
-        destroy_generic_list(&state_split_1);
-        return 0;
+        for (i_state = begin[i]; i_state < begin[i + 1]; i_state++)
+            __partition_mark(p, members[i_state]);
+
+        /* blocks with marks left are the ones not split yet */
+        for (i_state = begin[i]; i_state < begin[i + 1]; i_state++)
+        {
+            b = p->block_of[members[i_state]];
+            if (p->marked[b] != p->first[b])  __partition_split(p, b);
+        }
     }
+
+    mem_free(begin);
+    mem_free(members);
+}
+
+
+/* Build inverse transitions of the DFA completed with the dead state, where
+ * next[q * n_chars + a] is the target of state q under the a-th character */
+static void __build_inverse(
+    const int *next, int n_states, int n_chars, struct __DFA_inverse *inv)
+{
+    int q, a, n = n_states * n_chars, *fill;
+
+    inv->begin = (int*)mem_calloc(n + 1, sizeof(int));
+    inv->pred  = (int*)mem_alloc(n * sizeof(int));
+
+    /* counting sort of all transitions by (character, target) */
+    for (q = 0; q < n_states; q++)
+        for (a = 0; a < n_chars; a++)
+            inv->begin[a * n_states + next[q * n_chars + a] + 1]++;
+
+    for (a = 0; a < n; a++)  inv->begin[a + 1] += inv->begin[a];
+
+    fill = (int*)mem_alloc(n * sizeof(int));
+    memcpy(fill, inv->begin, n * sizeof(int));
+    for (q = 0; q < n_states; q++)
+        for (a = 0; a < n_chars; a++)
+            inv->pred[fill[a * n_states + next[q * n_chars + a]]++] = q;
+
+    mem_free(fill);
+}
+
+static void __destroy_inverse(struct __DFA_inverse *inv)
+{
+    mem_free(inv->begin);
+    mem_free(inv->pred);
 }
 
 
-/* Split the state set into 2 distinguishable sets, splitted sets might also be
- * splitable. */
-static int split_state_set(
-    struct __DFA_state_set *ll_head, struct __DFA_state_set *state_set)
+/* A splitter in the worklist: block and index of the character */
+struct __splitter
 {
-    struct generic_list trans_chars;
-    int i_char = 0, n_chars;
-    char *c;
+    int block;
+    int a;
+};
 
-    create_generic_list(char, &trans_chars);
-    DFA_states_collect_transition_chars(&state_set->dfa_states, &trans_chars);
+DEFINE_VECTOR(__splitter_vector, struct __splitter)
+DEFINE_VECTOR(__int_vector, int)
 
-    /* investigate every possible transitions to find distinguishable states */
-    n_chars = trans_chars.length;
-    for (c = (char*)trans_chars.p_dat; i_char < n_chars; i_char++, c++)
+/* Push (block, a) to the worklist unless it is already there */
+static void __push_splitter(
+    struct __splitter_vector *worklist, char *in_worklist, int n_chars,
+    int block, int a)
+{
+    struct __splitter sp;
+
+    if (in_worklist[block * n_chars + a]) return;
+    in_worklist[block * n_chars + a] = 1;
+
+    sp.block = block;
+    sp.a     = a;
+    __splitter_vector_push(worklist, sp);
+}
+
+/* Refine the initial partition until no block can be split any further */
+static void __hopcroft_refine(
+    struct __DFA_partition *p, const struct __DFA_inverse *inv, int n_chars)
+{
+    struct __splitter_vector worklist;
+    struct __int_vector preimage, touched;
+    struct __splitter sp;
+    char *in_worklist;
+    int a, b, nb, i, q, i_pred, small, size_b, size_nb;
+
+    __splitter_vector_init(&worklist);
+    __int_vector_init(&preimage);
+    __int_vector_init(&touched);
+    in_worklist = (char*)mem_calloc(p->n_states * n_chars, 1);
+
+    /* all blocks of the initial partition are put as splitters, though one
+     * of them could be left out */
+    for (b = 0; b < p->n_blocks; b++)
+        for (a = 0; a < n_chars; a++)
+            __push_splitter(&worklist, in_worklist, n_chars, b, a);
+
+    while (worklist.length != 0)
     {
-        if (split_distinguishable_states(ll_head, state_set, *c))
+        sp = __splitter_vector_pop(&worklist);
+        in_worklist[sp.block * n_chars + sp.a] = 0;
+
+        /* collect all states going into the splitter block under character
+         * sp.a first, since the splitter block might be split itself */
+        __int_vector_clear(&preimage);
+        for (i = p->first[sp.block]; i < p->end[sp.block]; i++)
+        {
+            q = sp.a * p->n_states + p->elems[i];
+            for (i_pred = inv->begin[q]; i_pred < inv->begin[q + 1]; i_pred++)
+                __int_vector_push(&preimage, inv->pred[i_pred]);
+        }
+
+        /* mark them and remember the blocks they belong to */
+        __int_vector_clear(&touched);
+        for (i = 0; i < preimage.length; i++)
+        {
+            q = preimage.data[i];
+            b = p->block_of[q];
+
+            if (p->marked[b] == p->first[b])
+                __int_vector_push(&touched, b);
+            __partition_mark(p, q);
+        }
+
+        /* split touched blocks and update the worklist */
+        for (i = 0; i < touched.length; i++)
         {
-            /* distinguishable state found and splitted, return immediately
-             * instead of doing more splits  */
-            destroy_generic_list(&trans_chars);
-            return 1;
+            b  = touched.data[i];
+            nb = __partition_split(p, b);
+            if (nb == -1) continue;
+
+            size_b  = p->end[b]  - p->first[b];
+            size_nb = p->end[nb] - p->first[nb];
+            small   = (size_nb < size_b) ? nb : b;
+
+            for (a = 0; a < n_chars; a++)
+            {
+                /* if (b, a) is still waiting, both halves have to be
+                 * processed, otherwise the smaller half is enough */
+                in_worklist[b * n_chars + a] ?
+                    __push_splitter(&worklist, in_worklist, n_chars, nb, a):
+                    __push_splitter(&worklist, in_worklist, n_chars, small, a);
+            }
         }
     }
 
-    /* no distinguishable transition/states found */
-    destroy_generic_list(&trans_chars);
-    return 0;
+    mem_free(in_worklist);
+    __splitter_vector_destroy(&worklist);
+    __int_vector_destroy(&preimage);
+    __int_vector_destroy(&touched);
 }
 
-/* Merge undistinguishable states in specified DFA to state sets */
-static struct __DFA_state_set *merge_DFA_states(struct DFA_state *dfa)
+
+/* Make DFA out of the refined partition, each block becomes a state and the
+ * block of the dead state is left out. States are numbered in BFS order from
+ * the start state, and each state gets all of its transitions at once. */
+static struct DFA *make_optimized_DFA(
+    const struct DFA *dfa, const struct __DFA_partition *p,
+    const int *next, const struct byte_classes *bc)
 {
-    struct __DFA_state_set *ss = initialize_DFA_state_set(dfa);
-    struct __DFA_state_set *cur, *next;
-    int changed;
+    int n_chars = bc->n_classes;
+    struct DFA *opt = create_DFA();
+    const struct DFA_state *rep;
+    int *merged, *order, b, a, q, i, target;
+    int dead_block = p->block_of[p->n_states - 1];
+
+    /* merged[b] is the state made of block b, and order[i] is the block the
+     * state numbered i is made of. The start state is always kept even if
+     * it turns out to be dead. */
+    merged = (int*)mem_alloc(p->n_blocks * sizeof(int));
+    order  = (int*)mem_alloc(p->n_blocks * sizeof(int));
+    for (b = 0; b < p->n_blocks; b++)  merged[b] = -1;
+
+    b = p->block_of[dfa->start];
+    opt->start = merged[b] = alloc_DFA_state(opt);
+    order[opt->start] = b;
+
+    /* states in a block are undistinguishable, so transitions and
+     * acceptability of any state represent the whole block */
+    for (i = 0; i < opt->n_states; i++)
+    {
+        b   = order[i];
+        q   = p->elems[p->first[b]];
+        rep = (q == p->n_states - 1) ? NULL : DFA_STATE(dfa, q);
 
-    do {
-        changed = 0;
-        for (cur = ss->next; cur != ss; cur = next)
+        for (a = 0; rep != NULL && a < n_chars; a++)
         {
-            next = cur->next;
-            changed += split_state_set(ss, cur);
+            target = p->block_of[next[q * n_chars + a]];
+            if (target == dead_block)  continue;
+
+            if (merged[target] == -1)
+            {
+                merged[target] = alloc_DFA_state(opt);
+                order[merged[target]] = target;
+            }
+            DFA_add_transition(opt, i, merged[target],
+                bc->first[a], byte_class_last(bc, a));
         }
-    } while (changed != 0);
 
-    return ss;
+        for (a = 0; rep != NULL && a < rep->n_accepts; a++)
+            DFA_make_acceptable(opt, i, DFA_ACCEPTS(dfa, rep)[a]);
+    }
+    STATS_ADD(n_DFA_opt_states, opt->n_states);
+
+    mem_free(merged);
+    mem_free(order);
+    return opt;
 }
 
-/* Make DFA out of specified collection of state sets */
-static struct DFA_state *make_optimized_DFA(
-    struct __DFA_state_set *head, struct DFA_state *start)
+
+/* Upper bound of the bytes the optimization of the DFA takes at the same
+ * time, n_states includes the dead state. Every (state, character) pair
+ * has a transition in next[], an inverse transition with its index, a flag
+ * and a splitter, where the worklist of splitters may be twice as large as
+ * its contents. The optimized DFA is no larger than the DFA. */
+static size_t __optimization_bytes(
+    const struct DFA *dfa, int n_states, int n_chars)
 {
-    struct __DFA_state_set *cur = head->next, *dest;
-    struct DFA_state **cur_state;
-    int i_state, n_state;
-    int i_trans;
-    char trans_char;
+    size_t n = (size_t) n_states * n_chars;
+
+    return n * (4 * sizeof(int) + 1 + 2 * sizeof(struct __splitter)) +
+        (size_t) n_states * (10 * sizeof(int) + 1) +
+        (size_t) dfa->n_states * sizeof(struct DFA_state) +
+        (size_t) dfa->n_trans * sizeof(struct DFA_transition) +
+        (size_t) dfa->n_accepts * sizeof(int);
+}
+
+/* Simplify DFA by merging undistinguishable states, states accepting
+ * different sets of patterns are never merged */
+struct DFA *DFA_optimize(const struct DFA *dfa)
+{
+    struct DFA *dfa_opt;
+
+    DFA_optimize_within(dfa, NULL, &dfa_opt);
+    return dfa_opt;
+}
 
-    /* allocate DFA state for each merged states */
-    for ( ; cur != head; cur = cur->next) {
-        cur->merged_state = alloc_DFA_state();
+/* Simplify DFA within the budget, the optimized DFA is stored to *dfa_opt on
+ * success. The memory the optimization takes is known before it begins, so
+ * it returns COMPILE_TOO_MANY_BYTES without doing anything if that exceeds
+ * the budget, or COMPILE_OK otherwise. */
+enum compile_error DFA_optimize_within(const struct DFA *dfa,
+    const struct compile_budget *budget, struct DFA **dfa_opt)
+{
+    struct __DFA_partition partition;
+    struct __DFA_inverse inverse;
+    const struct DFA_state *state;
+    const struct DFA_transition *trans;
+
+    struct byte_classes bc;
+    int i_state, i_trans, n_states, n_chars, dead, k, placed = 0;
+    int *next;
+    char *is_acceptable;
+
+    /* states keep their ids, and the dead state comes last */
+    n_states = dfa->n_states + 1;
+    dead     = n_states - 1;
+
+    /* the alphabet is the byte classes of the DFA, bytes in a class always
+     * go to the same state */
+    DFA_byte_classes(dfa, &bc);
+    n_chars = bc.n_classes;
+
+    if (budget != NULL && budget->max_bytes > 0 &&
+        __optimization_bytes(dfa, n_states, n_chars) > budget->max_bytes)
+        return COMPILE_TOO_MANY_BYTES;
+
+    /* complete transition table, missing transitions go to the dead state */
+    next = (int*)mem_alloc(n_chars * n_states * sizeof(int));
+    for (i_state = 0; i_state < n_states * n_chars; i_state++) {
+        next[i_state] = dead;
     }
 
-    /* add transitions to these merged states */
-    for (cur = head->next ; cur != head; cur = cur->next)
+    is_acceptable = (char*)mem_calloc(n_states, 1);
+    for (i_state = 0; i_state < dead; i_state++)
     {
-        cur_state = (struct DFA_state **) cur->dfa_states.p_dat;
-        n_state   = cur->dfa_states.length;
-
-        for (i_state = 0; i_state < n_state; i_state++, cur_state++)
+        state = DFA_STATE(dfa, i_state);
+        trans = DFA_TRANSITIONS(dfa, state);
+        for (i_trans = 0; i_trans < state->n_transitions; i_trans++)
         {
-            for (i_trans = 0; i_trans < (*cur_state)->n_transitions; i_trans++)
-            {
-                dest = __find_state_set(head, (*cur_state)->trans[i_trans].to);
-                trans_char = (*cur_state)->trans[i_trans].trans_char;
-
-                if (DFA_target_of_trans(cur->merged_state, trans_char) == NULL)
-                {
-                    DFA_add_transition(
-                        cur->merged_state, dest->merged_state, trans_char);
-                }
+            for (k = bc.map[trans[i_trans].lo];
+                 k <= bc.map[trans[i_trans].hi]; k++) {
+                next[i_state * n_chars + k] = trans[i_trans].to;
             }
-
-            if ((*cur_state)->is_acceptable)
-                DFA_make_acceptable(cur->merged_state);
         }
+
+        is_acceptable[i_state] = (char) state->is_acceptable;
     }
 
-    /* find the start state of the new DFA and return */
-    return __find_state_set(head, start)->merged_state;
-}
+    /* initial partition: acceptable states and non-acceptable states, and
+     * acceptable states are told apart further by the patterns accepted */
+    __create_partition(n_states, &partition);
+    __partition_add_block(&partition, is_acceptable, 1, &placed);
+    __partition_add_block(&partition, is_acceptable, 0, &placed);
+    __partition_split_by_patterns(&partition, dfa);
 
+    __build_inverse(next, n_states, n_chars, &inverse);
+    __hopcroft_refine(&partition, &inverse, n_chars);
 
-/* Simplify DFA by merging undistinguishable states */
-struct DFA_state *DFA_optimize(const struct DFA_state *dfa)
-{
-    struct DFA_state *_dfa = (struct DFA_state *) dfa;
-    struct __DFA_state_set *ss = merge_DFA_states(_dfa);
-    struct DFA_state *dfa_opt = make_optimized_DFA(ss, _dfa);
-    __destroy_DFA_stateset_list(ss);
-    return dfa_opt;
+    *dfa_opt = make_optimized_DFA(dfa, &partition, next, &bc);
+
+    __destroy_inverse(&inverse);
+    __destroy_partition(&partition);
+    mem_free(is_acceptable);
+    mem_free(next);
+
+    return COMPILE_OK;
 }
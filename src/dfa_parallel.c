@@ -0,0 +1,201 @@
+#include <pthread.h>
+
+#include "mem.h"
+#include "dfa_parallel.h"
+
+
+/* Bytes run between merges of the runs that reached the same state */
+#define __MERGE_INTERVAL  64
+
+
+/* A chunk of the input along with the scratch space to run it, every thread
+ * works on its own chunk so nothing is shared but the table */
+struct __chunk_task
+{
+    const struct DFA_table *table;
+    const unsigned char *begin, *end;
+    int is_from_start;  /* if the chunk is run from the start state only */
+
+    int *map;           /* run map[s] is the one begun from state s, and it
+                         * becomes the state reached from s in the end */
+    int *runs;          /* current state of each distinct run */
+    int *slot;          /* run a state is taken by while merging, or -1 */
+    int *remap;         /* where each run goes when merging */
+    int n_runs;
+
+    int final;          /* state reached from the start state, which is
+                         * valid only if is_from_start is non-zero */
+};
+
+
+/* Run a single state over [p, end) */
+static int __run_one(const struct DFA_table *table, int s,
+    const unsigned char *p, const unsigned char *end)
+{
+    const unsigned char *classmap = table->classmap;
+    const int *next = table->next;
+    int n_classes = table->n_classes;
+
+    for ( ; p != end; p++)
+    {
+        s = next[s * n_classes + classmap[*p]];
+        if (s == DFA_DEAD_STATE)  break;
+    }
+
+    return s;
+}
+
+/* Merge runs that reached the same state, runs are kept in the order of
+ * their first appearance */
+static void __merge_runs(struct __chunk_task *task)
+{
+    int n_states = task->table->n_states, n_runs = 0, i, s;
+
+    for (i = 0; i < task->n_runs; i++)
+    {
+        s = task->runs[i];
+        if (task->slot[s] == -1)
+        {
+            task->slot[s] = n_runs;
+            task->runs[n_runs++] = s;
+        }
+        task->remap[i] = task->slot[s];
+    }
+
+    for (i = 0; i < n_runs; i++)  task->slot[task->runs[i]] = -1;
+    for (s = 0; s < n_states; s++)  task->map[s] = task->remap[task->map[s]];
+    task->n_runs = n_runs;
+}
+
+/* Run the chunk from every state at once, until the runs are merged into
+ * a single one which is then run alone */
+static void __run_from_all(struct __chunk_task *task)
+{
+    const struct DFA_table *table = task->table;
+    const unsigned char *classmap = table->classmap;
+    const unsigned char *p = task->begin, *stop;
+    const int *next = table->next;
+    int n_classes = table->n_classes, n_states = table->n_states, i, s;
+    int *runs = task->runs;
+
+    for (s = 0; s < n_states; s++)
+    {
+        task->map[s]  = s;
+        task->runs[s] = s;
+        task->slot[s] = -1;
+    }
+    task->n_runs = n_states;
+
+    while (p != task->end && task->n_runs > 1)
+    {
+        stop = (task->end - p > __MERGE_INTERVAL) ?
+            p + __MERGE_INTERVAL : task->end;
+
+        for ( ; p != stop; p++)
+        {
+            for (i = 0; i < task->n_runs; i++)
+                runs[i] = next[runs[i] * n_classes + classmap[*p]];
+        }
+        __merge_runs(task);
+    }
+
+    if (task->n_runs == 1)  runs[0] = __run_one(table, runs[0], p, task->end);
+    for (s = 0; s < n_states; s++)  task->map[s] = runs[task->map[s]];
+}
+
+/* Thread entry of a chunk task */
+static void *__run_chunk(void *arg)
+{
+    struct __chunk_task *task = (struct __chunk_task*) arg;
+
+    if (task->is_from_start)
+    {
+        task->final = __run_one(task->table, task->table->start,
+            task->begin, task->end);
+    }
+    else {
+        __run_from_all(task);
+    }
+
+    return NULL;
+}
+
+
+/* Run the compiled DFA over the whole buffer with n_threads threads, it
+ * returns the state reached at the end of the buffer */
+int DFA_parallel_run(const struct DFA_table *table,
+    const char *buf, size_t len, int n_threads)
+{
+    const unsigned char *p = (const unsigned char*) buf;
+    struct __chunk_task *tasks;
+    pthread_t *threads;
+    int *is_started, *scratch;
+    int n_chunks = n_threads, n_states = table->n_states, i, s;
+    size_t chunk_len;
+
+    if ((size_t) n_chunks > len / DFA_PARALLEL_MIN_CHUNK)
+        n_chunks = (int)(len / DFA_PARALLEL_MIN_CHUNK);
+    if (n_chunks <= 1)
+        return __run_one(table, table->start, p, p + len);
+
+    /* everything is allocated up front, the threads never allocate */
+    tasks   = (struct __chunk_task*)mem_alloc(
+        n_chunks * sizeof(struct __chunk_task));
+    threads = (pthread_t*)mem_alloc(n_chunks * sizeof(pthread_t));
+    is_started = (int*)mem_alloc(n_chunks * sizeof(int));
+    scratch = (int*)mem_alloc(
+        (size_t)(n_chunks - 1) * 4 * n_states * sizeof(int));
+
+    chunk_len = len / n_chunks;
+    for (i = 0; i < n_chunks; i++)
+    {
+        tasks[i].table = table;
+        tasks[i].begin = p + i * chunk_len;
+        tasks[i].end   = (i + 1 < n_chunks) ? p + (i + 1) * chunk_len :
+            p + len;
+        tasks[i].is_from_start = (i == 0);
+
+        if (i != 0)
+        {
+            tasks[i].map   = scratch + (size_t)(i - 1) * 4 * n_states;
+            tasks[i].runs  = tasks[i].map  + n_states;
+            tasks[i].slot  = tasks[i].runs + n_states;
+            tasks[i].remap = tasks[i].slot + n_states;
+        }
+    }
+
+    /* the calling thread takes the first chunk, and takes any chunk a thread
+     * can't be created for as well */
+    for (i = 1; i < n_chunks; i++)
+    {
+        is_started[i] = pthread_create(
+            threads + i, NULL, __run_chunk, tasks + i) == 0;
+    }
+    __run_chunk(tasks);
+    for (i = 1; i < n_chunks; i++)
+    {
+        if (is_started[i])
+            pthread_join(threads[i], NULL);
+        else
+            __run_chunk(tasks + i);
+    }
+
+    /* chain up the mappings of the chunks */
+    s = tasks[0].final;
+    for (i = 1; i < n_chunks; i++)  s = tasks[i].map[s];
+
+    mem_free(scratch);
+    mem_free(is_started);
+    mem_free(threads);
+    mem_free(tasks);
+    return s;
+}
+
+/* Check if the whole buffer matches the compiled DFA, using n_threads
+ * threads */
+int DFA_parallel_match(const struct DFA_table *table,
+    const char *buf, size_t len, int n_threads)
+{
+    int s = DFA_parallel_run(table, buf, len, n_threads);
+    return DFA_table_is_acceptable(table, s);
+}
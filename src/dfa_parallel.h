@@ -0,0 +1,37 @@
+#ifndef __DFA_PARALLEL_HEADER__
+#define __DFA_PARALLEL_HEADER__
+
+
+#include <stddef.h>
+
+#include "dfa_table.h"
+
+
+/* Inputs shorter than this are never split into more than one chunk for each
+ * thread to work on */
+#define DFA_PARALLEL_MIN_CHUNK  (64 * 1024)
+
+
+/* Run the compiled DFA over the whole buffer with n_threads threads, it
+ * returns the state reached at the end of the buffer.
+ *
+ * The buffer is split into one chunk per thread. The first chunk is run from
+ * the start state, while the state a later chunk begins with is not known
+ * until the chunks before it are done, so it is run speculatively from every
+ * state of the DFA at once, which gives a mapping from the state the chunk
+ * begins with to the state it ends with. Runs reaching the same state have
+ * the same future and are merged as the chunk goes on, which happens very
+ * soon in practice, so the cost of a chunk is close to that of a single run
+ * unless the DFA has a lot of states. The mappings are then chained up in
+ * order. */
+int DFA_parallel_run(const struct DFA_table *table,
+    const char *buf, size_t len, int n_threads);
+
+/* Check if the whole buffer matches the compiled DFA, using n_threads
+ * threads */
+int DFA_parallel_match(const struct DFA_table *table,
+    const char *buf, size_t len, int n_threads);
+
+
+
+#endif /* __DFA_PARALLEL_HEADER__ */
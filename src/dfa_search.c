@@ -0,0 +1,507 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mem.h"
+#include "vec.h"
+#include "sset.h"
+#include "stats.h"
+#include "__nfa_state_set.h"
+#include "dfa.h"
+#include "dfa_search.h"
+
+
+/* A state of the forward DFA is a sequence of NFA states in priority order.
+ * Only NFA states having character transitions and the terminate state are
+ * kept in it, the others are passed through by epsilon closures anyway. Two
+ * special elements may show up in a sequence: */
+#define SEQ_MARK  (-1)  /* boundary between threads of different starts, it
+                         * is only used for leftmost-longest search */
+#define SEQ_LOOP  (-2)  /* the .* prefix, it starts a new thread at every
+                         * byte and it's always the last element */
+#define SEQ_OLD   (-3)  /* first element of a sequence having threads started
+                         * before the last byte, which keeps it apart from the
+                         * start state even if their NFA states are the same,
+                         * so the DFA is back in its start state only when no
+                         * match can start earlier */
+
+DEFINE_VECTOR(__int_vector, int)
+DEFINE_VECTOR(__hash_vector, uint64_t)
+
+/* Subset construction of the forward DFA, states are numbered in the order
+ * they are found, and state 0 is the dead state (the empty sequence) */
+struct __search_builder
+{
+    const struct NFA *nfa;
+    enum DFA_match_kind kind;
+    struct byte_classes classes;    /* byte classes of the NFA */
+
+    struct __int_vector elems;      /* sequences of all states, the one of
+                                     * state s is elems[begin[s] ..
+                                     * begin[s+1]-1] */
+    struct __int_vector begin;
+    struct __hash_vector hashes;    /* hash value of each sequence */
+    struct __int_vector is_matching;   /* 1 if the state ends a match */
+    struct __int_vector next;       /* transition table, rows of n_classes */
+
+    int *slots;                     /* state id, or -1 if empty */
+    int  n_slots;                   /* size of hash table, a power of 2 */
+
+    /* scratch space for computing transitions */
+    struct __int_vector seq;        /* sequence being built */
+    int has_old;                    /* if seq has threads started before
+                                     * the last byte */
+    struct __int_vector stack;      /* DFS stack of epsilon closures */
+    struct sparse_set visited;      /* NFA states already in seq */
+};
+
+#define INITIAL_SEARCH_SLOTS  64    /* default size of the hash table */
+
+
+static void __create_search_builder(const struct NFA *nfa,
+    enum DFA_match_kind kind, struct __search_builder *b)
+{
+    b->nfa  = nfa;
+    b->kind = kind;
+    NFA_byte_classes(nfa, &b->classes);
+
+    __int_vector_init(&b->elems);
+    __int_vector_init(&b->begin);
+    __hash_vector_init(&b->hashes);
+    __int_vector_init(&b->is_matching);
+    __int_vector_init(&b->next);
+
+    b->n_slots = INITIAL_SEARCH_SLOTS;
+    b->slots   = (int*)mem_alloc(b->n_slots * sizeof(int));
+    memset(b->slots, -1, b->n_slots * sizeof(int));
+
+    __int_vector_init(&b->seq);
+    __int_vector_init(&b->stack);
+    create_sparse_set(nfa->arena->n_states, &b->visited);
+}
+
+static void __destroy_search_builder(struct __search_builder *b)
+{
+    __int_vector_destroy(&b->elems);
+    __int_vector_destroy(&b->begin);
+    __hash_vector_destroy(&b->hashes);
+    __int_vector_destroy(&b->is_matching);
+    __int_vector_destroy(&b->next);
+    mem_free(b->slots);
+
+    __int_vector_destroy(&b->seq);
+    __int_vector_destroy(&b->stack);
+    destroy_sparse_set(&b->visited);
+}
+
+
+/* Append the epsilon closure of NFA state id to the sequence. The closure is
+ * walked depth first and the first transition of a state is followed first,
+ * which gives the order a backtracking matcher would try the states in. NFA
+ * states already in the sequence are of higher priority, they're skipped. */
+static void __append_closure(struct __search_builder *b, int id)
+{
+    const struct NFA_state *state;
+    int i_trans, n_trans, has_char;
+
+    __int_vector_push(&b->stack, id);
+    while (b->stack.length != 0)
+    {
+        id = __int_vector_pop(&b->stack);
+        if (sparse_set_contains(&b->visited, id))  continue;
+        sparse_set_add(&b->visited, id);
+
+        state   = NFA_STATE(b->nfa, id);
+        n_trans = NFA_state_transition_num(state);
+
+        has_char = 0;
+        for (i_trans = 0; i_trans < n_trans; i_trans++)
+        {
+            if (state->transition[i_trans].trans_type == NFATT_CHARACTER)
+                has_char = 1;
+        }
+        if (has_char || id == b->nfa->terminate)
+            __int_vector_push(&b->seq, id);
+
+        /* push the second transition first, so the first one is popped and
+         * walked first */
+        for (i_trans = n_trans - 1; i_trans >= 0; i_trans--)
+        {
+            if (state->transition[i_trans].trans_type == NFATT_EPSILON)
+                __int_vector_push(&b->stack, state->to[i_trans]);
+        }
+    }
+}
+
+/* Append the threads started by the .* prefix: a new thread from the start
+ * state, which is of lower priority than all threads started before, and
+ * the prefix itself */
+static void __append_loop(struct __search_builder *b)
+{
+    if (b->kind == DFA_LEFTMOST_LONGEST)
+        __int_vector_push(&b->seq, SEQ_MARK);
+    __append_closure(b, b->nfa->start);
+
+    if (b->kind == DFA_LEFTMOST_LONGEST)
+        __int_vector_push(&b->seq, SEQ_MARK);
+    __int_vector_push(&b->seq, SEQ_LOOP);
+}
+
+static int __compare_int(const void *a, const void *b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+/* Drop the threads of lower priority than a thread reaching the terminate
+ * state and turn the sequence to its canonical form, this function returns 1
+ * if the sequence ends a match */
+static int __finish_sequence(struct __search_builder *b)
+{
+    int *seq = b->seq.data, len = b->seq.length;
+    int i = 0, n = 0, group = 0, is_matching = 0;
+
+    for ( ; i < len; i++)
+    {
+        if (seq[i] != b->nfa->terminate)  continue;
+
+        /* a leftmost-longest search keeps the whole group of threads having
+         * the same start, since any of them might make a longer match */
+        is_matching = 1;
+        if (b->kind == DFA_LEFTMOST_LONGEST)
+            while (i + 1 < len && seq[i + 1] != SEQ_MARK)  i++;
+        len = i + 1;
+    }
+
+    /* threads of the same start are not ordered by priority in a
+     * leftmost-longest search, so each group is sorted, and empty groups
+     * are removed */
+    if (b->kind == DFA_LEFTMOST_LONGEST)
+    {
+        for (i = 0; i < len; i++)
+        {
+            if (seq[i] != SEQ_MARK)
+            {
+                seq[n++] = seq[i];
+                continue;
+            }
+            if (n == group)  continue;
+
+            qsort(seq + group, n - group, sizeof(int), __compare_int);
+            seq[n++] = SEQ_MARK;
+            group = n;
+        }
+        qsort(seq + group, n - group, sizeof(int), __compare_int);
+        if (n != 0 && seq[n - 1] == SEQ_MARK)  n--;
+        len = n;
+    }
+
+    b->seq.length = len;
+    return is_matching;
+}
+
+/* Get the state of the sequence just built, a new state is registered if the
+ * sequence is never seen before */
+static int __get_search_state(struct __search_builder *b, int is_matching)
+{
+    const int *elems;
+    uint64_t hash;
+    int mask, i_slot, s, length = b->seq.length, n_probes = 1, i;
+
+    STATS_INC(n_set_lookups);
+
+    hash = __hash_bitset((const uint32_t*) b->seq.data, length);
+    mask = b->n_slots - 1;
+    for (i_slot = (int)(hash & mask); (s = b->slots[i_slot]) != -1;
+         i_slot = (i_slot + 1) & mask, n_probes++)
+    {
+        elems = b->elems.data + b->begin.data[s];
+        if (b->hashes.data[s] == hash &&
+            b->begin.data[s + 1] - b->begin.data[s] == length &&
+            memcmp(elems, b->seq.data, length * sizeof(int)) == 0)
+        {
+            break;
+        }
+    }
+    STATS_ADD(n_hash_probes, n_probes);
+    if (s != -1)  return s;
+
+    /* not found, register a new state */
+    s = b->hashes.length;
+    b->slots[i_slot] = s;
+    for (i = 0; i < length; i++)
+        __int_vector_push(&b->elems, b->seq.data[i]);
+    __int_vector_push(&b->begin, b->elems.length);
+    __hash_vector_push(&b->hashes, hash);
+    __int_vector_push(&b->is_matching, is_matching);
+
+    /* keep the load factor of the hash table below 1/2 */
+    if (b->hashes.length * 2 > b->n_slots)
+    {
+        mem_free(b->slots);
+        b->n_slots *= 2;
+        b->slots = (int*)mem_alloc(b->n_slots * sizeof(int));
+        memset(b->slots, -1, b->n_slots * sizeof(int));
+
+        mask = b->n_slots - 1;
+        for (s = 0; s < b->hashes.length; s++)
+        {
+            i_slot = (int)(b->hashes.data[s] & mask);
+            while (b->slots[i_slot] != -1)  i_slot = (i_slot + 1) & mask;
+            b->slots[i_slot] = s;
+        }
+        s = b->hashes.length - 1;
+    }
+
+    return s;
+}
+
+/* Check if the sequence being built has any thread */
+static int __has_threads(const struct __search_builder *b)
+{
+    int i;
+
+    for (i = 0; i < b->seq.length; i++)
+        if (b->seq.data[i] >= 0)  return 1;
+    return 0;
+}
+
+/* Mark the sequence just finished if it has threads started before the last
+ * byte, a sequence without any thread stays the dead state */
+static void __mark_old(struct __search_builder *b)
+{
+    if (!b->has_old || b->seq.length == 0)  return;
+
+    __int_vector_push(&b->seq, 0);
+    memmove(b->seq.data + 1, b->seq.data,
+        (b->seq.length - 1) * sizeof(int));
+    b->seq.data[0] = SEQ_OLD;
+}
+
+/* Build the sequence of the target of state s under byte class k */
+static void __step_sequence(struct __search_builder *b, int s, int k)
+{
+    const struct NFA_state *state;
+    unsigned char c = b->classes.first[k];
+    int i, e, i_trans, n_trans;
+
+    __int_vector_clear(&b->seq);
+    sparse_set_clear(&b->visited);
+    b->has_old = 1;
+
+    for (i = b->begin.data[s]; i < b->begin.data[s + 1]; i++)
+    {
+        e = b->elems.data[i];
+        if (e == SEQ_OLD)  continue;
+
+        if (e == SEQ_MARK) {
+            __int_vector_push(&b->seq, SEQ_MARK);
+        }
+        else if (e == SEQ_LOOP)
+        {
+            b->has_old = __has_threads(b);
+            __append_loop(b);
+        }
+        else
+        {
+            state   = NFA_STATE(b->nfa, e);
+            n_trans = NFA_state_transition_num(state);
+            for (i_trans = 0; i_trans < n_trans; i_trans++)
+            {
+                if (NFA_transition_accepts(state->transition + i_trans, c))
+                    __append_closure(b, state->to[i_trans]);
+            }
+        }
+    }
+}
+
+/* Construct all states of the forward DFA reachable from the start state
+ * within the budget (which may be NULL), the bytes are counted from base */
+static enum compile_error __build_search_states(struct __search_builder *b,
+    const struct compile_budget *budget, size_t base)
+{
+    enum compile_error error;
+    int s, k, is_matching;
+
+    /* the dead state is the empty sequence */
+    __int_vector_push(&b->begin, 0);
+    __int_vector_clear(&b->seq);
+    __get_search_state(b, 0);
+
+    /* the start state runs the thread starting at offset 0 before the .*
+     * prefix starts any other */
+    sparse_set_clear(&b->visited);
+    __append_closure(b, b->nfa->start);
+    if (b->kind == DFA_LEFTMOST_LONGEST)
+        __int_vector_push(&b->seq, SEQ_MARK);
+    __int_vector_push(&b->seq, SEQ_LOOP);
+    is_matching = __finish_sequence(b);
+    __get_search_state(b, is_matching);
+
+    /* the list of states is the worklist, the row of a state is appended
+     * to the table when it's taken from the list */
+    for (s = 0; s < b->hashes.length; s++)
+    {
+        if ((error = budget_check(budget, 0, b->hashes.length, base)) !=
+            COMPILE_OK)
+            return error;
+
+        for (k = 0; k < b->classes.n_classes; k++)
+        {
+            if (s == DFA_DEAD_STATE) {
+                __int_vector_push(&b->next, DFA_DEAD_STATE);
+                continue;
+            }
+
+            __step_sequence(b, s, k);
+            is_matching = __finish_sequence(b);
+            __mark_old(b);
+            __int_vector_push(&b->next, __get_search_state(b, is_matching));
+        }
+    }
+
+    STATS_ADD(n_DFA_states, b->hashes.length);
+    return COMPILE_OK;
+}
+
+/* Move the constructed states to a DFA table, a state ending a match accepts
+ * the pattern numbered 0 */
+static void __compile_search_table(
+    const struct __search_builder *b, struct DFA_table *table)
+{
+    int s, n_states = b->hashes.length, n_matching = 0;
+
+    table->n_states  = n_states;
+    table->start     = 1;
+    table->n_classes = b->classes.n_classes;
+    memcpy(table->classmap, b->classes.map, sizeof(table->classmap));
+
+    table->next = (int*)mem_alloc(b->next.length * sizeof(int));
+    memcpy(table->next, b->next.data, b->next.length * sizeof(int));
+
+    table->accept = (unsigned char*)mem_calloc((n_states + 7) / 8, 1);
+    table->accept_begin = (int*)mem_alloc((n_states + 1) * sizeof(int));
+    table->accept_ids   = (int*)mem_calloc(n_states, sizeof(int));
+
+    for (s = 0; s < n_states; s++)
+    {
+        table->accept_begin[s] = n_matching;
+        if (!b->is_matching.data[s])  continue;
+
+        table->accept[s >> 3] |= (unsigned char)(1 << (s & 7));
+        n_matching++;
+    }
+    table->accept_begin[n_states] = n_matching;
+}
+
+
+/* Build a searcher from the NFA of a regexp and the NFA of its reversal, which
+ * is made by reg_to_reversed_NFA. The NFAs are not needed by the searcher and
+ * can be disposed afterwards. */
+void create_DFA_searcher(const struct NFA *nfa, const struct NFA *reversed,
+    enum DFA_match_kind kind, struct DFA_searcher *searcher)
+{
+    create_DFA_searcher_within(nfa, reversed, kind, NULL, searcher);
+}
+
+/* Build a searcher just like create_DFA_searcher within the budget (which
+ * may be NULL), each of the forward and reverse DFAs is held to it. It
+ * returns COMPILE_OK, or the error found and then nothing is left
+ * allocated. */
+enum compile_error create_DFA_searcher_within(const struct NFA *nfa,
+    const struct NFA *reversed, enum DFA_match_kind kind,
+    const struct compile_budget *budget, struct DFA_searcher *searcher)
+{
+    struct __search_builder b;
+    struct DFA *dfa, *dfa_opt;
+    enum compile_error error;
+
+    searcher->kind = kind;
+
+    __create_search_builder(nfa, kind, &b);
+    error = __build_search_states(&b, budget, budget_bytes_base());
+    if (error == COMPILE_OK)
+        __compile_search_table(&b, &searcher->forward);
+    __destroy_search_builder(&b);
+    if (error != COMPILE_OK)  return error;
+
+    /* the start of a match is found by the longest match of the reversed
+     * pattern ending at the end of the match */
+    if ((error = NFA_to_DFA_within(reversed, budget, &dfa)) != COMPILE_OK)
+    {
+        DFA_table_dispose(&searcher->forward); return error;
+    }
+    error = DFA_optimize_within(dfa, budget, &dfa_opt);
+    DFA_dispose(dfa);
+    if (error != COMPILE_OK)
+    {
+        DFA_table_dispose(&searcher->forward); return error;
+    }
+
+    DFA_compile(dfa_opt, &searcher->reverse);
+    DFA_dispose(dfa_opt);
+    return COMPILE_OK;
+}
+
+/* Free the memory allocated for the searcher */
+void destroy_DFA_searcher(struct DFA_searcher *searcher)
+{
+    DFA_table_dispose(&searcher->forward);
+    DFA_table_dispose(&searcher->reverse);
+}
+
+/* Find the first match in buf, it returns 1 and stores the offsets of the
+ * match to [*match_start, *match_end) if there's one, or it returns 0 if
+ * nothing in buf matches */
+int DFA_searcher_find(const struct DFA_searcher *searcher,
+    const char *buf, size_t len, size_t *match_start, size_t *match_end)
+{
+    const struct DFA_table *fwd = &searcher->forward;
+    const unsigned char *p = (const unsigned char*) buf;
+    size_t i, end = 0;
+    int s, is_matched;
+
+    /* the forward DFA dies once the match can't be extended any more, it
+     * doesn't die at all if nothing has been matched */
+    s = fwd->start;
+    is_matched = DFA_table_is_acceptable(fwd, s);
+    for (i = 0; i < len; i++)
+    {
+        s = fwd->next[s * fwd->n_classes + fwd->classmap[p[i]]];
+        if (s == DFA_DEAD_STATE)  break;
+
+        if (DFA_table_is_acceptable(fwd, s)) {
+            is_matched = 1;
+            end = i + 1;
+        }
+    }
+    if (!is_matched)  return 0;
+
+    *match_start = DFA_searcher_match_start(searcher, buf, end);
+    *match_end   = end;
+    return 1;
+}
+
+/* Find where the match ending at match_end starts, given the end the
+ * forward table found from the beginning of buf. The reverse DFA reads
+ * backwards from match_end until it dies, which may be past the start of
+ * the match, as far as the beginning of buf. */
+size_t DFA_searcher_match_start(const struct DFA_searcher *searcher,
+    const char *buf, size_t match_end)
+{
+    const struct DFA_table *rev = &searcher->reverse;
+    const unsigned char *p = (const unsigned char*) buf;
+    size_t i, start = match_end;
+    int s = rev->start;
+
+    /* the leftmost start of the matches ending at match_end is the start of
+     * the match, since the forward DFA prefers earlier starts */
+    for (i = match_end; i > 0; i--)
+    {
+        s = rev->next[s * rev->n_classes + rev->classmap[p[i - 1]]];
+        if (s == DFA_DEAD_STATE)  break;
+
+        if (DFA_table_is_acceptable(rev, s))  start = i - 1;
+    }
+
+    return start;
+}
@@ -0,0 +1,74 @@
+#ifndef __DFA_SEARCH_HEADER__
+#define __DFA_SEARCH_HEADER__
+
+
+#include <stddef.h>
+
+#include "nfa.h"
+#include "dfa_table.h"
+
+
+/* Which match to report if several of them overlap */
+enum DFA_match_kind
+{
+    DFA_LEFTMOST_LONGEST,  /* leftmost start, and the longest match there */
+    DFA_LEFTMOST_FIRST     /* leftmost start, and the match a backtracking
+                            * matcher would find there: the left operand of
+                            * | is preferred and closures are greedy */
+};
+
+/* Unanchored search in a single pass over the input. The forward DFA runs the
+ * pattern with an implicit lazy .* prefix and finds where the match ends, then
+ * the reverse DFA, built from the NFA of the reversed pattern, runs backwards
+ * from there to find where the match starts.
+ *
+ * States of the forward DFA are sequences of NFA states ordered by priority
+ * rather than sets, threads started earlier come first. Once a thread
+ * reaches the terminate state, threads of lower priority are dropped, so the
+ * DFA dies as soon as the match can't be extended, and no thread starting
+ * after the match is ever run. The DFA is back in its start state only when
+ * every thread started before has died, so no match starts before where it
+ * was last in that state. Both DFAs are compiled to tables indexed by byte
+ * class. */
+struct DFA_searcher
+{
+    enum DFA_match_kind kind;
+
+    struct DFA_table forward;   /* acceptable states end a match */
+    struct DFA_table reverse;   /* anchored DFA of the reversed pattern */
+};
+
+
+/* Build a searcher from the NFA of a regexp and the NFA of its reversal, which
+ * is made by reg_to_reversed_NFA. The NFAs are not needed by the searcher and
+ * can be disposed afterwards. */
+void create_DFA_searcher(const struct NFA *nfa, const struct NFA *reversed,
+    enum DFA_match_kind kind, struct DFA_searcher *searcher);
+
+/* Build a searcher just like create_DFA_searcher within the budget (which
+ * may be NULL), each of the forward and reverse DFAs is held to it. It
+ * returns COMPILE_OK, or the error found and then nothing is left
+ * allocated. */
+enum compile_error create_DFA_searcher_within(const struct NFA *nfa,
+    const struct NFA *reversed, enum DFA_match_kind kind,
+    const struct compile_budget *budget, struct DFA_searcher *searcher);
+
+/* Free the memory allocated for the searcher */
+void destroy_DFA_searcher(struct DFA_searcher *searcher);
+
+/* Find the first match in buf, it returns 1 and stores the offsets of the
+ * match to [*match_start, *match_end) if there's one, or it returns 0 if
+ * nothing in buf matches */
+int DFA_searcher_find(const struct DFA_searcher *searcher,
+    const char *buf, size_t len, size_t *match_start, size_t *match_end);
+
+/* Find where the match ending at match_end starts, given the end the
+ * forward table found from the beginning of buf. The reverse DFA reads
+ * backwards from match_end until it dies, which may be past the start of
+ * the match, as far as the beginning of buf. */
+size_t DFA_searcher_match_start(const struct DFA_searcher *searcher,
+    const char *buf, size_t match_end);
+
+
+
+#endif /* __DFA_SEARCH_HEADER__ */
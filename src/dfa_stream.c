@@ -0,0 +1,61 @@
+#include "dfa_stream.h"
+
+
+/* Start matching a new input against the compiled DFA */
+void DFA_stream_init(struct DFA_stream *stream, const struct DFA_table *table)
+{
+    DFA_stream_init_at(stream, table, 0);
+}
+
+/* Start matching against the compiled DFA at the given offset of the input,
+ * which the offsets of the stream count from */
+void DFA_stream_init_at(struct DFA_stream *stream,
+    const struct DFA_table *table, size_t offset)
+{
+    stream->table  = table;
+    stream->state  = table->start;
+    stream->offset = offset;
+
+    /* the empty prefix is accepted if the start state is acceptable */
+    stream->is_matched = DFA_table_is_acceptable(table, table->start);
+    stream->match_end  = offset;
+    stream->last_start = offset;
+}
+
+/* Feed the next chunk of the input. It returns 0 once the DFA is dead, and
+ * then nothing fed afterwards would ever change the result. */
+int DFA_stream_feed(struct DFA_stream *stream, const char *buf, size_t len)
+{
+    const struct DFA_table *table = stream->table;
+    const unsigned char *begin = (const unsigned char*) buf;
+    const unsigned char *p = begin, *end = begin + len;
+    const unsigned char *classmap = table->classmap;
+    const int *next = table->next;
+    int s = stream->state, n_classes = table->n_classes, start = table->start;
+
+    if (s == DFA_DEAD_STATE)  return 0;
+
+    for ( ; p != end; p++)
+    {
+        s = next[s * n_classes + classmap[*p]];
+        if (s == DFA_DEAD_STATE)  break;
+
+        if (s == start)
+            stream->last_start = stream->offset + (size_t)(p - begin) + 1;
+        if (DFA_table_is_acceptable(table, s))
+        {
+            stream->is_matched = 1;
+            stream->match_end  = stream->offset + (size_t)(p - begin) + 1;
+        }
+    }
+
+    stream->state   = s;
+    stream->offset += len;
+    return s != DFA_DEAD_STATE;
+}
+
+/* Finish the input, it returns 1 if the whole input fed matches the DFA */
+int DFA_stream_finish(const struct DFA_stream *stream)
+{
+    return DFA_table_is_acceptable(stream->table, stream->state);
+}
@@ -0,0 +1,54 @@
+#ifndef __DFA_STREAM_HEADER__
+#define __DFA_STREAM_HEADER__
+
+
+#include <stddef.h>
+
+#include "dfa_table.h"
+
+
+/* Matching context of a compiled DFA over an input arriving in chunks. The
+ * state of the DFA is carried from one chunk to the next, so the input never
+ * has to be in memory as a whole, and it may contain any byte including
+ * zeros.
+ *
+ * The DFA is anchored at where the stream starts. Running the forward table
+ * of a DFA_searcher makes it an unanchored search instead: the table dies
+ * once the leftmost-longest match is settled, and match_end is where that
+ * match ends. Offsets count from the beginning of the whole input, so a
+ * search resumed after a match with DFA_stream_init_at reports offsets
+ * across all the chunks. The searcher's table is back in its start state
+ * only when no match can start before, so the input before last_start is
+ * never needed to find where the match starts. */
+struct DFA_stream
+{
+    const struct DFA_table *table;  /* DFA being run */
+    int state;                      /* current state of the DFA */
+
+    size_t offset;      /* num of bytes fed so far */
+    int is_matched;     /* if any prefix of the input fed so far is accepted
+                         * by the DFA */
+    size_t match_end;   /* length of the longest accepted prefix, which is
+                         * valid only if is_matched is non-zero */
+    size_t last_start;  /* last offset where the DFA was in its start state */
+};
+
+
+/* Start matching a new input against the compiled DFA */
+void DFA_stream_init(struct DFA_stream *stream, const struct DFA_table *table);
+
+/* Start matching against the compiled DFA at the given offset of the input,
+ * which the offsets of the stream count from */
+void DFA_stream_init_at(struct DFA_stream *stream,
+    const struct DFA_table *table, size_t offset);
+
+/* Feed the next chunk of the input. It returns 0 once the DFA is dead, and
+ * then nothing fed afterwards would ever change the result. */
+int DFA_stream_feed(struct DFA_stream *stream, const char *buf, size_t len);
+
+/* Finish the input, it returns 1 if the whole input fed matches the DFA */
+int DFA_stream_finish(const struct DFA_stream *stream);
+
+
+
+#endif /* __DFA_STREAM_HEADER__ */
@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "dfa.h"
+#include "dfa_table.h"
+
+
+/* Compile the DFA to a dense transition table, the DFA itself is not touched
+ * and can be disposed afterwards */
+void DFA_compile(const struct DFA *dfa, struct DFA_table *table)
+{
+    struct byte_classes bc;
+    const struct DFA_state *state;
+    const struct DFA_transition *trans;
+    int i_state, i_trans, row, k, *next;
+
+    /* row 0 is reserved for the dead state, so the state numbered i goes to
+     * row i+1 */
+    DFA_byte_classes(dfa, &bc);
+
+    table->n_states  = dfa->n_states + 1;
+    table->start     = dfa->start + 1;
+    table->n_classes = bc.n_classes;
+    memcpy(table->classmap, bc.map, sizeof(table->classmap));
+    table->next = (int*)
+        mem_calloc((size_t)table->n_states * bc.n_classes, sizeof(int));
+    table->accept   = (unsigned char*)mem_calloc((table->n_states + 7) / 8, 1);
+
+    table->accept_begin = (int*)mem_alloc(
+        (table->n_states + 1) * sizeof(int));
+    table->accept_ids   = (int*)mem_alloc((dfa->n_accepts + 1) * sizeof(int));
+    table->accept_begin[0] = table->accept_begin[1] = 0;
+
+    /* missing transitions are left to be zero, which is the dead state */
+    for (i_state = 0; i_state < dfa->n_states; i_state++)
+    {
+        state = DFA_STATE(dfa, i_state);
+        trans = DFA_TRANSITIONS(dfa, state);
+        row   = i_state + 1;
+        next  = table->next + row * bc.n_classes;
+
+        for (i_trans = 0; i_trans < state->n_transitions; i_trans++)
+        {
+            for (k = bc.map[trans[i_trans].lo];
+                 k <= bc.map[trans[i_trans].hi]; k++)
+                next[k] = trans[i_trans].to + 1;
+        }
+
+        if (state->is_acceptable)
+            table->accept[row >> 3] |= (unsigned char)(1 << (row & 7));
+
+        if (state->n_accepts != 0)
+            memcpy(table->accept_ids + table->accept_begin[row],
+                DFA_ACCEPTS(dfa, state), state->n_accepts * sizeof(int));
+        table->accept_begin[row + 1] =
+            table->accept_begin[row] + state->n_accepts;
+    }
+}
+
+/* Free the memory allocated for the compiled DFA */
+void DFA_table_dispose(struct DFA_table *table)
+{
+    mem_free(table->next);
+    mem_free(table->accept);
+    mem_free(table->accept_begin);
+    mem_free(table->accept_ids);
+}
+
+
+/* Check if the whole buffer matches the compiled DFA */
+int DFA_match(const struct DFA_table *table, const char *buf, size_t len)
+{
+    const unsigned char *p = (const unsigned char*) buf, *end = p + len;
+    const unsigned char *classmap = table->classmap;
+    const int *next = table->next;
+    int s = table->start, n_classes = table->n_classes;
+
+    for ( ; p != end; p++)
+    {
+        s = next[s * n_classes + classmap[*p]];
+        if (s == DFA_DEAD_STATE) return 0;
+    }
+
+    return DFA_table_is_acceptable(table, s);
+}
+
+/* Find all patterns matching the whole buffer in one pass, it returns the
+ * number of them and stores their ids, in ascending order, to *ids. The ids
+ * belong to the table and must not be freed. */
+int DFA_match_patterns(const struct DFA_table *table,
+    const char *buf, size_t len, const int **ids)
+{
+    const unsigned char *p = (const unsigned char*) buf, *end = p + len;
+    const unsigned char *classmap = table->classmap;
+    const int *next = table->next;
+    int s = table->start, n_classes = table->n_classes;
+
+    for ( ; p != end && s != DFA_DEAD_STATE; p++)
+        s = next[s * n_classes + classmap[*p]];
+
+    *ids = table->accept_ids + table->accept_begin[s];
+    return table->accept_begin[s + 1] - table->accept_begin[s];
+}
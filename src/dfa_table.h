@@ -0,0 +1,61 @@
+#ifndef __DFA_TABLE_HEADER__
+#define __DFA_TABLE_HEADER__
+
+
+#include <stddef.h>
+
+#include "dfa.h"
+
+
+/* The dead state of every compiled DFA, it has no way out and is never
+ * acceptable, so matching can be stopped as soon as we get there */
+#define DFA_DEAD_STATE  0
+
+/* A DFA compiled to a dense transition table. States are numbered from 0 to
+ * n_states-1 where state 0 is the dead state. Columns of the table are byte
+ * classes of the DFA rather than raw bytes, the target of state s under byte
+ * c is next[s * n_classes + classmap[c]], so each input byte costs two table
+ * loads while rows get a lot narrower than 256 entries. The table matches
+ * the whole input only, a DFA_searcher (see src/dfa_search.h) finds a match
+ * anywhere in the input in one pass. */
+struct DFA_table
+{
+    int n_states;           /* num of states, including the dead state */
+    int start;              /* start state */
+
+    int n_classes;          /* num of byte classes */
+    unsigned char classmap[256];   /* byte class of each byte */
+    int *next;              /* transition table, n_states rows of n_classes */
+    unsigned char *accept;  /* bitmap of acceptable states */
+
+    /* patterns accepted by state s are accept_ids[accept_begin[s] ..
+     * accept_begin[s+1]-1], in ascending order */
+    int *accept_begin;
+    int *accept_ids;
+};
+
+/* Check if state s of the compiled DFA is an acceptable state */
+#define DFA_table_is_acceptable(table, s)                       \
+    (((table)->accept[(s) >> 3] >> ((s) & 7)) & 1)
+
+
+/* Compile the DFA to a dense transition table, the DFA itself is not touched
+ * and can be disposed afterwards */
+void DFA_compile(const struct DFA *dfa, struct DFA_table *table);
+
+/* Free the memory allocated for the compiled DFA */
+void DFA_table_dispose(struct DFA_table *table);
+
+
+/* Check if the whole buffer matches the compiled DFA */
+int DFA_match(const struct DFA_table *table, const char *buf, size_t len);
+
+/* Find all patterns matching the whole buffer in one pass, it returns the
+ * number of them and stores their ids, in ascending order, to *ids. The ids
+ * belong to the table and must not be freed. */
+int DFA_match_patterns(const struct DFA_table *table,
+    const char *buf, size_t len, const int **ids);
+
+
+
+#endif /* __DFA_TABLE_HEADER__ */
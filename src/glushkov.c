@@ -0,0 +1,316 @@
+#include <string.h>
+
+#include "mem.h"
+#include "sset.h"
+#include "glushkov.h"
+
+
+#define __SET(set, i)       ((set)[(i) >> 6] |= (uint64_t) 1 << ((i) & 63))
+#define __CONTAINS(set, i)  (((set)[(i) >> 6] >> ((i) & 63)) & 1)
+
+
+/* Add the positions entered from the epsilon closure of NFA state "from" to
+ * set, and tell if the closure reaches the terminate state */
+static int __positions_after(const struct NFA *nfa, const int *position_of,
+    struct sparse_set *closure, int from, uint64_t *set)
+{
+    const struct NFA_state *state;
+    int i, i_trans;
+
+    sparse_set_clear(closure);
+    sparse_set_add(closure, from);
+    NFA_epsilon_closure(nfa, closure);
+
+    for (i = 0; i < closure->length; i++)
+    {
+        state = NFA_STATE(nfa, closure->dense[i]);
+        for (i_trans = 0; i_trans < 2; i_trans++)
+        {
+            if (state->transition[i_trans].trans_type == NFATT_CHARACTER)
+                __SET(set, position_of[state->to[i_trans]]);
+        }
+    }
+
+    return sparse_set_contains(closure, nfa->terminate);
+}
+
+/* Check if position i is followed by position i+1 only and the first
+ * position is the only one a match starts with */
+static int __is_linear(const struct glushkov_NFA *g)
+{
+    int i, k, n_words = g->n_words;
+    uint64_t expected;
+
+    for (k = 0; k < n_words; k++)
+    {
+        if (g->first[k] != (k == 0 ? 1 : 0))  return 0;
+    }
+
+    for (i = 0; i < g->n_positions; i++)
+    {
+        for (k = 0; k < n_words; k++)
+        {
+            expected = (i + 1 < g->n_positions && (i + 1) >> 6 == k) ?
+                (uint64_t) 1 << ((i + 1) & 63) : 0;
+            if (g->follow[i * n_words + k] != expected)  return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Build the union tables of follow sets for single word automatons */
+static void __build_follow8(struct glushkov_NFA *g)
+{
+    int j, v, i, n_chunks = (g->n_positions + 7) / 8;
+    uint64_t u;
+
+    g->follow8 = (uint64_t*)mem_alloc(n_chunks * 256 * sizeof(uint64_t));
+    for (j = 0; j < n_chunks; j++)
+    {
+        for (v = 0; v < 256; v++)
+        {
+            u = 0;
+            for (i = 0; i < 8 && 8 * j + i < g->n_positions; i++)
+                if (v >> i & 1)  u |= g->follow[8 * j + i];
+            g->follow8[j * 256 + v] = u;
+        }
+    }
+}
+
+
+/* Build the position automaton of the regexp the NFA is compiled from */
+void create_glushkov_NFA(const struct NFA *nfa, struct glushkov_NFA *g)
+{
+    const struct NFA_state *state;
+    const struct NFA_transition *trans;
+    struct sparse_set closure;
+    int n_states = nfa->arena->n_states, *position_of, *state_of;
+    int id, i, i_trans, c, n_words;
+    size_t set_size;
+
+    /* number the positions in the order of NFA states, which is the order
+     * they appear in the regexp */
+    position_of = (int*)mem_alloc(n_states * sizeof(int));
+    state_of    = (int*)mem_alloc(n_states * sizeof(int));
+    for (id = 0; id < n_states; id++)  position_of[id] = -1;
+
+    for (id = 0; id < n_states; id++)
+    {
+        state = NFA_STATE(nfa, id);
+        for (i_trans = 0; i_trans < 2; i_trans++)
+        {
+            if (state->transition[i_trans].trans_type != NFATT_CHARACTER)
+                continue;
+            position_of[state->to[i_trans]] = 0;
+        }
+    }
+    g->n_positions = 0;
+    for (id = 0; id < n_states; id++)
+    {
+        if (position_of[id] == -1)  continue;
+        state_of[g->n_positions] = id;
+        position_of[id] = g->n_positions++;
+    }
+
+    g->n_words = n_words = g->n_positions > 64 ?
+        (g->n_positions + 63) / 64 : 1;
+    set_size = n_words * sizeof(uint64_t);
+    g->first  = (uint64_t*)mem_calloc(n_words, sizeof(uint64_t));
+    g->last   = (uint64_t*)mem_calloc(n_words, sizeof(uint64_t));
+    g->reach  = (uint64_t*)mem_calloc(256 * n_words, sizeof(uint64_t));
+    g->follow = (uint64_t*)mem_calloc(
+        (size_t)(g->n_positions + 1) * n_words, sizeof(uint64_t));
+    g->cur    = (uint64_t*)mem_alloc(set_size);
+    g->next   = (uint64_t*)mem_alloc(set_size);
+
+    /* bytes entering each position */
+    for (id = 0; id < n_states; id++)
+    {
+        state = NFA_STATE(nfa, id);
+        for (i_trans = 0; i_trans < 2; i_trans++)
+        {
+            trans = state->transition + i_trans;
+            if (trans->trans_type != NFATT_CHARACTER)  continue;
+
+            for (c = trans->lo; c <= trans->hi; c++)
+                __SET(g->reach + c * n_words, position_of[state->to[i_trans]]);
+        }
+    }
+
+    /* first, last and follow sets are read off epsilon closures */
+    create_sparse_set(n_states, &closure);
+    g->is_nullable = __positions_after(nfa, position_of, &closure,
+        nfa->start, g->first);
+    for (i = 0; i < g->n_positions; i++)
+    {
+        if (__positions_after(nfa, position_of, &closure, state_of[i],
+                g->follow + i * n_words))
+            __SET(g->last, i);
+    }
+    destroy_sparse_set(&closure);
+
+    g->is_linear = __is_linear(g);
+    g->follow8 = NULL;
+    if (n_words == 1 && !g->is_linear)  __build_follow8(g);
+
+    mem_free(position_of);
+    mem_free(state_of);
+}
+
+/* Free the memory allocated for the position automaton */
+void destroy_glushkov_NFA(struct glushkov_NFA *g)
+{
+    mem_free(g->first);
+    mem_free(g->last);
+    mem_free(g->reach);
+    mem_free(g->follow);
+    mem_free(g->follow8);
+    mem_free(g->cur);
+    mem_free(g->next);
+}
+
+
+/* next = Follow(cur), for automatons of more than one word */
+static void __follow(const struct glushkov_NFA *g, const uint64_t *cur,
+    uint64_t *next)
+{
+    int n_words = g->n_words, k, i, w;
+    uint64_t bits, carry = 0;
+    const uint64_t *f;
+
+    if (g->is_linear)
+    {
+        for (k = 0; k < n_words; k++)
+        {
+            next[k] = cur[k] << 1 | carry;
+            carry = cur[k] >> 63;
+        }
+        return;
+    }
+
+    memset(next, 0, n_words * sizeof(uint64_t));
+    for (k = 0; k < n_words; k++)
+    {
+        for (bits = cur[k]; bits != 0; bits &= bits - 1)
+        {
+            i = k * 64 + __builtin_ctzll(bits);
+            f = g->follow + i * n_words;
+            for (w = 0; w < n_words; w++)  next[w] |= f[w];
+        }
+    }
+}
+
+/* Follow(d) for a single word automaton */
+static inline uint64_t __follow1(const struct glushkov_NFA *g, uint64_t d)
+{
+    const uint64_t *t = g->follow8;
+    uint64_t f = 0;
+
+    if (g->is_linear)  return d << 1;
+
+    for ( ; d != 0; d >>= 8, t += 256)  f |= t[d & 0xff];
+    return f;
+}
+
+/* Run the single word automaton. If is_searching is zero, it returns 1 if
+ * the whole buffer matches; otherwise it returns 1 as soon as a match ends
+ * and stores where it ends to *match_end. */
+static int __run1(const struct glushkov_NFA *g, const unsigned char *p,
+    size_t len, int is_searching, size_t *match_end)
+{
+    const unsigned char *begin = p, *end = p + len;
+    uint64_t d = 0, first = g->first[0], last = g->last[0];
+    const uint64_t *reach = g->reach;
+
+    if (g->is_nullable && is_searching) {
+        *match_end = 0; return 1;
+    }
+
+    /* the first step is the only one starting from the initial state when
+     * matching the whole buffer */
+    if (p != end)  d = first & reach[*p++];
+    for ( ; p != end; p++)
+    {
+        if (is_searching)
+        {
+            if (d & last) {
+                *match_end = p - begin; return 1;
+            }
+            d = (__follow1(g, d) | first) & reach[*p];
+        }
+        else
+        {
+            if (d == 0)  return 0;
+            d = __follow1(g, d) & reach[*p];
+        }
+    }
+
+    if (is_searching && (d & last))  *match_end = len;
+    if (len == 0)  return g->is_nullable;
+    return (d & last) != 0;
+}
+
+/* Run the multi word automaton, the same as __run1 */
+static int __run(struct glushkov_NFA *g, const unsigned char *p, size_t len,
+    int is_searching, size_t *match_end)
+{
+    const unsigned char *begin = p, *end = p + len;
+    int n_words = g->n_words, k, is_alive, is_accepted = 0;
+    uint64_t *cur = g->cur, *next = g->next, *tmp;
+    const uint64_t *reach;
+
+    if (len == 0 || (g->is_nullable && is_searching))
+    {
+        *match_end = 0;
+        return g->is_nullable;
+    }
+
+    reach = g->reach + *p++ * n_words;
+    for (k = 0; k < n_words; k++)  cur[k] = g->first[k] & reach[k];
+
+    for ( ; ; p++)
+    {
+        is_alive = is_accepted = 0;
+        for (k = 0; k < n_words; k++)
+        {
+            is_alive    |= cur[k] != 0;
+            is_accepted |= (cur[k] & g->last[k]) != 0;
+        }
+
+        if (is_searching && is_accepted) {
+            *match_end = p - begin; return 1;
+        }
+        if (p == end || (!is_searching && !is_alive))  break;
+
+        __follow(g, cur, next);
+        reach = g->reach + *p * n_words;
+        for (k = 0; k < n_words; k++)
+        {
+            if (is_searching)  next[k] |= g->first[k];
+            next[k] &= reach[k];
+        }
+        tmp = cur; cur = next; next = tmp;
+    }
+
+    return p == end && is_accepted;
+}
+
+/* Check if the whole buffer matches the regexp */
+int glushkov_NFA_match(struct glushkov_NFA *g, const char *buf, size_t len)
+{
+    size_t match_end;
+
+    if (g->n_words == 1)
+        return __run1(g, (const unsigned char*) buf, len, 0, &match_end);
+    return __run(g, (const unsigned char*) buf, len, 0, &match_end);
+}
+
+/* Find the earliest end of a match anywhere in buf */
+int glushkov_NFA_search(struct glushkov_NFA *g, const char *buf, size_t len,
+    size_t *match_end)
+{
+    if (g->n_words == 1)
+        return __run1(g, (const unsigned char*) buf, len, 1, match_end);
+    return __run(g, (const unsigned char*) buf, len, 1, match_end);
+}
@@ -0,0 +1,66 @@
+#ifndef __GLUSHKOV_HEADER__
+#define __GLUSHKOV_HEADER__
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nfa.h"
+
+
+/* Glushkov (position) automaton of a regexp simulated bit-parallel. Every
+ * primary of the regexp (a byte, a class or '.') is a position, and the
+ * automaton has one state per position plus the initial state. There's no
+ * epsilon transition in it, and all transitions into a position are taken on
+ * the bytes of that position, so a set of active positions D steps over byte
+ * c as
+ *
+ *     D' = (Follow(D) | First) & Reach[c]
+ *
+ * where First is only added at the beginning of an anchored match. Sets of
+ * positions are bitsets of n_words 64-bit words, so a regexp of up to 64
+ * positions runs on a single word without any determinization. If position
+ * i is followed by position i+1 only, as in a plain concatenation, Follow(D)
+ * is D << 1 and this is the classical Shift-And. */
+struct glushkov_NFA
+{
+    int n_positions;        /* num of positions */
+    int n_words;            /* num of words in each set of positions */
+
+    int is_nullable;        /* if the regexp matches the empty string */
+    int is_linear;          /* if Follow(D) is simply D << 1 */
+
+    uint64_t *first;        /* positions a match may start with */
+    uint64_t *last;         /* positions a match may end with */
+    uint64_t *reach;        /* positions entered on byte c, 256 sets */
+    uint64_t *follow;       /* positions following position i, one set for
+                             * each position */
+    uint64_t *follow8;      /* if n_words == 1, the union of the follow sets
+                             * of positions 8j..8j+7 chosen by byte v is
+                             * follow8[j * 256 + v], or NULL otherwise */
+
+    uint64_t *cur, *next;   /* scratch sets for matching */
+};
+
+
+/* Build the position automaton of the regexp the NFA is compiled from. A
+ * Thompson fragment of a primary has its character transitions all going to
+ * the terminate state of the fragment, so the targets of character
+ * transitions are exactly the positions, which no longer holds once the NFA
+ * is reduced by NFA_reduce. The NFA is not needed afterwards. */
+void create_glushkov_NFA(const struct NFA *nfa, struct glushkov_NFA *g);
+
+/* Free the memory allocated for the position automaton */
+void destroy_glushkov_NFA(struct glushkov_NFA *g);
+
+/* Check if the whole buffer matches the regexp */
+int glushkov_NFA_match(struct glushkov_NFA *g, const char *buf, size_t len);
+
+/* Find the earliest end of a match anywhere in buf, it returns 1 and stores
+ * the end offset to *match_end if there's a match, or 0 if there's none */
+int glushkov_NFA_search(struct glushkov_NFA *g, const char *buf, size_t len,
+    size_t *match_end);
+
+
+
+#endif /* __GLUSHKOV_HEADER__ */
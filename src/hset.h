@@ -0,0 +1,193 @@
+#ifndef __HASH_SET_HEADER__
+#define __HASH_SET_HEADER__
+
+
+#include <stdint.h>
+
+#include "mem.h"
+#include "stats.h"
+
+
+#define INITIAL_HASH_SLOTS  16   /* default num of slots of new hash tables */
+
+/* Hash functions for pointers, non-negative integers and 64-bit keys */
+static inline uint32_t hash_pointer(const void *p)
+{
+    uint32_t h = (uint32_t)((uintptr_t)p >> 4) * 0x9e3779b1u;
+    return h ^ (h >> 16);
+}
+
+static inline uint32_t hash_int(int i)
+{
+    uint32_t h = (uint32_t)i * 0x9e3779b1u;
+    return h ^ (h >> 16);
+}
+
+static inline uint32_t hash_uint64(uint64_t k)
+{
+    k *= 0x9e3779b97f4a7c15ull;
+    return (uint32_t)(k >> 32) ^ (uint32_t) k;
+}
+
+
+/* Open addressing hash tables with linear probing. The load factor is kept
+ * below 1/2 so that a probe sequence is short, and empty slots are marked by
+ * a key which is never stored in the table (NULL for pointers, -1 for
+ * integers). Keys are compared by ==, so they must be scalars. */
+
+/* Get the slot holding key, or the empty slot where key would be stored */
+#define __HASH_TABLE_SLOT(table, key, empty_key, hash)                      \
+    int mask = (table)->n_slots - 1, i_slot = (int)(hash(key) & mask);      \
+    int n_probes = 1;                                                       \
+    while ((table)->keys[i_slot] != (empty_key) &&                          \
+           (table)->keys[i_slot] != (key))                                  \
+    {                                                                       \
+        i_slot = (i_slot + 1) & mask;                                       \
+        n_probes++;                                                         \
+    }                                                                       \
+    STATS_ADD(n_hash_probes, n_probes);
+
+/* Define a set of keys named struct name:
+
+       name_init(s)           create an empty set
+       name_destroy(s)        free the memory allocated for the set
+       name_contains(s, key)  check if key is in the set
+       name_add(s, key)       add key to the set, it returns 1 if key is
+                              actually added, or 0 if key is already there */
+#define DEFINE_HASH_SET(name, key_type, empty_key, hash)                    \
+    struct name                                                             \
+    {                                                                       \
+        key_type *keys;  /* slots */                                        \
+        int n_slots;     /* size of the table, a power of 2 */              \
+        int length;      /* num of keys in the set */                       \
+    };                                                                      \
+                                                                            \
+    static inline void name##__alloc(struct name *s, int n_slots)           \
+    {                                                                       \
+        int i_slot = 0;                                                     \
+        s->n_slots = n_slots;                                               \
+        s->keys = (key_type*)mem_alloc(n_slots * sizeof(key_type));         \
+        for ( ; i_slot < n_slots; i_slot++)  s->keys[i_slot] = (empty_key); \
+    }                                                                       \
+                                                                            \
+    static inline void name##_init(struct name *s)                          \
+    {                                                                       \
+        s->length = 0;                                                      \
+        name##__alloc(s, INITIAL_HASH_SLOTS);                               \
+    }                                                                       \
+                                                                            \
+    static inline void name##_destroy(struct name *s) {                     \
+        mem_free(s->keys);                                                  \
+    }                                                                       \
+                                                                            \
+    static inline int name##__slot(const struct name *s, key_type key)      \
+    {                                                                       \
+        __HASH_TABLE_SLOT(s, key, empty_key, hash)                          \
+        return i_slot;                                                      \
+    }                                                                       \
+                                                                            \
+    static inline int name##_contains(const struct name *s, key_type key) { \
+        return s->keys[name##__slot(s, key)] != (empty_key);                \
+    }                                                                       \
+                                                                            \
+    static inline int name##_add(struct name *s, key_type key)              \
+    {                                                                       \
+        key_type *old_keys = s->keys;                                       \
+        int i_slot = name##__slot(s, key), old_n_slots = s->n_slots;        \
+                                                                            \
+        if (s->keys[i_slot] != (empty_key))  return 0;                      \
+        s->keys[i_slot] = key;                                              \
+                                                                            \
+        if (++s->length * 2 > s->n_slots)   /* rehash */                    \
+        {                                                                   \
+            name##__alloc(s, old_n_slots * 2);                              \
+            for (i_slot = 0; i_slot < old_n_slots; i_slot++)                \
+            {                                                               \
+                if (old_keys[i_slot] != (empty_key))                        \
+                    s->keys[name##__slot(s, old_keys[i_slot])] =            \
+                        old_keys[i_slot];                                   \
+            }                                                               \
+            mem_free(old_keys);                                             \
+        }                                                                   \
+        return 1;                                                           \
+    }
+
+/* Define a map from keys to non-negative integers named struct name:
+
+       name_init(m)              create an empty map
+       name_destroy(m)           free the memory allocated for the map
+       name_get(m, key)          get the value of key, or -1 if key is not
+                                 in the map
+       name_put(m, key, value)   set the value of key */
+#define DEFINE_HASH_MAP(name, key_type, empty_key, hash)                    \
+    struct name                                                             \
+    {                                                                       \
+        key_type *keys;  /* slots */                                        \
+        int *values;     /* values[i] is the value of keys[i] */            \
+        int n_slots;     /* size of the table, a power of 2 */              \
+        int length;      /* num of keys in the map */                       \
+    };                                                                      \
+                                                                            \
+    static inline void name##__alloc(struct name *m, int n_slots)           \
+    {                                                                       \
+        int i_slot = 0;                                                     \
+        m->n_slots = n_slots;                                               \
+        m->keys   = (key_type*)mem_alloc(n_slots * sizeof(key_type));       \
+        m->values = (int*)mem_alloc(n_slots * sizeof(int));                 \
+        for ( ; i_slot < n_slots; i_slot++)  m->keys[i_slot] = (empty_key); \
+    }                                                                       \
+                                                                            \
+    static inline void name##_init(struct name *m)                          \
+    {                                                                       \
+        m->length = 0;                                                      \
+        name##__alloc(m, INITIAL_HASH_SLOTS);                               \
+    }                                                                       \
+                                                                            \
+    static inline void name##_destroy(struct name *m)                       \
+    {                                                                       \
+        mem_free(m->keys);                                                  \
+        mem_free(m->values);                                                \
+    }                                                                       \
+                                                                            \
+    static inline int name##__slot(const struct name *m, key_type key)      \
+    {                                                                       \
+        __HASH_TABLE_SLOT(m, key, empty_key, hash)                          \
+        return i_slot;                                                      \
+    }                                                                       \
+                                                                            \
+    static inline int name##_get(const struct name *m, key_type key)        \
+    {                                                                       \
+        int i_slot = name##__slot(m, key);                                  \
+        return m->keys[i_slot] != (empty_key) ? m->values[i_slot] : -1;     \
+    }                                                                       \
+                                                                            \
+    static inline void name##_put(struct name *m, key_type key, int value)  \
+    {                                                                       \
+        key_type *old_keys = m->keys;                                       \
+        int *old_values = m->values, old_n_slots = m->n_slots;              \
+        int i_slot = name##__slot(m, key);                                  \
+                                                                            \
+        m->values[i_slot] = value;                                          \
+        if (m->keys[i_slot] != (empty_key))  return;                        \
+        m->keys[i_slot] = key;                                              \
+                                                                            \
+        if (++m->length * 2 > m->n_slots)   /* rehash */                    \
+        {                                                                   \
+            name##__alloc(m, old_n_slots * 2);                              \
+            for (i_slot = 0; i_slot < old_n_slots; i_slot++)                \
+            {                                                               \
+                if (old_keys[i_slot] != (empty_key))                        \
+                {                                                           \
+                    int i_new = name##__slot(m, old_keys[i_slot]);          \
+                    m->keys[i_new]   = old_keys[i_slot];                    \
+                    m->values[i_new] = old_values[i_slot];                  \
+                }                                                           \
+            }                                                               \
+            mem_free(old_keys);                                             \
+            mem_free(old_values);                                           \
+        }                                                                   \
+    }
+
+
+
+#endif /* __HASH_SET_HEADER__ */
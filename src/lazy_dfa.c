@@ -0,0 +1,387 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "sset.h"
+#include "nfa.h"
+#include "stats.h"
+#include "dfa_table.h"
+#include "lazy_dfa.h"
+#include "__nfa_state_set.h"
+
+
+#define INITIAL_CACHE_CAPACITY  16  /* num of states a new cache can hold */
+
+/* The cache has to hold the dead state, the start state and the target state
+ * of a transition at least, even if the memory budget is smaller than that */
+#define MIN_CACHE_STATES  3
+
+/* If the cache gets full before the scan advances this many bytes for each
+ * cached state since the last flush, the cache is thrashing and we'd better
+ * simulate the NFA directly */
+#define MIN_BYTES_PER_STATE  10
+
+/* The transition is not cached because the cache is full */
+#define CACHE_FULL  (-2)
+
+
+/* Memory taken by each cached state: its bitset, hash value, row in the
+ * transition table, accept flag and 2 slots in the hash table */
+static size_t __state_cost(int n_words, int n_classes)
+{
+    return n_words * sizeof(uint32_t) + sizeof(uint64_t) +
+        n_classes * sizeof(int) + 1 + 2 * sizeof(int);
+}
+
+/* Allocate the hash table with n_slots empty slots, it returns 0, or -1 if
+ * it fails to allocate memory and then the old table is kept */
+static int __alloc_slots(struct lazy_DFA *dfa, int n_slots)
+{
+    int *slots = (int*)mem_alloc(n_slots * sizeof(int));
+
+    if (slots == NULL)  return -1;
+    memset(slots, -1, n_slots * sizeof(int));
+
+    mem_free(dfa->slots);
+    dfa->n_slots = n_slots;
+    dfa->slots   = slots;
+    return 0;
+}
+
+/* Get the bitset of the s-th cached state */
+static uint32_t *__state_key(const struct lazy_DFA *dfa, int s)
+{
+    return dfa->keys + (size_t)s * dfa->n_words;
+}
+
+/* Get the first slot probed by linear probing which either holds a state with
+ * the same bitset as key or is empty */
+static int *__find_slot(
+    const struct lazy_DFA *dfa, const uint32_t *key, uint64_t hash)
+{
+    int mask = dfa->n_slots - 1, i_slot = (int)(hash & mask), s;
+    int n_probes = 1;
+
+    for ( ; (s = dfa->slots[i_slot]) != -1;
+          i_slot = (i_slot + 1) & mask, n_probes++)
+    {
+        if (dfa->hashes[s] == hash &&
+            memcmp(__state_key(dfa, s), key,
+                dfa->n_words * sizeof(uint32_t)) == 0)
+        {
+            break;
+        }
+    }
+
+    STATS_ADD(n_hash_probes, n_probes);
+    return dfa->slots + i_slot;
+}
+
+/* Make room for twice as many states in the cache, the hash table is rebuilt
+ * to keep its load factor below 1/2. It returns 0, or -1 if it fails to
+ * allocate memory, and then the capacity is left as it is. */
+static int __grow_cache(struct lazy_DFA *dfa)
+{
+    int capacity = dfa->capacity * 2, s = 0, mask, i_slot;
+    uint32_t *keys;
+    uint64_t *hashes;
+    int *next;
+    unsigned char *accept;
+
+    if (capacity > dfa->max_states)  capacity = dfa->max_states;
+
+    /* each array which is grown is kept, the cache is consistent as long as
+     * the capacity is no more than the size of every array */
+    keys = (uint32_t*)mem_realloc(dfa->keys,
+        (size_t)capacity * dfa->n_words * sizeof(uint32_t));
+    if (keys == NULL)  return -1;
+    dfa->keys = keys;
+
+    hashes = (uint64_t*)mem_realloc(dfa->hashes,
+        capacity * sizeof(uint64_t));
+    if (hashes == NULL)  return -1;
+    dfa->hashes = hashes;
+
+    next = (int*)mem_realloc(dfa->next,
+        (size_t)capacity * dfa->classes.n_classes * sizeof(int));
+    if (next == NULL)  return -1;
+    dfa->next = next;
+
+    accept = (unsigned char*)mem_realloc(dfa->accept, capacity);
+    if (accept == NULL)  return -1;
+    dfa->accept = accept;
+
+    if (capacity * 2 > dfa->n_slots)
+    {
+        if (__alloc_slots(dfa, dfa->n_slots * 2) == -1)  return -1;
+
+        mask = dfa->n_slots - 1;
+        for ( ; s < dfa->n_states; s++)
+        {
+            /* cached states are all distinct, so just look for an empty
+             * slot */
+            i_slot = (int)(dfa->hashes[s] & mask);
+            while (dfa->slots[i_slot] != -1)  i_slot = (i_slot + 1) & mask;
+            dfa->slots[i_slot] = s;
+        }
+    }
+
+    dfa->capacity = capacity;
+    return 0;
+}
+
+/* Add the set of NFA states to the cache as a new DFA state, slot is where
+ * __find_slot stopped for this set. It returns the id of the new state, or
+ * CACHE_FULL if the cache is out of budget. */
+static int __add_state(struct lazy_DFA *dfa,
+    const uint32_t *key, uint64_t hash, int *slot)
+{
+    int s = dfa->n_states, n_classes = dfa->classes.n_classes;
+
+    if (s == dfa->max_states)  return CACHE_FULL;
+    if (s == dfa->capacity)
+    {
+        /* out of memory, the cache is as large as it can get, and it's
+         * flushed like a full one from now on */
+        if (__grow_cache(dfa) == -1)
+        {
+            dfa->max_states = dfa->capacity;
+            return CACHE_FULL;
+        }
+        slot = __find_slot(dfa, key, hash);   /* slots might be rebuilt */
+    }
+
+    memcpy(__state_key(dfa, s), key, dfa->n_words * sizeof(uint32_t));
+    dfa->hashes[s] = hash;
+    dfa->accept[s] = BITSET_CONTAINS(key, dfa->nfa->terminate);
+
+    /* nothing goes out of the dead state, other transitions are computed
+     * when they are taken for the first time */
+    if (s == DFA_DEAD_STATE)
+        memset(dfa->next, 0, n_classes * sizeof(int));
+    else
+        memset(dfa->next + (size_t)s * n_classes, -1, n_classes * sizeof(int));
+
+    *slot = s;
+    return dfa->n_states++;
+}
+
+/* Get the cached state of the set of NFA states in key, a new state is added
+ * if it is not in the cache yet */
+static int __get_state(struct lazy_DFA *dfa, const uint32_t *key)
+{
+    uint64_t hash = __hash_bitset(key, dfa->n_words);
+    int *slot = __find_slot(dfa, key, hash);
+
+    STATS_INC(n_set_lookups);
+    return *slot != -1 ? *slot : __add_state(dfa, key, hash, slot);
+}
+
+/* Drop all cached states except for the dead state and the start state */
+static void __flush_cache(struct lazy_DFA *dfa)
+{
+    dfa->n_states = 0;
+    memset(dfa->slots, -1, dfa->n_slots * sizeof(int));
+
+    memset(dfa->key, 0, dfa->n_words * sizeof(uint32_t));
+    __get_state(dfa, dfa->key);                  /* dead state */
+    dfa->start = __get_state(dfa, dfa->start_key);
+}
+
+
+/* Compute the set of NFA states reached from states in "from" by consuming
+ * byte c, the result is stored to "to" */
+static void __NFA_step(const struct NFA *nfa,
+    const struct sparse_set *from, unsigned char c, struct sparse_set *to)
+{
+    const struct NFA_state *state;
+    int i_state = 0, i_trans, n_trans;
+
+    sparse_set_clear(to);
+    for ( ; i_state < from->length; i_state++)
+    {
+        state = nfa->arena->states + from->dense[i_state];
+        n_trans = NFA_state_transition_num(state);
+
+        for (i_trans = 0; i_trans < n_trans; i_trans++)
+        {
+            if (NFA_transition_accepts(state->transition + i_trans, c))
+            {
+                sparse_set_add(to, state->to[i_trans]);
+            }
+        }
+    }
+
+    NFA_epsilon_closure(nfa, to);
+}
+
+/* Load the set of NFA states in cached state s to dfa->clist */
+static void __load_state(struct lazy_DFA *dfa, int s)
+{
+    const uint32_t *bits = __state_key(dfa, s);
+    uint32_t word;
+    int i_word = 0;
+
+    sparse_set_clear(&dfa->clist);
+    for ( ; i_word < dfa->n_words; i_word++)
+    {
+        for (word = bits[i_word]; word != 0; word &= word - 1)
+            sparse_set_add(&dfa->clist, i_word * 32 + __builtin_ctz(word));
+    }
+}
+
+/* Determinize the transition of cached state s under byte c, which stands for
+ * all bytes in its byte class. The target set of NFA states is left in
+ * dfa->nlist and dfa->key, and its state id is returned, or CACHE_FULL if
+ * there's no room for it. */
+static int __compute_transition(struct lazy_DFA *dfa, int s, unsigned char c)
+{
+    int t;
+
+    __load_state(dfa, s);
+    __NFA_step(dfa->nfa, &dfa->clist, c, &dfa->nlist);
+    __sparse_set_to_bitset(&dfa->nlist, dfa->key, dfa->n_words);
+
+    if ((t = __get_state(dfa, dfa->key)) != CACHE_FULL)
+    {
+        dfa->next[(size_t)s * dfa->classes.n_classes +
+            dfa->classes.map[c]] = t;
+    }
+
+    return t;
+}
+
+/* Finish the scan by simulating the NFA from the set of states in dfa->nlist,
+ * p is the next byte to be consumed */
+static int __NFA_simulate(struct lazy_DFA *dfa,
+    const unsigned char *p, const unsigned char *end)
+{
+    struct sparse_set tmp;
+
+    for ( ; p != end && dfa->nlist.length != 0; p++)
+    {
+        tmp = dfa->clist; dfa->clist = dfa->nlist; dfa->nlist = tmp;
+        __NFA_step(dfa->nfa, &dfa->clist, *p, &dfa->nlist);
+    }
+
+    return p == end && sparse_set_contains(&dfa->nlist, dfa->nfa->terminate);
+}
+
+
+/* Create a lazy DFA for the NFA, the state cache would take no more than
+ * max_memory bytes. The NFA must be kept alive until the lazy DFA is
+ * destroyed. It returns 0, or -1 if it fails to allocate memory and then
+ * nothing is left allocated. */
+int create_lazy_DFA(
+    const struct NFA *nfa, size_t max_memory, struct lazy_DFA *dfa)
+{
+    int n_nfa_states = nfa->arena->n_states, n_slots = 1;
+    size_t max_states;
+
+    dfa->nfa     = nfa;
+    dfa->n_words = NFA_STATE_SET_WORDS(n_nfa_states);
+    NFA_byte_classes(nfa, &dfa->classes);
+
+    max_states = max_memory /
+        __state_cost(dfa->n_words, dfa->classes.n_classes);
+    if (max_states < MIN_CACHE_STATES)  max_states = MIN_CACHE_STATES;
+    if (max_states > (1 << 24))         max_states = 1 << 24;
+    dfa->max_states = (int) max_states;
+
+    dfa->n_states = 0;
+    dfa->capacity = INITIAL_CACHE_CAPACITY < dfa->max_states ?
+        INITIAL_CACHE_CAPACITY : dfa->max_states;
+    dfa->keys = (uint32_t*)
+        mem_alloc((size_t)dfa->capacity * dfa->n_words * sizeof(uint32_t));
+    dfa->hashes = (uint64_t*)mem_alloc(dfa->capacity * sizeof(uint64_t));
+    dfa->next   = (int*)mem_alloc(
+        (size_t)dfa->capacity * dfa->classes.n_classes * sizeof(int));
+    dfa->accept = (unsigned char*)mem_alloc(dfa->capacity);
+
+    while (n_slots < dfa->capacity * 2)  n_slots *= 2;
+    dfa->slots = NULL;
+    __alloc_slots(dfa, n_slots);
+
+    dfa->key       = (uint32_t*)mem_alloc(dfa->n_words * sizeof(uint32_t));
+    dfa->start_key = (uint32_t*)mem_alloc(dfa->n_words * sizeof(uint32_t));
+    create_sparse_set(n_nfa_states, &dfa->clist);
+    create_sparse_set(n_nfa_states, &dfa->nlist);
+
+    if (dfa->keys == NULL || dfa->hashes == NULL || dfa->next == NULL ||
+        dfa->accept == NULL || dfa->slots == NULL || dfa->key == NULL ||
+        dfa->start_key == NULL || dfa->clist.dense == NULL ||
+        dfa->clist.sparse == NULL || dfa->nlist.dense == NULL ||
+        dfa->nlist.sparse == NULL)
+    {
+        destroy_lazy_DFA(dfa); return -1;
+    }
+
+    /* the start state is the epsilon closure of the start state of NFA */
+    sparse_set_add(&dfa->clist, nfa->start);
+    NFA_epsilon_closure(nfa, &dfa->clist);
+    __sparse_set_to_bitset(&dfa->clist, dfa->start_key, dfa->n_words);
+
+    dfa->n_flushes = dfa->n_fallbacks = 0;
+    dfa->bytes_since_flush = 0;
+    __flush_cache(dfa);
+    return 0;
+}
+
+/* Free the memory allocated for the lazy DFA */
+void destroy_lazy_DFA(struct lazy_DFA *dfa)
+{
+    mem_free(dfa->keys);
+    mem_free(dfa->hashes);
+    mem_free(dfa->next);
+    mem_free(dfa->accept);
+    mem_free(dfa->slots);
+    mem_free(dfa->key);
+    mem_free(dfa->start_key);
+    destroy_sparse_set(&dfa->clist);
+    destroy_sparse_set(&dfa->nlist);
+}
+
+/* Check if the whole buffer matches the NFA, states of the lazy DFA reached
+ * by the input are determinized and cached on the way */
+int lazy_DFA_match(struct lazy_DFA *dfa, const char *buf, size_t len)
+{
+    const unsigned char *p = (const unsigned char*) buf, *end = p + len;
+    const unsigned char *flushed_at = p;  /* where bytes_since_flush ends */
+    const unsigned char *map = dfa->classes.map;
+    int s = dfa->start, t, n_classes = dfa->classes.n_classes;
+
+    for ( ; p != end; p++)
+    {
+        t = dfa->next[(size_t)s * n_classes + map[*p]];
+
+        if (t == LAZY_DFA_UNKNOWN &&
+            (t = __compute_transition(dfa, s, *p)) == CACHE_FULL)
+        {
+            dfa->bytes_since_flush += p - flushed_at;
+            flushed_at = p;
+
+            /* the cache does not pay off if it fills up too quickly, bail out
+             * to NFA simulation starting from the target set we've got */
+            if (dfa->bytes_since_flush <
+                (size_t) MIN_BYTES_PER_STATE * dfa->n_states)
+            {
+                dfa->n_fallbacks++;
+                return __NFA_simulate(dfa, p + 1, end);
+            }
+
+            /* flushing clobbers dfa->key, the target set is still kept in
+             * dfa->nlist though */
+            __flush_cache(dfa);
+            dfa->n_flushes++;
+            dfa->bytes_since_flush = 0;
+            __sparse_set_to_bitset(&dfa->nlist, dfa->key, dfa->n_words);
+            t = __get_state(dfa, dfa->key);
+        }
+
+        s = t;
+        if (s == DFA_DEAD_STATE)  break;
+    }
+
+    dfa->bytes_since_flush += p - flushed_at;
+    return dfa->accept[s];
+}
@@ -0,0 +1,80 @@
+#ifndef __LAZY_DFA_HEADER__
+#define __LAZY_DFA_HEADER__
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sset.h"
+#include "nfa.h"
+#include "byte_class.h"
+
+
+/* Default memory budget of the state cache of a lazy DFA */
+#define LAZY_DFA_DEFAULT_MEMORY  (1 << 20)
+
+/* A DFA determinized on demand while scanning the input (like the DFA of RE2).
+ * A DFA state is built only when some input actually reaches it, and it is
+ * kept in a cache along with its transitions. Cached states are numbered from
+ * 0 to n_states-1, where state 0 is the dead state (the empty set of NFA
+ * states). Transitions are indexed by byte class, the target of state s under
+ * byte c is next[s * n_classes + classes.map[c]], or LAZY_DFA_UNKNOWN if it
+ * has not been computed yet.
+ *
+ * The cache never grows beyond the memory budget, it is flushed when it gets
+ * full. If it is flushed too often to pay off, the matcher gives up caching
+ * and finishes the scan by simulating the NFA directly. Running out of memory
+ * while growing the cache lowers max_states to the states it can hold, so a
+ * scan never fails once the lazy DFA is created. */
+struct lazy_DFA
+{
+    const struct NFA *nfa;  /* NFA being simulated */
+    int n_words;            /* num of words in each NFA state bitset */
+
+    int n_states;           /* num of cached states, including dead state */
+    int capacity;           /* num of states the cache arrays can hold */
+    int max_states;         /* num of states allowed by the memory budget */
+    int start;              /* start state */
+
+    uint32_t *keys;         /* bitset of NFA states in the i-th DFA state
+                             * begins at keys + i * n_words */
+    uint64_t *hashes;       /* hash value of each bitset */
+    struct byte_classes classes;   /* byte classes of the NFA */
+    int *next;              /* transition table, n_states rows of n_classes */
+    unsigned char *accept;  /* accept[s] is 1 if state s is acceptable */
+
+    /* open addressing hash table mapping bitsets to cached states */
+    int *slots;             /* state id, or -1 if empty */
+    int  n_slots;           /* size of hash table, a power of 2 */
+
+    /* scratch space for computing transitions */
+    uint32_t *key;          /* bitset being looked up */
+    uint32_t *start_key;    /* bitset of start state, kept across flushes */
+    struct sparse_set clist, nlist;
+
+    size_t bytes_since_flush;  /* num of bytes scanned since last flush */
+    int n_flushes;          /* num of times the cache has been flushed */
+    int n_fallbacks;        /* num of scans finished by NFA simulation */
+};
+
+/* Mark of a transition not computed yet */
+#define LAZY_DFA_UNKNOWN  (-1)
+
+
+/* Create a lazy DFA for the NFA, the state cache would take no more than
+ * max_memory bytes. The NFA must be kept alive until the lazy DFA is
+ * destroyed. It returns 0, or -1 if it fails to allocate memory and then
+ * nothing is left allocated. */
+int create_lazy_DFA(
+    const struct NFA *nfa, size_t max_memory, struct lazy_DFA *dfa);
+
+/* Free the memory allocated for the lazy DFA */
+void destroy_lazy_DFA(struct lazy_DFA *dfa);
+
+/* Check if the whole buffer matches the NFA, states of the lazy DFA reached
+ * by the input are determinized and cached on the way */
+int lazy_DFA_match(struct lazy_DFA *dfa, const char *buf, size_t len);
+
+
+
+#endif /* __LAZY_DFA_HEADER__ */
@@ -1,30 +1,252 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <inttypes.h>
+#include <unistd.h>
 
 #include "nfa.h"
 #include "dfa.h"
+#include "stats.h"
+#include "scan.h"
+#include "dfa_image.h"
 
 
-/* Compile basic regular expression to NFA */
-struct NFA reg_to_NFA(const char *regexp);
+/* Output format of the stats, or STATS_OFF if --stats is not given */
+enum { STATS_OFF, STATS_TEXT, STATS_JSON };
 
-/* Convert an NFA to DFA, this function returns the start state of the
- * resulting DFA */
-struct DFA_state *NFA_to_DFA(const struct NFA *nfa);
+/* Parse the --stats[=text|json] option, it returns -1 if arg is not valid */
+static int __parse_stats_option(const char *arg)
+{
+    if (strcmp(arg, "--stats") == 0 || strcmp(arg, "--stats=text") == 0)
+        return STATS_TEXT;
+    if (strcmp(arg, "--stats=json") == 0)
+        return STATS_JSON;
+
+    return -1;
+}
+
+/* Engines converting regexps to DFAs */
+enum { ENGINE_THOMPSON, ENGINE_DERIVATIVE };
+
+/* Parse the --engine=thompson|derivative option, it returns -1 if arg is not
+ * valid */
+static int __parse_engine_option(const char *arg)
+{
+    if (strcmp(arg, "--engine=thompson") == 0)
+        return ENGINE_THOMPSON;
+    if (strcmp(arg, "--engine=derivative") == 0)
+        return ENGINE_DERIVATIVE;
+
+    return -1;
+}
+
+/* Parse the --scan[=lines|offsets] option, it returns -1 if arg is not
+ * valid */
+static int __parse_scan_option(const char *arg)
+{
+    if (strcmp(arg, "--scan") == 0 || strcmp(arg, "--scan=lines") == 0)
+        return SCAN_LINES;
+    if (strcmp(arg, "--scan=offsets") == 0)
+        return SCAN_OFFSETS;
+    if (strcmp(arg, "--scan=quiet") == 0)
+        return SCAN_QUIET;
+
+    return -1;
+}
+
+/* Check if a file has a match of the regexp, all processors online take part
+ * in running the DFA over the file */
+static int __scan_quiet(const char *path, const char *regexp)
+{
+    struct NFA nfa, containing;
+    struct DFA *dfa, *dfa_opt;
+    struct DFA_table table;
+    long n_threads;
+    int is_matched;
+
+    nfa = reg_to_NFA(regexp);
+    containing = NFA_containing(&nfa);
+    dfa = NFA_to_DFA(&containing);
+    dfa_opt = DFA_optimize(dfa);
+    DFA_compile(dfa_opt, &table);
+    DFA_dispose(dfa);
+    DFA_dispose(dfa_opt);
+    NFA_dispose(&nfa);
+
+    if ((n_threads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)  n_threads = 1;
+    if ( (is_matched = scan_file_contains(&table, path, (int) n_threads))
+        == -1) {
+        perror(path); exit(-1);
+    }
+
+    DFA_table_dispose(&table);
+    return is_matched ? 0 : 1;
+}
 
-/* Simplify DFA by merging undistinguishable states */
-struct DFA_state *DFA_optimize(const struct DFA_state *dfa);
+/* Scan a file for the regexp, the exit status is 0 if anything matched, 1
+ * if nothing matched, like grep */
+static int __scan(enum scan_mode mode, const char *path, const char *regexp)
+{
+    struct NFA nfa, reversed;
+    struct DFA_searcher searcher;
+    long n_found;
+
+    if (mode == SCAN_QUIET)  return __scan_quiet(path, regexp);
+
+    nfa = reg_to_NFA(regexp);
+    reversed = reg_to_reversed_NFA(regexp);
+    create_DFA_searcher(&nfa, &reversed, DFA_LEFTMOST_LONGEST, &searcher);
+    NFA_dispose(&nfa);
+    NFA_dispose(&reversed);
+
+    if ( (n_found = scan_file(&searcher, path, mode, stdout)) == -1) {
+        perror(path); exit(-1);
+    }
+
+    destroy_DFA_searcher(&searcher);
+    return n_found != 0 ? 0 : 1;
+}
+
+/* Compile a set of regexps to a minimized DFA and save it as an image */
+static int __compile(const char *path, const char *const *regexps, int n)
+{
+    struct NFA_set set;
+    struct DFA *dfa, *dfa_opt;
+    struct DFA_table table;
+
+    set = regs_to_NFA_set(regexps, n);
+    NFA_set_reduce(&set);
+    dfa = NFA_set_to_DFA(&set);
+    dfa_opt = DFA_optimize(dfa);
+    DFA_compile(dfa_opt, &table);
+    DFA_dispose(dfa);
+    DFA_dispose(dfa_opt);
+    NFA_set_dispose(&set);
+
+    if (DFA_image_save(&table, n, DFA_image_hash(regexps, n), path) == -1) {
+        perror(path); exit(-1);
+    }
+    fprintf(stderr, "%s: %d patterns, %d states\n",
+        path, n, table.n_states);
+
+    DFA_table_dispose(&table);
+    return 0;
+}
+
+/* Load a DFA image and print the patterns each string matches, the exit
+ * status is 0 if any string matched, 1 if none did */
+static int __load(const char *path, char *const *strs, int n)
+{
+    struct DFA_image image;
+    const int *ids;
+    int i, k, n_ids, n_matched = 0;
+
+    if (DFA_image_load(path, &image) == -1) {
+        perror(path); exit(-1);
+    }
+    fprintf(stderr, "%s: %d patterns, %d states, hash %016" PRIx64 "\n",
+        path, image.n_patterns, image.table.n_states, image.pattern_hash);
+
+    for (i = 0; i < n; i++)
+    {
+        n_ids = DFA_match_patterns(&image.table, strs[i], strlen(strs[i]),
+            &ids);
+        printf("%s:", strs[i]);
+        for (k = 0; k < n_ids; k++)  printf(" %d", ids[k]);
+        printf("\n");
+
+        if (n_ids != 0)  n_matched++;
+    }
+
+    DFA_image_unload(&image);
+    return n_matched != 0 ? 0 : 1;
+}
+
+/* Parse the --codegen[=goto|table] option, it returns -1 if arg is not
+ * valid */
+static int __parse_codegen_option(const char *arg)
+{
+    if (strcmp(arg, "--codegen") == 0 || strcmp(arg, "--codegen=goto") == 0)
+        return DFA_CODEGEN_GOTO;
+    if (strcmp(arg, "--codegen=table") == 0)
+        return DFA_CODEGEN_TABLE;
+
+    return -1;
+}
+
+/* Print a C matcher function of the minimized DFA of a set of regexps */
+static int __codegen(enum DFA_codegen_style style, const char *name,
+    const char *const *regexps, int n)
+{
+    struct NFA_set set;
+    struct DFA *dfa, *dfa_opt;
+
+    set = regs_to_NFA_set(regexps, n);
+    NFA_set_reduce(&set);
+    dfa = NFA_set_to_DFA(&set);
+    dfa_opt = DFA_optimize(dfa);
+
+    DFA_dump_c_code(dfa_opt, name, style, stdout);
+
+    DFA_dispose(dfa);
+    DFA_dispose(dfa_opt);
+    NFA_set_dispose(&set);
+    return 0;
+}
 
 
 int main(int argc, char *argv[])
 {
-    struct NFA nfa;
-    struct DFA_state *dfa, *dfa_opt;
+    struct NFA_set set;
+    struct reg_pool pool;
+    struct DFA *dfa, *dfa_opt;
+    int i, root;
 
     FILE *fp_nfa, *fp_dfa, *fp_dfa_opt;
 
-    if (argc == 2)
+    struct stats stats;
+    struct stats_time since;
+    int stats_format = STATS_OFF;
+    int scan_mode, codegen_style, option;
+    int engine = ENGINE_THOMPSON, is_reduced = 0;
+    struct compile_budget budget;
+    enum compile_error error;
+
+    if (argc == 4 && (scan_mode = __parse_scan_option(argv[1])) != -1)
+        return __scan((enum scan_mode) scan_mode, argv[2], argv[3]);
+    if (argc >= 3 && strncmp(argv[1], "--compile=", 10) == 0)
+    {
+        return __compile(argv[1] + 10,
+            (const char *const *)(argv + 2), argc - 2);
+    }
+    if (argc >= 3 && strncmp(argv[1], "--load=", 7) == 0)
+        return __load(argv[1] + 7, argv + 2, argc - 2);
+    if (argc >= 4 &&
+        (codegen_style = __parse_codegen_option(argv[1])) != -1)
+    {
+        return __codegen((enum DFA_codegen_style) codegen_style, argv[2],
+            (const char *const *)(argv + 3), argc - 3);
+    }
+
+    /* options come in any order before the first regexp, the DFA may be
+     * limited to a num of states */
+    memset(&budget, 0, sizeof(budget));
+    for ( ; argc >= 3; argv++, argc--)
+    {
+        if ((option = __parse_stats_option(argv[1])) != -1)
+            stats_format = option;
+        else if ((option = __parse_engine_option(argv[1])) != -1)
+            engine = option;
+        else if (strcmp(argv[1], "--reduce") == 0)
+            is_reduced = 1;
+        else if (strncmp(argv[1], "--max-states=", 13) == 0)
+            budget.max_DFA_states = atoi(argv[1] + 13);
+        else
+            break;
+    }
+    if (stats_format != STATS_OFF)  stats_enable(&stats);
+
+    if (argc >= 2)
     {
         if ( (fp_nfa = fopen("nfa.dot", "w")) == NULL) {
             perror("fopen nfa.dot error"); exit(-1);
@@ -36,25 +258,93 @@ int main(int argc, char *argv[])
             perror("fopen dfa_opt.dot error"); exit(-1);
         }
 
-        fprintf(stderr, "regexp: %s\n", argv[1]);
+        for (i = 1; i < argc; i++)
+        {
+            if (argc == 2)
+                fprintf(stderr, "regexp: %s\n", argv[i]);
+            else
+                fprintf(stderr, "regexp %d: %s\n", i - 1, argv[i]);
+        }
+
+        /* parse regexps and generate NFA and DFA, a single regexp is
+         * simply a set of one pattern */
+        if (engine == ENGINE_THOMPSON)
+        {
+            stats_now(&since);
+            set = regs_to_NFA_set((const char *const *)(argv + 1), argc - 1);
+            stats_end_phase(STATS_PARSE, &since);
 
-        /* parse regexp and generate NFA and DFA */
-        nfa = reg_to_NFA(argv[1]);
-        dfa = NFA_to_DFA(&nfa);
+            /* nfa.dot shows the reduced NFA as well */
+            if (is_reduced)
+            {
+                stats_now(&since);
+                NFA_set_reduce(&set);
+                stats_end_phase(STATS_REDUCE, &since);
+            }
+
+            stats_now(&since);
+            error = NFA_set_to_DFA_within(&set, &budget, &dfa);
+            stats_end_phase(STATS_DETERMINIZE, &since);
+        }
+        else
+        {
+            /* the derivative engine has no NFA, the Thompson NFA is made
+             * for nfa.dot only after the DFA is built */
+            stats_now(&since);
+            create_reg_pool(&pool);
+            root = regs_to_AST((const char *const *)(argv + 1), argc - 1,
+                &pool);
+            stats_end_phase(STATS_PARSE, &since);
+
+            stats_now(&since);
+            error = AST_to_DFA_within(&pool, root, &budget, &dfa);
+            destroy_reg_pool(&pool);
+            stats_end_phase(STATS_DETERMINIZE, &since);
+
+            set = regs_to_NFA_set((const char *const *)(argv + 1), argc - 1);
+        }
+
+        if (error != COMPILE_OK)
+        {
+            fprintf(stderr, "%s (limit %d)\n",
+                compile_error_string(error), budget.max_DFA_states);
+            NFA_set_dispose(&set);
+            fclose(fp_nfa); fclose(fp_dfa); fclose(fp_dfa_opt);
+            return 1;
+        }
+
+        stats_now(&since);
         dfa_opt = DFA_optimize(dfa);
+        stats_end_phase(STATS_MINIMIZE, &since);
 
         /* dump NFA and DFA as graphviz code */
-        NFA_dump_graphviz_code(&nfa, fp_nfa);
+        stats_now(&since);
+        NFA_set_dump_graphviz_code(&set, fp_nfa);
         DFA_dump_graphviz_code(dfa, fp_dfa);
         DFA_dump_graphviz_code(dfa_opt, fp_dfa_opt);
+        stats_end_phase(STATS_DUMP, &since);
 
         /* finalize */
-        NFA_dispose(&nfa);    fclose(fp_nfa);
+        stats_collect_memory_usage();
+        stats_now(&since);
+        NFA_set_dispose(&set); fclose(fp_nfa);
         DFA_dispose(dfa);     fclose(fp_dfa);
         DFA_dispose(dfa_opt); fclose(fp_dfa_opt);
+        stats_end_phase(STATS_DISPOSE, &since);
+
+        if (stats_format == STATS_TEXT)  stats_dump_text(&stats, stdout);
+        if (stats_format == STATS_JSON)  stats_dump_json(&stats, stdout);
     }
     else {
-        printf("usage: %s 'regexp'\n", argv[0]);
+        printf("usage: %s [--stats[=text|json]] "
+               "[--engine=thompson|derivative] [--reduce]\n"
+               "           [--max-states=N] 'regexp' ['regexp' ...]\n"
+               "       %s --scan[=lines|offsets|quiet] FILE 'regexp'\n"
+               "       %s --compile=IMAGE 'regexp' ['regexp' ...]\n"
+               "       %s --load=IMAGE 'string' ['string' ...]\n"
+               "       %s --codegen[=goto|table] NAME 'regexp' "
+               "['regexp' ...]\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0]);
     }
 
     return 0;
@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+
+
+/* Header in front of each block, it is padded to the strictest alignment so
+ * that the block itself is as well aligned as the one malloc returns */
+union __mem_header
+{
+    size_t size;          /* size of the block requested by user */
+    max_align_t _align;
+};
+
+/* each thread counts its own blocks, so allocating never races */
+static _Thread_local struct mem_usage __usage;
+
+
+/* Account for a block of size bytes which has just been allocated */
+static void *__account_alloc(union __mem_header *header, size_t size)
+{
+    if (header == NULL)  return NULL;
+
+    header->size = size;
+    __usage.current += size;
+    __usage.total   += size;
+    __usage.n_allocs++;
+    if (__usage.current > __usage.peak)  __usage.peak = __usage.current;
+
+    return header + 1;
+}
+
+void *mem_alloc(size_t size)
+{
+    return __account_alloc((union __mem_header*)
+        malloc(sizeof(union __mem_header) + size), size);
+}
+
+void *mem_calloc(size_t n_elems, size_t elem_size)
+{
+    size_t size = n_elems * elem_size;
+    void *ptr = mem_alloc(size);
+
+    if (ptr != NULL)  memset(ptr, 0, size);
+    return ptr;
+}
+
+void *mem_realloc(void *ptr, size_t size)
+{
+    union __mem_header *header;
+    size_t old_size;
+
+    if (ptr == NULL)  return mem_alloc(size);
+
+    header   = (union __mem_header*)ptr - 1;
+    old_size = header->size;
+    ptr = realloc(header, sizeof(union __mem_header) + size);
+    if (ptr == NULL)  return NULL;   /* the old block is left untouched */
+
+    __usage.current -= old_size;
+    return __account_alloc((union __mem_header*)ptr, size);
+}
+
+void mem_free(void *ptr)
+{
+    union __mem_header *header;
+
+    if (ptr == NULL)  return;
+
+    header = (union __mem_header*)ptr - 1;
+    __usage.current -= header->size;
+    free(header);
+}
+
+
+/* Get the memory usage of the calling thread so far */
+const struct mem_usage *mem_get_usage(void) {
+    return &__usage;
+}
@@ -0,0 +1,35 @@
+#ifndef __MEM_HEADER__
+#define __MEM_HEADER__
+
+
+#include <stddef.h>
+
+
+/* Accounting memory allocator. These are drop-in replacements of the standard
+ * allocation routines, each block carries a small header recording its size so
+ * that the allocator knows how many bytes are in use at any moment. Blocks
+ * allocated by them must be released by mem_free. */
+void *mem_alloc(size_t size);
+void *mem_calloc(size_t n_elems, size_t elem_size);
+void *mem_realloc(void *ptr, size_t size);
+void  mem_free(void *ptr);
+
+
+/* Memory usage of the calling thread. A block freed by another thread than
+ * the one allocating it is subtracted from the usage of the thread freeing
+ * it, so current may wrap around and only its differences tell the growth
+ * of the usage. */
+struct mem_usage
+{
+    size_t current;     /* bytes in use right now */
+    size_t peak;        /* max value of current ever reached */
+    size_t total;       /* bytes ever allocated, including reallocations */
+    long   n_allocs;    /* num of allocations */
+};
+
+/* Get the memory usage of the calling thread so far */
+const struct mem_usage *mem_get_usage(void);
+
+
+
+#endif /* __MEM_HEADER__ */
@@ -4,9 +4,14 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 
+#include "sset.h"
+#include "budget.h"
+#include "byte_class.h"
 
-/* definition of some transition characters. 
+
+/* definition of some transition characters.
    (NFATT here means "NFA transition type") */
 enum NFA_transition_type {
     NFATT_NONE,        /* placeholder */
@@ -14,54 +19,96 @@ enum NFA_transition_type {
     NFATT_EPSILON      /* epsilon transition */
 };
 
-/* Transition from one NFA state to another */
+/* Transition from one NFA state to another, packed in 3 bytes */
 struct NFA_transition
 {
-    /* type of the transition. It can be an epsilon transition, traditional
-     * character transition, or just a placeholder  */
-    enum NFA_transition_type trans_type;
-    char trans_char;   /* If trans_type is TT_CHARACTER, then trans_char
-                        * indicates the transition label */
+    /* type of the transition (enum NFA_transition_type). It can be an
+     * epsilon transition, traditional character transition, or just a
+     * placeholder  */
+    unsigned char trans_type;
+    unsigned char lo, hi;  /* If trans_type is NFATT_CHARACTER, the transition
+                            * is taken on any byte in [lo, hi] */
 };
 
 /* state in NFA, each state has at most 2 transitions if the NFA is constructed
- * from basic constructs of regular expressions. */
+ * from basic constructs of regular expressions. States refer to each other by
+ * their index in the arena, so a state record is only 16 bytes. */
 struct NFA_state
 {
-    struct NFA_state      *to[2];          /* destination of transition */
+    int32_t                to[2];          /* destination of transition */
     struct NFA_transition  transition[2];  /* transitions from this state */
 };
 
+/* Storage of all states of an NFA. It is a flat array of states indexed by
+ * state id, which grows by doubling. Since there's no pointer in it, the whole
+ * NFA can be moved, copied or written out as it is. */
+struct NFA_arena
+{
+    struct NFA_state *states;   /* states[id] is the state numbered id */
+    int n_states;               /* num of states allocated so far */
+    int capacity;               /* num of states the array can hold */
+};
+
 /* Non determined automata (NFA) */
 struct NFA
 {
-    struct NFA_state *start;     /* start state */
-    struct NFA_state *terminate; /* terminate state */
+    int start;                   /* start state */
+    int terminate;               /* terminate state */
+    struct NFA_arena *arena;     /* where the states live, it is shared by
+                                  * all NFAs assembled together */
 
     /* Notice that there should be only one terminate state if the NFA is
      * constructed purly from basic regular expression constructs */
 };
 
+/* NFA of a set of patterns. The NFAs of all patterns live in one arena and
+ * are joined by a common start state, reaching the terminate state of the
+ * i-th pattern means the i-th pattern is matched. */
+struct NFA_set
+{
+    struct NFA nfa;     /* the joined NFA, its terminate state is -1 since
+                         * each pattern has its own, unless there's only
+                         * one pattern */
+    int n_patterns;     /* num of patterns */
+    int *terminates;    /* terminates[i] is the terminate state of the i-th
+                         * pattern */
+};
+
+/* Get the address of state numbered id in the NFA, the address is invalidated
+ * once more states are allocated */
+#define NFA_STATE(nfa, id)  ((nfa)->arena->states + (id))
+
+
+/* Create an empty arena for building an NFA */
+struct NFA_arena *create_NFA_arena(void);
 
-/* Create a new isolated NFA state, there's no transitions going out of it */
-struct NFA_state *alloc_NFA_state(void);
+/* Free the arena along with all states allocated from it */
+void destroy_NFA_arena(struct NFA_arena *arena);
 
-/* Free allocated space for specified NFA state */
-void free_NFA_state(struct NFA_state *state);
+/* Create a new isolated NFA state in the arena and return its id, there's no
+ * transitions going out of it */
+int alloc_NFA_state(struct NFA_arena *arena);
 
 
+/* Check if the transition is taken on byte c */
+static inline int NFA_transition_accepts(
+    const struct NFA_transition *trans, unsigned char c)
+{
+    return trans->trans_type == NFATT_CHARACTER &&
+        trans->lo <= c && c <= trans->hi;
+}
+
 /* get number of transitions going out from specified NFA state */
 int NFA_state_transition_num(const struct NFA_state *state);
 
-/* Add another transition to specified NFA state, this function returns 0 on
- * success, or it would return an -1 when there's already 2 transitions going
- * out of this state */
-int NFA_state_add_transition(struct NFA_state *state, 
-    enum NFA_transition_type trans_type, char trans_char, 
-    struct NFA_state *to_state);
+/* Add another transition to specified NFA state which is taken on bytes in
+ * [lo, hi], this function returns 0 on success, or it would return an -1 when
+ * there's already 2 transitions going out of this state */
+int NFA_state_add_transition(struct NFA_state *state,
+    enum NFA_transition_type trans_type, int lo, int hi, int to_state);
 
-/* Add an epsilon transition from "from" to "to" */
-int NFA_epsilon_move(struct NFA_state *from, struct NFA_state *to);
+/* Add an epsilon transition from state "from" to state "to" in the arena */
+int NFA_epsilon_move(struct NFA_arena *arena, int from, int to);
 
 
 /* DEBUGGING ROUTINE: dump specified NFA state to fp */
@@ -70,12 +117,32 @@ void __dump_NFA_state(const struct NFA_state *state, FILE *fp);
 /* Dump DOT code to vizualize specified NFA */
 void NFA_dump_graphviz_code(const struct NFA *nfa, FILE *fp);
 
-/* Check if the string matches the pattern implied by the nfa */
+/* Dump DOT code to vizualize the NFA of a set of patterns, the terminate
+ * state of each pattern is labelled by the index of the pattern */
+void NFA_set_dump_graphviz_code(const struct NFA_set *set, FILE *fp);
+
+/* Compute the byte equivalence classes of all transitions in the NFA */
+void NFA_byte_classes(const struct NFA *nfa, struct byte_classes *bc);
+
+/* Extend a set of states to its epsilon closure. The members of the set work
+ * as the queue of a BFS, states reached by epsilon moves are appended to the
+ * tail and get expanded later in the same loop. */
+void NFA_epsilon_closure(const struct NFA *nfa, struct sparse_set *states);
+
+/* Check if the string matches the pattern implied by the nfa. This is a
+ * Thompson simulation which runs in O(strlen(str) * n_states) time and never
+ * backtracks, so it is safe to be used on untrusted input */
 int NFA_pattern_match(const struct NFA *nfa, const char *str);
 
 
-/* The smallest building block of regexp-NFA */
-struct NFA NFA_create_atomic(char c);                                 /* c   */
+/* The smallest building block of regexp-NFA, its states are allocated from
+ * the arena, which is then inherited by NFAs assembled from it */
+struct NFA NFA_create_atomic(struct NFA_arena *arena, char c);        /* c   */
+
+/* NFA recognizing any single byte c where member[c] is non-zero, it is a
+ * chain of byte ranges covering the members */
+struct NFA NFA_create_class(
+    struct NFA_arena *arena, const char *member);                /* [...] */
 
 /* Operators in regular expression, we could assemble NFAs with these methods
  * to build our final NFA for the regular expression. */
@@ -84,11 +151,79 @@ struct NFA NFA_alternate(const struct NFA *A, const struct NFA *B);   /* A|B */
 struct NFA NFA_optional(const struct NFA *A);                         /* A?  */
 struct NFA NFA_Kleene_closure(const struct NFA *A);                   /* A*  */
 struct NFA NFA_positive_closure(const struct NFA *A);                 /* A+  */
-
-
-/* Free an NFA */
+struct NFA NFA_containing(const struct NFA *A);                     /* .*A.* */
+
+
+/* Compile basic regular expression to NFA, a malformed regexp is reported
+ * and the process exits */
+struct NFA reg_to_NFA(const char *regexp);
+
+/* Compile basic regular expression to an NFA recognizing the reversal of the
+ * strings matched by the regexp, which can be run backwards over an input */
+struct NFA reg_to_reversed_NFA(const char *regexp);
+
+/* Compile a set of regular expressions to one NFA, the i-th regexp becomes
+ * the i-th pattern of the set */
+struct NFA_set regs_to_NFA_set(const char *const *regexps, int n_regexps);
+
+/* Compile basic regular expression to NFA within the budget, the NFA is
+ * stored to *nfa on success. It returns COMPILE_OK, or the error found and
+ * then nothing is left allocated. */
+enum compile_error reg_to_NFA_within(const char *regexp,
+    const struct compile_budget *budget, struct NFA *nfa);
+
+/* Compile basic regular expression to the NFA of its reversal within the
+ * budget, just like reg_to_NFA_within */
+enum compile_error reg_to_reversed_NFA_within(const char *regexp,
+    const struct compile_budget *budget, struct NFA *nfa);
+
+/* Compile a set of regular expressions to one NFA within the budget, the
+ * set is stored to *set on success. It returns COMPILE_OK, or the error
+ * found and then nothing is left allocated. A set of no regexps is
+ * COMPILE_NO_PATTERNS. */
+enum compile_error regs_to_NFA_set_within(const char *const *regexps,
+    int n_regexps, const struct compile_budget *budget, struct NFA_set *set);
+
+/* Compile a set of regular expressions to one NFA of their reversals within
+ * the budget, just like regs_to_NFA_set_within */
+enum compile_error regs_to_reversed_NFA_set_within(
+    const char *const *regexps, int n_regexps,
+    const struct compile_budget *budget, struct NFA_set *set);
+
+/* Join NFAs allocated from the same arena with a common start state, the
+ * i-th NFA becomes the i-th pattern of the set */
+struct NFA_set NFA_join(const struct NFA *nfas, int n_nfas);
+
+
+/* Reduce the NFA in place before determinization: epsilon moves are
+ * replaced by the transitions they lead to where those fit into the state,
+ * states with the same transitions are merged, and states that can't take
+ * part in a match are dropped. State ids change, but the language of the
+ * NFA and the priority order of its transitions are kept (see
+ * src/nfa_reduce.c). */
+void NFA_reduce(struct NFA *nfa);
+
+/* Reduce the NFA of a set of patterns in place, the terminate state of each
+ * pattern is kept apart from the others */
+void NFA_set_reduce(struct NFA_set *set);
+
+/* Reduce the NFA of a set of patterns in place within the budget (which may
+ * be NULL). The memory the reduction takes is known before it begins, so it
+ * returns COMPILE_TOO_MANY_BYTES leaving the set untouched if that exceeds
+ * the budget, or COMPILE_OK otherwise. */
+enum compile_error NFA_set_reduce_within(struct NFA_set *set,
+    const struct compile_budget *budget);
+
+
+/* Make a deep copy of the NFA with its own arena */
+struct NFA NFA_duplicate(const struct NFA *nfa);
+
+/* Free an NFA, this frees the arena so every NFA sharing it is gone */
 void NFA_dispose(struct NFA *nfa);
 
+/* Free an NFA of a set of patterns */
+void NFA_set_dispose(struct NFA_set *set);
+
 
 
 #endif /* __NFA_HEADER__ */
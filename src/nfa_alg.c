@@ -1,28 +1,26 @@
-#include "glist.h"
+#include "mem.h"
+#include "sset.h"
+#include "stats.h"
 #include "nfa.h"
 
 
 
-MAKE_COMPARE_FUNCTION(addr, struct NFA_state*)
-
-
-/* dump the transition from state to state->to[i_to] */
+/* dump the transition from state numbered id to state->to[i_to] */
 static void __NFA_transition_dump_graphviz(
-    const struct NFA_state *state, int i_to, FILE *fp)
+    const struct NFA_state *state, int id, int i_to, FILE *fp)
 {
     switch (state->transition[i_to].trans_type)
     {
     case NFATT_EPSILON:
-        fprintf(fp, "    addr_%p -> addr_%p [ label = \"epsilon\" ];\n", 
-            (void*)state,
-            (void*)state->to[i_to]);
+        fprintf(fp, "    s%d -> s%d [ label = \"epsilon\" ];\n", 
+            id, (int)state->to[i_to]);
         break;
 
     case NFATT_CHARACTER:
-        fprintf(fp, "    addr_%p -> addr_%p [ label = \"%c\" ];\n", 
-            (void*)state, 
-            (void*)state->to[i_to], 
-            state->transition[i_to].trans_char);
+        fprintf(fp, "    s%d -> s%d [ label = \"", id, (int)state->to[i_to]);
+        fprint_byte_range(fp, state->transition[i_to].lo,
+            state->transition[i_to].hi);
+        fprintf(fp, "\" ];\n");
         break;
 
     default:
@@ -30,86 +28,181 @@ static void __NFA_transition_dump_graphviz(
     }
 }
 
-/* dump the transitions to *all reachable* states from specified state */
-static void __NFA_reachable_states_dump_graphviz(
-    const struct NFA_state *state, struct generic_list *visited, FILE *fp)
-{
-    int n_to = NFA_state_transition_num(state);
-    int i_to = 0;
-
-    for ( ; i_to < n_to; i_to++)
-    {
-        /* dump this transition */
-        __NFA_transition_dump_graphviz(state, i_to, fp);
-
-        /* dump the transition target if it has not ever been dumped, exactly
-         * the same way with DFS. */
-        if (generic_list_add(
-                visited, &state->to[i_to], __cmp_addr) != 0) {
-            __NFA_reachable_states_dump_graphviz(state->to[i_to], visited, fp);
-        }
-    }
-}
-
-/* Dump DOT code to vizualize specified NFA */
-void NFA_dump_graphviz_code(const struct NFA *nfa, FILE *fp)
+/* Dump DOT code of the NFA, terminates[] are drawn as double circles and
+ * they're labelled by their indices if there's more than one of them */
+static void __NFA_dump_graphviz_code(const struct NFA *nfa,
+    const int *terminates, int n_terminates, FILE *fp)
 {
-    struct generic_list visited_state;
-    create_generic_list(struct NFA_state*, &visited_state);
+    const struct NFA_state *state = nfa->arena->states;
+    int id = 0, i_to, n_to, i;
 
     fprintf(fp, 
         "digraph finite_state_machine {\n"
         "    rankdir=LR;\n"
-        "    size=\"8,5\"\n"
-        "    node [shape = doublecircle label=\"\"]; addr_%p\n"
-        "    node [shape = circle]\n", (void*)nfa->terminate);
+        "    size=\"8,5\"\n");
+    for (i = 0; i < n_terminates; i++)
+    {
+        if (n_terminates == 1)
+            fprintf(fp, "    node [shape = doublecircle label=\"\"]; s%d\n",
+                terminates[i]);
+        else
+            fprintf(fp, "    node [shape = doublecircle label=\"%d\"]; s%d\n",
+                i, terminates[i]);
+    }
+    fprintf(fp, "    node [shape = circle label=\"\"]\n");
 
-    /* dump the finite state machine recursively */
-    generic_list_push_back(&visited_state, &nfa->start);
-    __NFA_reachable_states_dump_graphviz(nfa->start, &visited_state, fp);
+    /* every state in the arena belongs to the NFA, so we simply dump them
+     * one by one */
+    for ( ; id < nfa->arena->n_states; id++, state++)
+    {
+        n_to = NFA_state_transition_num(state);
+        for (i_to = 0; i_to < n_to; i_to++) {
+            __NFA_transition_dump_graphviz(state, id, i_to, fp);
+        }
+    }
 
     /* dump start mark */
     fprintf(fp, "    node [shape = none label=\"\"]; start\n");
-    fprintf(fp, "    start -> addr_%p [ label = \"start\" ]\n", 
-        (void*)nfa->start);
+    fprintf(fp, "    start -> s%d [ label = \"start\" ]\n", nfa->start);
 
     /* done */
     fprintf(fp, "}\n");
-    destroy_generic_list(&visited_state);
 }
 
+/* Dump DOT code to vizualize specified NFA */
+void NFA_dump_graphviz_code(const struct NFA *nfa, FILE *fp)
+{
+    __NFA_dump_graphviz_code(nfa, &nfa->terminate, 1, fp);
+}
 
-/* Match the given substring in a recursive fasion */
-static int __NFA_is_substate_match(
-    const struct NFA_state *state, const char *str)
+/* Dump DOT code to vizualize the NFA of a set of patterns, the terminate
+ * state of each pattern is labelled by the index of the pattern */
+void NFA_set_dump_graphviz_code(const struct NFA_set *set, FILE *fp)
 {
-    char c = str[0];  /* transition to match */
-    int i_trans = 0, n_trans = NFA_state_transition_num(state);
-    int is_matched = 0;
+    __NFA_dump_graphviz_code(
+        &set->nfa, set->terminates, set->n_patterns, fp);
+}
 
-    /* If we reached the terminate state while consumed the entire string*/
-    if (c == '\0' && n_trans == 0)   return 1;   /* str matched the nfa */
 
-    for ( ; i_trans < n_trans; i_trans++)
+/* Compute the byte equivalence classes of all transitions in the NFA */
+void NFA_byte_classes(const struct NFA *nfa, struct byte_classes *bc)
+{
+    const struct NFA_state *state = nfa->arena->states;
+    int id = 0, i_trans, n_trans;
+
+    byte_classes_init(bc);
+    for ( ; id < nfa->arena->n_states; id++, state++)
     {
-        /* if it is an epsilon move, we can take this way instantly */
-        if (state->transition[i_trans].trans_type == NFATT_EPSILON) {
-            is_matched = __NFA_is_substate_match(state->to[i_trans], str);
-        }
-        /* or it must be a character transition, check if we can take it */
-        else if (state->transition[i_trans].trans_char == c) {
-            is_matched = __NFA_is_substate_match(state->to[i_trans], str + 1);
+        n_trans = NFA_state_transition_num(state);
+        for (i_trans = 0; i_trans < n_trans; i_trans++)
+        {
+            if (state->transition[i_trans].trans_type == NFATT_CHARACTER)
+            {
+                byte_classes_add_range(bc, state->transition[i_trans].lo,
+                    state->transition[i_trans].hi);
+            }
         }
+    }
+    byte_classes_finish(bc);
+}
+
+/* Extend a set of states to its epsilon closure. The members of the set work
+ * as the queue of a BFS, states reached by epsilon moves are appended to the
+ * tail and get expanded later in the same loop. */
+void NFA_epsilon_closure(const struct NFA *nfa, struct sparse_set *states)
+{
+    const struct NFA_state *state;
+    int i_state = 0, i_trans, n_trans;
+
+    STATS_INC(n_epsilon_closures);
+    for ( ; i_state < states->length; i_state++)
+    {
+        state = nfa->arena->states + states->dense[i_state];
+        n_trans = NFA_state_transition_num(state);
 
-        if (is_matched) return 1;
+        for (i_trans = 0; i_trans < n_trans; i_trans++)
+        {
+            if (state->transition[i_trans].trans_type == NFATT_EPSILON)
+                sparse_set_add(states, state->to[i_trans]);
+        }
     }
+}
+
+/* Add state and every state in its epsilon closure to the thread list, stack
+ * is a scratch buffer of at least n_states entries. Each state gets pushed at
+ * most once since it is checked against the list before being pushed. */
+static void __NFA_add_thread(
+    struct sparse_set *list, const struct NFA_state *states, int id, 
+    int *stack)
+{
+    const struct NFA_state *state;
+    int sp = 0, i_trans, n_trans;
+
+    if (!sparse_set_add(list, id))  return;
+    STATS_INC(n_epsilon_closures);
+    stack[sp++] = id;
 
-    return 0;  /* not matched */
+    while (sp != 0)
+    {
+        state = states + stack[--sp];
+        n_trans = NFA_state_transition_num(state);
+
+        for (i_trans = 0; i_trans < n_trans; i_trans++)
+        {
+            if (state->transition[i_trans].trans_type == NFATT_EPSILON &&
+                sparse_set_add(list, state->to[i_trans]))
+            {
+                stack[sp++] = state->to[i_trans];
+            }
+        }
+    }
 }
 
-/* Check if the string matches the pattern implied by the nfa */
+/* Check if the string matches the pattern implied by the nfa. This is a
+ * Thompson simulation which runs in O(strlen(str) * n_states) time and never
+ * backtracks, so it is safe to be used on untrusted input */
 int NFA_pattern_match(const struct NFA *nfa, const char *str)
 {
-    /* find a sequence of transitions recursively */
-    return __NFA_is_substate_match(nfa->start, str);
+    struct sparse_set clist, nlist, tmp;    /* current and next thread list */
+    const struct NFA_state *states = nfa->arena->states, *state;
+    int i_thread, i_trans, n_trans, is_matched, *stack;
+
+    /* the whole scratch space is allocated up front: 2 thread lists and a DFS
+     * stack which are all n_states entries long */
+    stack = (int*)mem_alloc(nfa->arena->n_states * sizeof(int));
+    create_sparse_set(nfa->arena->n_states, &clist);
+    create_sparse_set(nfa->arena->n_states, &nlist);
+
+    __NFA_add_thread(&clist, states, nfa->start, stack);
+
+    /* advance all threads in lock-step, one character at a time */
+    for ( ; *str != '\0' && clist.length != 0; str++)
+    {
+        for (i_thread = 0; i_thread < clist.length; i_thread++)
+        {
+            state = states + clist.dense[i_thread];
+            n_trans = NFA_state_transition_num(state);
+
+            for (i_trans = 0; i_trans < n_trans; i_trans++)
+            {
+                if (NFA_transition_accepts(
+                        state->transition + i_trans, (unsigned char) *str))
+                {
+                    __NFA_add_thread(&nlist, states, state->to[i_trans], stack);
+                }
+            }
+        }
+
+        tmp = clist; clist = nlist; nlist = tmp;
+        sparse_set_clear(&nlist);
+    }
+
+    /* matched if the terminate state is alive after consuming the string */
+    is_matched = (*str == '\0' && sparse_set_contains(&clist, nfa->terminate));
+
+    destroy_sparse_set(&clist);
+    destroy_sparse_set(&nlist);
+    mem_free(stack);
+
+    return is_matched;
 }
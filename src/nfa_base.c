@@ -1,26 +1,55 @@
 #include <assert.h>
+#include <string.h>
 
-#include "glist.h"
+#include "mem.h"
 #include "nfa.h"
 
 
-/* Create a new isolated NFA state, there's no transitions going out of it */
-struct NFA_state *alloc_NFA_state(void)
+#define INITIAL_ARENA_CAPACITY  64   /* num of states in a new arena */
+
+
+/* Create an empty arena for building an NFA */
+struct NFA_arena *create_NFA_arena(void)
 {
-    struct NFA_state *state = 
-        (struct NFA_state*)malloc(sizeof(struct NFA_state));
-    struct NFA_transition null_transition = {NFATT_NONE, 0};
-    
-    /* create an isolated NFA state node */
-    state->to[0] = state->to[1] = NULL;
-    state->transition[0] = state->transition[1] = null_transition;
+    struct NFA_arena *arena = 
+        (struct NFA_arena*)mem_alloc(sizeof(struct NFA_arena));
 
-    return state;
+    arena->n_states = 0;
+    arena->capacity = INITIAL_ARENA_CAPACITY;
+    arena->states   = (struct NFA_state*)
+        mem_alloc(arena->capacity * sizeof(struct NFA_state));
+
+    return arena;
 }
 
-/* Free allocated space for specified NFA state */
-void free_NFA_state(struct NFA_state *state) {
-    free(state);
+/* Free the arena along with all states allocated from it */
+void destroy_NFA_arena(struct NFA_arena *arena)
+{
+    mem_free(arena->states);
+    mem_free(arena);
+}
+
+/* Create a new isolated NFA state in the arena and return its id, there's no
+ * transitions going out of it */
+int alloc_NFA_state(struct NFA_arena *arena)
+{
+    struct NFA_transition null_transition = {NFATT_NONE, 0, 0};
+    struct NFA_state *state;
+
+    /* if we're running out of space */
+    if (arena->n_states == arena->capacity)
+    {
+        arena->capacity *= 2;   /* expand two-fold */
+        arena->states = (struct NFA_state*)mem_realloc(
+            arena->states, arena->capacity * sizeof(struct NFA_state));
+    }
+
+    /* create an isolated NFA state node */
+    state = arena->states + arena->n_states;
+    state->to[0] = state->to[1] = -1;
+    state->transition[0] = state->transition[1] = null_transition;
+
+    return arena->n_states++;
 }
 
 /* get number of transitions going out from specified NFA state */
@@ -35,23 +64,24 @@ int NFA_state_transition_num(const struct NFA_state *state)
  * success, or it would return an -1 when there's already 2 transitions going
  * out of this state */
 int NFA_state_add_transition(struct NFA_state *state, 
-    enum NFA_transition_type trans_type, char trans_char, 
-    struct NFA_state *to_state)
+    enum NFA_transition_type trans_type, int lo, int hi, int to_state)
 {
     int i_trans = NFA_state_transition_num(state);
     if (i_trans >= 2)  return -1;  /* no empty slot avaliable */
     else {
-        state->transition[i_trans].trans_type = trans_type;
-        state->transition[i_trans].trans_char = trans_char;
+        state->transition[i_trans].trans_type = (unsigned char) trans_type;
+        state->transition[i_trans].lo         = (unsigned char) lo;
+        state->transition[i_trans].hi         = (unsigned char) hi;
         state->to[i_trans]                    = to_state;
         return 0;
     }
 }
 
-/* Add an epsilon transition from "from" to "to */
-int NFA_epsilon_move(struct NFA_state *from, struct NFA_state *to)
+/* Add an epsilon transition from state "from" to state "to" in the arena */
+int NFA_epsilon_move(struct NFA_arena *arena, int from, int to)
 {
-    return NFA_state_add_transition(from, NFATT_EPSILON, 0, to);
+    return NFA_state_add_transition(
+        arena->states + from, NFATT_EPSILON, 0, 0, to);
 }
 
 /* DEBUGGING ROUTINE: dump specified NFA state to fp */
@@ -66,8 +96,10 @@ void __dump_NFA_state(const struct NFA_state *state, FILE *fp)
         switch (state->transition[i_trans].trans_type)
         {
         case NFATT_CHARACTER:
-            fprintf(fp, "   alphabet transition: %c\n", 
-                state->transition[i_trans].trans_char);
+            fprintf(fp, "   alphabet transition: ");
+            fprint_byte_range(fp, state->transition[i_trans].lo,
+                state->transition[i_trans].hi);
+            fprintf(fp, "\n");
             break;
            
         case NFATT_EPSILON:
@@ -83,15 +115,50 @@ void __dump_NFA_state(const struct NFA_state *state, FILE *fp)
 
 
 /* Create an NFA for recognizing single character */
-struct NFA NFA_create_atomic(char c)
+struct NFA NFA_create_atomic(struct NFA_arena *arena, char c)
 {
     struct NFA nfa;
 
-    nfa.start     = alloc_NFA_state();
-    nfa.terminate = alloc_NFA_state();
+    nfa.arena     = arena;
+    nfa.start     = alloc_NFA_state(arena);
+    nfa.terminate = alloc_NFA_state(arena);
 
     assert(c != '\0');
-    NFA_state_add_transition(nfa.start, NFATT_CHARACTER, c, nfa.terminate);
+    NFA_state_add_transition(NFA_STATE(&nfa, nfa.start), NFATT_CHARACTER,
+        (unsigned char) c, (unsigned char) c, nfa.terminate);
+
+    return nfa;
+}
+
+/* NFA recognizing any single byte c where member[c] is non-zero, it is a
+ * chain of byte ranges covering the members */
+struct NFA NFA_create_class(struct NFA_arena *arena, const char *member)
+{
+    struct NFA nfa;
+    int lo, hi = -1, from, next;
+
+    nfa.arena     = arena;
+    nfa.start     = alloc_NFA_state(arena);
+    nfa.terminate = alloc_NFA_state(arena);
+
+    /* each state has room for 2 transitions, so the state from which a range
+     * goes out links to the next state with an epsilon move if there're
+     * more ranges to come */
+    from = nfa.start;
+    for (lo = 0; lo < 256; lo = hi + 1)
+    {
+        if (!member[lo]) { hi = lo; continue; }
+        for (hi = lo; hi < 255 && member[hi + 1]; hi++) ;
+
+        if (NFA_state_transition_num(arena->states + from) != 0)
+        {
+            next = alloc_NFA_state(arena);
+            NFA_epsilon_move(arena, from, next);
+            from = next;
+        }
+        NFA_state_add_transition(arena->states + from, NFATT_CHARACTER,
+            lo, hi, nfa.terminate);
+    }
 
     return nfa;
 }
@@ -102,8 +169,10 @@ struct NFA NFA_concatenate(const struct NFA *A, const struct NFA *B)
     struct NFA C;
     C.start     = A->start;
     C.terminate = B->terminate;
+    C.arena     = A->arena;
 
-    NFA_epsilon_move(A->terminate, B->start);
+    assert(A->arena == B->arena);
+    NFA_epsilon_move(C.arena, A->terminate, B->start);
 
     return C;
 }
@@ -112,13 +181,15 @@ struct NFA NFA_concatenate(const struct NFA *A, const struct NFA *B)
 struct NFA NFA_alternate(const struct NFA *A, const struct NFA *B)
 {
     struct NFA C;
-    C.start     = alloc_NFA_state();
-    C.terminate = alloc_NFA_state();
+    C.arena     = A->arena;
+    C.start     = alloc_NFA_state(C.arena);
+    C.terminate = alloc_NFA_state(C.arena);
 
-    NFA_epsilon_move(C.start,      A->start);
-    NFA_epsilon_move(C.start,      B->start);
-    NFA_epsilon_move(A->terminate, C.terminate);
-    NFA_epsilon_move(B->terminate, C.terminate);
+    assert(A->arena == B->arena);
+    NFA_epsilon_move(C.arena, C.start,      A->start);
+    NFA_epsilon_move(C.arena, C.start,      B->start);
+    NFA_epsilon_move(C.arena, A->terminate, C.terminate);
+    NFA_epsilon_move(C.arena, B->terminate, C.terminate);
 
     return C;
 }
@@ -127,11 +198,12 @@ struct NFA NFA_alternate(const struct NFA *A, const struct NFA *B)
 struct NFA NFA_optional(const struct NFA *A)
 {
     struct NFA C;
-    C.start     = alloc_NFA_state();
+    C.arena     = A->arena;
+    C.start     = alloc_NFA_state(C.arena);
     C.terminate = A->terminate;
 
-    NFA_epsilon_move(C.start, A->start);
-    NFA_epsilon_move(C.start, A->terminate);
+    NFA_epsilon_move(C.arena, C.start, A->start);
+    NFA_epsilon_move(C.arena, C.start, A->terminate);
 
     return C;
 }
@@ -140,12 +212,13 @@ struct NFA NFA_optional(const struct NFA *A)
 struct NFA NFA_Kleene_closure(const struct NFA *A)
 {
     struct NFA C;
-    C.start     = alloc_NFA_state();
-    C.terminate = alloc_NFA_state();
+    C.arena     = A->arena;
+    C.start     = alloc_NFA_state(C.arena);
+    C.terminate = alloc_NFA_state(C.arena);
 
-    NFA_epsilon_move(A->terminate, C.start);
-    NFA_epsilon_move(C.start,      A->start);
-    NFA_epsilon_move(C.start,      C.terminate);
+    NFA_epsilon_move(C.arena, A->terminate, C.start);
+    NFA_epsilon_move(C.arena, C.start,      A->start);
+    NFA_epsilon_move(C.arena, C.start,      C.terminate);
 
     return C;
 }
@@ -154,54 +227,105 @@ struct NFA NFA_Kleene_closure(const struct NFA *A)
 struct NFA NFA_positive_closure(const struct NFA *A)
 {
     struct NFA C;
-    C.start     = alloc_NFA_state();
-    C.terminate = alloc_NFA_state();
+    C.arena     = A->arena;
+    C.start     = alloc_NFA_state(C.arena);
+    C.terminate = alloc_NFA_state(C.arena);
 
-    NFA_epsilon_move(C.start,      A->start);
-    NFA_epsilon_move(A->terminate, C.start);
-    NFA_epsilon_move(A->terminate, C.terminate);
+    NFA_epsilon_move(C.arena, C.start,      A->start);
+    NFA_epsilon_move(C.arena, A->terminate, C.start);
+    NFA_epsilon_move(C.arena, A->terminate, C.terminate);
 
     return C;
 }
 
+/* C = .*A.* where . is any byte, C accepts every input having a substring
+ * accepted by A */
+struct NFA NFA_containing(const struct NFA *A)
+{
+    struct NFA C;
+    C.arena     = A->arena;
+    C.start     = alloc_NFA_state(C.arena);
+    C.terminate = alloc_NFA_state(C.arena);
 
-MAKE_COMPARE_FUNCTION(addr, int*)
+    NFA_state_add_transition(C.arena->states + C.start,
+        NFATT_CHARACTER, 0, 255, C.start);
+    NFA_epsilon_move(C.arena, C.start, A->start);
+    NFA_epsilon_move(C.arena, A->terminate, C.terminate);
+    NFA_state_add_transition(C.arena->states + C.terminate,
+        NFATT_CHARACTER, 0, 255, C.terminate);
+
+    return C;
+}
 
-/* Traverse the NFA while recording addresses of all states in a generic
- * list */
-static void __NFA_traverse(
-    struct NFA_state *state, struct generic_list *visited)
+
+/* Make a deep copy of the NFA with its own arena */
+struct NFA NFA_duplicate(const struct NFA *nfa)
 {
-    int i_to = 0, n_to = NFA_state_transition_num(state);
-    for ( ; i_to < n_to; i_to++)
-    {
-        /* DFS of graphs */
-        if (generic_list_add(
-                visited, &state->to[i_to], __cmp_addr) != 0) {
-            __NFA_traverse(state->to[i_to], visited);
-        }
-    }
+    struct NFA copy = *nfa;
+
+    copy.arena = (struct NFA_arena*)mem_alloc(sizeof(struct NFA_arena));
+    *copy.arena = *nfa->arena;
+    copy.arena->states = (struct NFA_state*)
+        mem_alloc(copy.arena->capacity * sizeof(struct NFA_state));
+    memcpy(copy.arena->states, nfa->arena->states, 
+        nfa->arena->n_states * sizeof(struct NFA_state));
+
+    return copy;
 }
 
-/* Free an NFA */
+/* Free an NFA, this frees the arena so every NFA sharing it is gone */
 void NFA_dispose(struct NFA *nfa)
 {
-    struct generic_list visited;
+    destroy_NFA_arena(nfa->arena);
+}
+
 
-    struct NFA_state **cur;
-    int i_state = 0;
+/* Join NFAs allocated from the same arena with a common start state, the
+ * i-th NFA becomes the i-th pattern of the set */
+struct NFA_set NFA_join(const struct NFA *nfas, int n_nfas)
+{
+    struct NFA_set set;
+    struct NFA_arena *arena = nfas[0].arena;
+    int i = 0, from, next;
 
-    /* traverse the NFA and record all states in a generic list */
-    create_generic_list(struct NFA_state*, &visited);
-    generic_list_push_back(&visited, &nfa->start);
-    __NFA_traverse(nfa->start, &visited);
+    set.n_patterns = n_nfas;
+    set.terminates = (int*)mem_alloc(n_nfas * sizeof(int));
 
-    /* free all states */
-    for (cur = (struct NFA_state**) visited.p_dat; 
-         i_state < visited.length; i_state++, cur++)
+    /* a set of one pattern is just the NFA of the pattern */
+    if (n_nfas == 1)
     {
-        free_NFA_state(*cur);
+        set.nfa = nfas[0];
+        set.terminates[0] = nfas[0].terminate;
+        return set;
     }
 
-    destroy_generic_list(&visited);
+    set.nfa.arena     = arena;
+    set.nfa.start     = alloc_NFA_state(arena);
+    set.nfa.terminate = -1;
+
+    /* each state has room for 2 transitions, so the start state forks to
+     * the patterns through a chain of epsilon moves */
+    from = set.nfa.start;
+    for ( ; i < n_nfas; i++)
+    {
+        assert(nfas[i].arena == arena);
+
+        if (i + 1 < n_nfas && NFA_state_transition_num(arena->states + from))
+        {
+            next = alloc_NFA_state(arena);
+            NFA_epsilon_move(arena, from, next);
+            from = next;
+        }
+        NFA_epsilon_move(arena, from, nfas[i].start);
+        set.terminates[i] = nfas[i].terminate;
+    }
+
+    return set;
+}
+
+/* Free an NFA of a set of patterns */
+void NFA_set_dispose(struct NFA_set *set)
+{
+    destroy_NFA_arena(set->nfa.arena);
+    mem_free(set->terminates);
 }
@@ -0,0 +1,388 @@
+#include <string.h>
+
+#include "mem.h"
+#include "hset.h"
+#include "stats.h"
+#include "nfa.h"
+
+
+/* Reduction of NFAs. Thompson construction leaves an epsilon move at every
+ * join of fragments, and every one of them is walked again by each epsilon
+ * closure computed afterwards. The reduction rewrites the NFA in place, so
+ * everything taking an NFA takes the reduced one as well:
+
+   1. an epsilon move to a state q is replaced by the transitions of q, as
+      long as q is not a terminate state and they fit into the 2 slots of the
+      state, so chains of epsilon moves collapse
+   2. states with the same transitions to the same states are merged, which
+      is a cheap approximation of bisimulation
+   3. states unreachable from the start state, and states from which no
+      terminate state is reachable, are dropped
+
+ * Each rule keeps the language of every remaining state, and the order of
+ * the transitions of a state is kept, which the leftmost-first searcher
+ * relies on. */
+
+DEFINE_HASH_MAP(__signature_index, uint64_t, ~(uint64_t) 0, hash_uint64)
+
+
+/* Remove the transition in slot i of the state */
+static void __remove_transition(struct NFA_state *state, int i)
+{
+    struct NFA_transition null_transition = {NFATT_NONE, 0, 0};
+
+    if (i == 0)
+    {
+        state->transition[0] = state->transition[1];
+        state->to[0] = state->to[1];
+    }
+    state->transition[1] = null_transition;
+    state->to[1] = -1;
+}
+
+/* Replace epsilon moves of state p by the transitions of their targets,
+ * in_degree[] is kept up to date. It returns 1 if anything is changed. */
+static int __inline_epsilons(struct NFA_state *states, int p,
+    const int *pattern_of, int *in_degree)
+{
+    struct NFA_state *state = states + p, *target, merged;
+    int i = 0, k, n, q, n_target, n_epsilons, is_changed = 0;
+
+    while (i < NFA_state_transition_num(state))
+    {
+        q = state->to[i];
+        if (state->transition[i].trans_type != NFATT_EPSILON) {
+            i++; continue;
+        }
+
+        /* an epsilon move to itself does nothing */
+        if (q == p)
+        {
+            __remove_transition(state, i);
+            in_degree[p]--;
+            is_changed = 1;
+            continue;
+        }
+
+        target = states + q;
+        n_target = NFA_state_transition_num(target);
+        for (n_epsilons = k = 0; k < n_target; k++)
+            n_epsilons += target->transition[k].trans_type == NFATT_EPSILON;
+
+        /* reaching a terminate state matters by itself, and p only has 2
+         * slots. The number of epsilon moves may grow only if q is going
+         * away, which makes sure the rewriting stops. */
+        if (pattern_of[q] != -1 ||
+            NFA_state_transition_num(state) - 1 + n_target > 2 ||
+            (n_epsilons > 1 && in_degree[q] > 1))
+        {
+            i++; continue;
+        }
+
+        /* the transitions of q take the place of the epsilon move */
+        memset(&merged, 0, sizeof(merged));
+        merged.to[0] = merged.to[1] = -1;
+        for (n = k = 0; k < NFA_state_transition_num(state); k++)
+        {
+            if (k != i)
+            {
+                merged.transition[n] = state->transition[k];
+                merged.to[n++] = state->to[k];
+                continue;
+            }
+            for ( ; n - k < n_target; n++)
+            {
+                merged.transition[n] = target->transition[n - k];
+                merged.to[n] = target->to[n - k];
+            }
+        }
+
+        /* a state is a single thread of the leftmost-first searcher, so its
+         * bytes must not take priority over an epsilon move before them */
+        if (n == 2 && merged.transition[0].trans_type == NFATT_EPSILON &&
+            merged.transition[1].trans_type == NFATT_CHARACTER)
+        {
+            i++; continue;
+        }
+
+        for (k = 0; k < n_target; k++)  in_degree[target->to[k]]++;
+        in_degree[q]--;
+        *state = merged;
+        is_changed = 1;
+    }
+
+    return is_changed;
+}
+
+/* Find the state a state is merged to */
+static int __find(int *rep, int id)
+{
+    int root = id, next;
+
+    while (rep[root] != root)  root = rep[root];
+    for ( ; id != root; id = next) {
+        next = rep[id]; rep[id] = root;
+    }
+    return root;
+}
+
+/* Signature of a state for merging: its pattern and its transitions with
+ * their targets merged. The transitions are kept in their slots, since
+ * states with the same transitions in a different order would prefer
+ * different matches. */
+struct __signature
+{
+    int pattern;
+    int n_trans;
+    int type[2], lo[2], hi[2], to[2];
+};
+
+static void __signature_of(const struct NFA_state *state, int pattern,
+    int *rep, struct __signature *sig)
+{
+    int i, n = NFA_state_transition_num(state);
+
+    memset(sig, 0, sizeof(*sig));
+    sig->pattern = pattern;
+    sig->n_trans = n;
+    for (i = 0; i < n; i++)
+    {
+        sig->type[i] = state->transition[i].trans_type;
+        sig->lo[i]   = state->transition[i].lo;
+        sig->hi[i]   = state->transition[i].hi;
+        sig->to[i]   = __find(rep, state->to[i]);
+    }
+}
+
+/* Hash a signature, the empty key of the index is never returned */
+static uint64_t __hash_signature(const struct __signature *sig)
+{
+    const int *p = (const int*) sig;
+    uint64_t h = 0xcbf29ce484222325ull;   /* FNV-1a */
+    size_t i;
+
+    for (i = 0; i < sizeof(*sig) / sizeof(int); i++)
+        h = (h ^ (uint32_t) p[i]) * 0x100000001b3ull;
+    return h >> 1;
+}
+
+/* Merge states with the same signature until nothing changes, it returns
+ * the num of states merged */
+static int __merge_duplicates(struct NFA_state *states, int n_states,
+    const int *pattern_of, int *rep)
+{
+    struct __signature_index index;
+    struct __signature sig, other;
+    int id, other_id, n_merged, total = 0;
+    uint64_t key;
+
+    do {
+        n_merged = 0;
+        __signature_index_init(&index);
+        for (id = 0; id < n_states; id++)
+        {
+            if (rep[id] != id)  continue;
+
+            __signature_of(states + id, pattern_of[id], rep, &sig);
+            key = __hash_signature(&sig);
+            other_id = __signature_index_get(&index, key);
+            if (other_id == -1 || __find(rep, other_id) != other_id) {
+                __signature_index_put(&index, key, id); continue;
+            }
+
+            /* entries of the index may be stale, or just collide */
+            __signature_of(states + other_id, pattern_of[other_id], rep,
+                &other);
+            if (memcmp(&sig, &other, sizeof(sig)) == 0) {
+                rep[id] = other_id; n_merged++;
+            }
+        }
+        __signature_index_destroy(&index);
+        total += n_merged;
+    } while (n_merged != 0);
+
+    return total;
+}
+
+/* Mark the states reachable from the states already in the set, following
+ * transitions forwards, or backwards through the reversed edges in
+ * first[]/edges[] if they are given */
+static void __mark_reachable(const struct NFA_state *states,
+    const int *first, const int *edges, struct sparse_set *set)
+{
+    const struct NFA_state *state;
+    int i, k, id, n;
+
+    for (i = 0; i < set->length; i++)
+    {
+        id = set->dense[i];
+        if (edges != NULL)
+        {
+            for (k = first[id]; k < first[id + 1]; k++)
+                sparse_set_add(set, edges[k]);
+            continue;
+        }
+
+        state = states + id;
+        n = NFA_state_transition_num(state);
+        for (k = 0; k < n; k++)  sparse_set_add(set, state->to[k]);
+    }
+}
+
+/* Upper bound of the bytes the reduction of an NFA of n_states states takes
+ * at the same time: 5 ints of each state, the reversed edges, which are 2
+ * per state at most, the sets of reachable and live states, the index of
+ * signatures, whose table has 4 slots per entry at most and doubles by
+ * copying, and the reduced states */
+static size_t __reduction_bytes(int n_states)
+{
+    size_t n = (size_t) n_states + 1;
+
+    return n * 11 * sizeof(int) +
+        (8 * n + INITIAL_HASH_SLOTS) * (sizeof(uint64_t) + sizeof(int)) +
+        n * sizeof(struct NFA_state);
+}
+
+/* Reduce an NFA whose patterns end at terminates[] */
+static void __reduce(struct NFA *nfa, int *terminates, int n_terminates)
+{
+    struct NFA_arena *arena = nfa->arena;
+    struct NFA_state *states = arena->states, *kept, *state;
+    struct sparse_set reachable, live;
+    int n_states = arena->n_states, id, i, k, n, n_kept, is_changed;
+    int *pattern_of, *in_degree, *rep, *new_id, *first, *edges;
+
+    pattern_of = (int*)mem_alloc(n_states * sizeof(int));
+    in_degree  = (int*)mem_calloc(n_states, sizeof(int));
+    rep        = (int*)mem_alloc(n_states * sizeof(int));
+    new_id     = (int*)mem_alloc(n_states * sizeof(int));
+    first      = (int*)mem_calloc(n_states + 1, sizeof(int));
+
+    for (id = 0; id < n_states; id++)  pattern_of[id] = -1;
+    for (i = 0; i < n_terminates; i++)  pattern_of[terminates[i]] = i;
+
+    /* 1. epsilon moves, the start state counts as referred once more */
+    in_degree[nfa->start]++;
+    for (id = 0; id < n_states; id++)
+    {
+        n = NFA_state_transition_num(states + id);
+        for (k = 0; k < n; k++)  in_degree[states[id].to[k]]++;
+    }
+    do {
+        is_changed = 0;
+        for (id = 0; id < n_states; id++)
+            is_changed |= __inline_epsilons(states, id, pattern_of, in_degree);
+    } while (is_changed);
+
+    /* 2. duplicated states */
+    for (id = 0; id < n_states; id++)  rep[id] = id;
+    __merge_duplicates(states, n_states, pattern_of, rep);
+    for (id = 0; id < n_states; id++)
+    {
+        n = NFA_state_transition_num(states + id);
+        for (k = 0; k < n; k++)
+            states[id].to[k] = __find(rep, states[id].to[k]);
+    }
+    nfa->start = __find(rep, nfa->start);
+
+    /* 3. useless states. Reversed edges are counted into first[] and then
+     * filled into edges[], so live states are found by a BFS backwards from
+     * the terminate states */
+    create_sparse_set(n_states, &reachable);
+    sparse_set_add(&reachable, nfa->start);
+    __mark_reachable(states, NULL, NULL, &reachable);
+
+    for (id = 0; id < n_states; id++)
+    {
+        n = NFA_state_transition_num(states + id);
+        for (k = 0; k < n; k++)  first[states[id].to[k] + 1]++;
+    }
+    for (id = 0; id < n_states; id++)  first[id + 1] += first[id];
+    edges = (int*)mem_alloc((first[n_states] + 1) * sizeof(int));
+    for (id = 0; id < n_states; id++)
+    {
+        n = NFA_state_transition_num(states + id);
+        for (k = 0; k < n; k++)
+            edges[first[states[id].to[k]]++] = id;
+    }
+    for (id = n_states; id > 0; id--)  first[id] = first[id - 1];
+    first[0] = 0;
+
+    create_sparse_set(n_states, &live);
+    for (i = 0; i < n_terminates; i++)  sparse_set_add(&live, terminates[i]);
+    __mark_reachable(states, first, edges, &live);
+
+    /* states are renumbered in their original order, the start state and
+     * the terminate states are always kept */
+    for (n_kept = id = 0; id < n_states; id++)
+    {
+        if (id == nfa->start || pattern_of[id] != -1 ||
+            (sparse_set_contains(&reachable, id) &&
+             sparse_set_contains(&live, id)))
+            new_id[id] = n_kept++;
+        else
+            new_id[id] = -1;
+    }
+
+    kept = (struct NFA_state*)mem_alloc(n_kept * sizeof(struct NFA_state));
+    for (id = 0; id < n_states; id++)
+    {
+        if (new_id[id] == -1)  continue;
+
+        state = kept + new_id[id];
+        *state = states[id];
+        for (k = NFA_state_transition_num(state) - 1; k >= 0; k--)
+        {
+            if (new_id[state->to[k]] == -1)
+                __remove_transition(state, k);
+            else
+                state->to[k] = new_id[state->to[k]];
+        }
+    }
+
+    mem_free(arena->states);
+    arena->states   = kept;
+    arena->n_states = arena->capacity = n_kept;
+
+    nfa->start = new_id[nfa->start];
+    for (i = 0; i < n_terminates; i++)  terminates[i] = new_id[terminates[i]];
+    STATS_ADD(n_reduced_NFA_states, n_kept);
+
+    destroy_sparse_set(&reachable);
+    destroy_sparse_set(&live);
+    mem_free(pattern_of);
+    mem_free(in_degree);
+    mem_free(rep);
+    mem_free(new_id);
+    mem_free(first);
+    mem_free(edges);
+}
+
+
+/* Reduce the NFA in place */
+void NFA_reduce(struct NFA *nfa)
+{
+    __reduce(nfa, &nfa->terminate, 1);
+}
+
+/* Reduce the NFA of a set of patterns in place */
+void NFA_set_reduce(struct NFA_set *set)
+{
+    NFA_set_reduce_within(set, NULL);
+}
+
+/* Reduce the NFA of a set of patterns in place within the budget (which may
+ * be NULL). The memory the reduction takes is known before it begins, so it
+ * returns COMPILE_TOO_MANY_BYTES leaving the set untouched if that exceeds
+ * the budget, or COMPILE_OK otherwise. */
+enum compile_error NFA_set_reduce_within(struct NFA_set *set,
+    const struct compile_budget *budget)
+{
+    if (budget != NULL && budget->max_bytes > 0 &&
+        __reduction_bytes(set->nfa.arena->n_states) > budget->max_bytes)
+        return COMPILE_TOO_MANY_BYTES;
+
+    __reduce(&set->nfa, set->terminates, set->n_patterns);
+    if (set->n_patterns == 1)  set->nfa.terminate = set->terminates[0];
+    return COMPILE_OK;
+}
@@ -1,282 +1,415 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
 
-#include "glist.h"
+#include "mem.h"
+#include "vec.h"
+#include "sset.h"
+#include "stats.h"
+#include "__nfa_state_set.h"
 #include "nfa.h"
 #include "dfa.h"
 
 
-MAKE_COMPARE_FUNCTION(char, char)
-MAKE_COMPARE_FUNCTION(addr, struct NFA_state*)
-
-
 /* In the NFA to DFA process, multiple NFA states were merged to an unique DFA
  * state. An DFA state entry is an correspondence between a set of NFA states
- * label (addr) and an DFA state. */
+ * and an DFA state, the set itself is kept by the registry in its bitset
+ * form. */
 struct __dfa_state_entry
 {
-    struct generic_list nfa_states;    /* set of NFA states */
-    struct DFA_state   *dfa_state;     /* corresponded DFA state */
+    uint64_t hash;          /* hash value of the set of NFA states */
+    int      dfa_state;     /* id of the corresponded DFA state */
 };
 
-/* Create a new DFA state and bind it with specified set of NFA states */
-static void __create_dfa_state_entry(
-    const struct generic_list *states, struct __dfa_state_entry *entry)
-{
-    /* the dfa state entry object keeps a copy of NFA state labels (addrs) and
-     * sort these labels for fast set comparisons */
-    generic_list_duplicate(&entry->nfa_states, states);
-    qsort(
-        entry->nfa_states.p_dat, 
-        entry->nfa_states.length, 
-        entry->nfa_states.elem_size, 
-        __cmp_addr);
-
-    /* create a new DFA state for this set of NFA states */
-    entry->dfa_state = alloc_DFA_state();
-}
-
-/* Free memory allocated for the entry object */
-static void __destroy_dfa_state_entry(struct __dfa_state_entry *entry) {
-    destroy_generic_list(&entry->nfa_states);
-}
+DEFINE_VECTOR(__dfa_state_entry_vector, struct __dfa_state_entry)
 
-/* compare if two generic lists are equivalent: 
-     (set(label_a) == set(label_b)) 
-*/
-static int __cmp_dfa_state_entry(const void *a_, const void *b_)
+/* All DFA state entries created so far, indexed by an open addressing hash
+ * table on their NFA state sets so that looking up an entry costs amortized
+ * O(1) instead of a scan over the whole entry list. */
+struct __dfa_state_registry
 {
-    struct NFA_state **sa, **sb;
-    int i = 0, length;
-
-    struct __dfa_state_entry *a = (struct __dfa_state_entry*) a_;
-    struct __dfa_state_entry *b = (struct __dfa_state_entry*) b_;
+    const struct NFA *nfa;              /* NFA being converted */
+    struct DFA *dfa;                    /* DFA being built */
+    const int *terminates;              /* terminate state of each pattern */
+    int n_patterns;                     /* num of patterns in the NFA */
+    const struct NFA_state *states;     /* NFA states indexed by id */
+    struct byte_classes classes;        /* byte classes of the NFA */
+
+    int n_words;                   /* num of words in each bitset */
+    uint32_t *keys;                /* bitset of the i-th entry begins at
+                                    * keys + i * n_words */
+    int keys_capacity;             /* num of bitsets keys can hold */
+    uint32_t *key;                 /* scratch bitset for lookups */
+
+    struct __dfa_state_entry_vector entries;   /* all entries created */
+    int *slots;                    /* index to entries, or -1 if empty */
+    int  n_slots;                  /* size of hash table, a power of 2 */
+
+    const struct compile_budget *budget;    /* limits of the DFA, or NULL */
+    size_t base;                   /* bytes in use when it started */
+};
 
-    struct generic_list *label_a = &a->nfa_states;
-    struct generic_list *label_b = &b->nfa_states;
+#define INITIAL_REGISTRY_SLOTS  64  /* default size of the hash table */
 
-    if (label_a->length != label_b->length) return 1;   /* not equal */
 
-    /* compare the elements of the states label list */
-    length = label_a->length;
-    for (sa = (struct NFA_state **)label_a->p_dat, 
-             sb = (struct NFA_state **)label_b->p_dat; 
-         i < length; i++, sa++, sb++)
-    {
-        if (*sa != *sb) return 1;
-    }
-
-    return 0;  /* a_ == b_ */
+static void __create_dfa_state_registry(const struct NFA *nfa,
+    const int *terminates, int n_patterns,
+    const struct compile_budget *budget, struct __dfa_state_registry *reg)
+{
+    reg->budget     = budget;
+    reg->base       = budget_bytes_base();
+    reg->nfa        = nfa;
+    reg->dfa        = create_DFA();
+    reg->terminates = terminates;
+    reg->n_patterns = n_patterns;
+    reg->states = nfa->arena->states;
+    NFA_byte_classes(nfa, &reg->classes);
+
+    reg->n_words       = NFA_STATE_SET_WORDS(nfa->arena->n_states);
+    reg->keys_capacity = INITIAL_VECTOR_CAPACITY;
+    reg->keys = (uint32_t*)
+        mem_alloc(reg->keys_capacity * reg->n_words * sizeof(uint32_t));
+    reg->key  = (uint32_t*)mem_alloc(reg->n_words * sizeof(uint32_t));
+
+    __dfa_state_entry_vector_init(&reg->entries);
+    reg->n_slots = INITIAL_REGISTRY_SLOTS;
+    reg->slots   = (int*)mem_alloc(reg->n_slots * sizeof(int));
+    memset(reg->slots, -1, reg->n_slots * sizeof(int));
 }
 
-/* Calculate the epsilon closure of specified state, all states in the
- * resulting closure are appended to the visited list */
-static void __NFA_state_epsilon_closure(
-    const struct NFA_state *state, struct generic_list *visited)
+static void __destroy_dfa_state_registry(struct __dfa_state_registry *reg)
 {
-    int i_trans = 0, n_trans = NFA_state_transition_num(state);
-
-    for ( ; i_trans < n_trans; i_trans++)
-    {
-        if (state->transition[i_trans].trans_type == NFATT_EPSILON)
-        {
-            /* storm down if we have not visited this state yet */
-            if (generic_list_add(
-                    visited, &state->to[i_trans], __cmp_addr) != 0) {
-                __NFA_state_epsilon_closure(state->to[i_trans], visited);
-            }
-        }
-    }
+    mem_free(reg->keys);
+    mem_free(reg->key);
+    __dfa_state_entry_vector_destroy(&reg->entries);
+    mem_free(reg->slots);
 }
 
-/* Figure out the epsilon closure of a set of states. */
-static void __NFA_epsilon_closure(struct generic_list *states)
+/* Get the bitset of the i-th entry */
+static uint32_t *__registry_key(
+    const struct __dfa_state_registry *reg, int i_entry)
 {
-    const struct NFA_state *state;
-    int i_state = 0, n_state = states->length;
-
-    for ( ; i_state < n_state; i_state++)
-    {
-        /* states->p_dat might be relocated while appending more elements */
-        state = *(((const struct NFA_state**) states->p_dat) + i_state);
-        __NFA_state_epsilon_closure(state, states);
-    }
+    return reg->keys + (size_t)i_entry * reg->n_words;
 }
 
-/* Get all possible transitions from specified set of states */
-static void __NFA_collect_transition_chars(
-    struct generic_list *states, struct generic_list *trans_char)
+/* Get the first slot probed by linear probing which either holds an entry
+ * with the same set as reg->key or is empty */
+static int *__find_registry_slot(
+    struct __dfa_state_registry *reg, uint64_t hash)
 {
-    struct NFA_state **s = (struct NFA_state**) states->p_dat;
+    const struct __dfa_state_entry *entries = reg->entries.data;
+    int mask = reg->n_slots - 1, i_slot = (int)(hash & mask), i_entry;
+    int n_probes = 1;
 
-    int i_state = 0, i_trans;
-    int n_states = states->length, n_trans;
-
-    for ( ; i_state < n_states; i_state++, s++)
+    for ( ; (i_entry = reg->slots[i_slot]) != -1;
+          i_slot = (i_slot + 1) & mask, n_probes++)
     {
-        n_trans = NFA_state_transition_num(*s);
-        for (i_trans = 0; i_trans < n_trans; i_trans++)
+        if (entries[i_entry].hash == hash &&
+            memcmp(__registry_key(reg, i_entry), reg->key,
+                reg->n_words * sizeof(uint32_t)) == 0)
         {
-            if ((*s)->transition[i_trans].trans_type == NFATT_CHARACTER)
-            {
-                generic_list_add(
-                    trans_char,
-                    &((*s)->transition[i_trans].trans_char), 
-                    __cmp_char);
-            }
+            break;
         }
     }
+
+    STATS_ADD(n_hash_probes, n_probes);
+    return reg->slots + i_slot;
 }
 
-/* Get all possible successor states under transition c to a set of given
- * states */
-static void __NFA_collect_target_states(
-    struct generic_list *states, char c, struct generic_list *new_states)
+/* Double the size of the hash table and re-insert all entries */
+static void __grow_dfa_state_registry(struct __dfa_state_registry *reg)
 {
-    struct NFA_state **s = (struct NFA_state**) states->p_dat;
+    const struct __dfa_state_entry *entries = reg->entries.data;
+    int i_entry = 0, mask, i_slot;
 
-    int i_state = 0, i_trans;
-    int n_states = states->length, n_trans;
+    mem_free(reg->slots);
+    reg->n_slots *= 2;
+    reg->slots = (int*)mem_alloc(reg->n_slots * sizeof(int));
+    memset(reg->slots, -1, reg->n_slots * sizeof(int));
 
-    for ( ; i_state < n_states; i_state++, s++)
+    mask = reg->n_slots - 1;
+    for ( ; i_entry < reg->entries.length; i_entry++)
     {
-        n_trans = NFA_state_transition_num(*s);
-        for (i_trans = 0; i_trans < n_trans; i_trans++)
-        {
-            if ((*s)->transition[i_trans].trans_type == NFATT_CHARACTER && 
-                (*s)->transition[i_trans].trans_char == c)
-            {
-                generic_list_add(new_states, &((*s)->to[i_trans]), __cmp_addr);
-            }
-        }
+        /* entries are all distinct, so just look for an empty slot */
+        i_slot = (int)(entries[i_entry].hash & mask);
+        while (reg->slots[i_slot] != -1)  i_slot = (i_slot + 1) & mask;
+        reg->slots[i_slot] = i_entry;
     }
 }
 
-static struct DFA_state *__get_DFA_state_address(
-    struct generic_list *dfa_state_entry_list, 
-    const struct generic_list *states, int *is_new_entry)
+/* Get the id of the DFA state of specified set of NFA states, a new entry and
+ * DFA state is registered if the set is never seen before. Entries and DFA
+ * states are created in the same order, so the i-th entry is of the DFA state
+ * numbered i. */
+static int __get_DFA_state_id(
+    struct __dfa_state_registry *reg, const struct sparse_set *states)
 {
-    struct __dfa_state_entry entry, *addr;
-    __create_dfa_state_entry(states, &entry);
+    struct __dfa_state_entry entry;
+    int *slot;
+
+    STATS_INC(n_set_lookups);
 
-    /* search in all logged entries first */
-    addr = (struct __dfa_state_entry *)
-        generic_list_find(dfa_state_entry_list, &entry, __cmp_dfa_state_entry);
+    /* convert the set to its canonical form */
+    __sparse_set_to_bitset(states, reg->key, reg->n_words);
+    entry.hash = __hash_bitset(reg->key, reg->n_words);
 
-    if (addr == NULL)    /* not found, we need to add a new entry/DFA state */
+    /* search in the hash table of all logged entries first */
+    slot = __find_registry_slot(reg, entry.hash);
+    if (*slot != -1)    /* entry/DFA state already exists */
     {
-        *is_new_entry = 1;
-        generic_list_push_back(dfa_state_entry_list, &entry);
-        return entry.dfa_state;
+        return reg->entries.data[*slot].dfa_state;
     }
-    else                 /* entry/DFA state already exists */
+
+    /* not found, we need to add a new entry/DFA state */
+    if (reg->entries.length == reg->keys_capacity)
     {
-        *is_new_entry = 0;
-        __destroy_dfa_state_entry(&entry);
-        free_DFA_state(entry.dfa_state);
-        return addr->dfa_state;
+        reg->keys_capacity *= 2;
+        reg->keys = (uint32_t*)mem_realloc(reg->keys,
+            (size_t)reg->keys_capacity * reg->n_words * sizeof(uint32_t));
     }
+    memcpy(__registry_key(reg, reg->entries.length), reg->key,
+        reg->n_words * sizeof(uint32_t));
+
+    entry.dfa_state = alloc_DFA_state(reg->dfa);
+    *slot = reg->entries.length;
+    __dfa_state_entry_vector_push(&reg->entries, entry);
+
+    /* keep the load factor of the hash table below 1/2 */
+    if (reg->entries.length * 2 > reg->n_slots)
+        __grow_dfa_state_registry(reg);
+
+    return entry.dfa_state;
 }
 
-/* Mark DFA states containing the terminate state of NFA as acceptable */
-static void __mark_acceptable_states(
-    const struct NFA_state *terminator, 
-    struct generic_list *dfa_state_entry_list)
+
+/* Mark DFA states containing the terminate state of a pattern as acceptable
+ * for that pattern */
+static void __mark_acceptable_states(const struct __dfa_state_registry *reg)
 {
     struct __dfa_state_entry *entry;
+    int i_pattern;
 
     int i_entry = 0;
-    for (entry = (struct __dfa_state_entry *) dfa_state_entry_list->p_dat; 
-         i_entry < dfa_state_entry_list->length; i_entry++, entry++)
+    for (entry = reg->entries.data;
+         i_entry < reg->entries.length; i_entry++, entry++)
     {
-        /* check if the terminator of NFA is merged into this DFA state */
-        if (generic_list_find(
-                &entry->nfa_states, &terminator, __cmp_addr) != NULL)
+        /* check if the terminator of each pattern is merged into this DFA
+         * state, if so, this DFA state accepts the pattern */
+        for (i_pattern = 0; i_pattern < reg->n_patterns; i_pattern++)
         {
-            /* if so, this DFA state becomes acceptable */
-            DFA_make_acceptable(entry->dfa_state);
+            if (BITSET_CONTAINS(__registry_key(reg, i_entry),
+                    reg->terminates[i_pattern]))
+                DFA_make_acceptable(reg->dfa, entry->dfa_state, i_pattern);
         }
     }
 }
 
-static void __NFA_to_DFA_rec(
-    struct generic_list *states, 
-    struct generic_list *dfa_state_entry_list)
+
+/* A character transition found while sweeping through a set of NFA states */
+struct __target_state
 {
-    struct generic_list trans_char, new_states;
-    struct DFA_state *from, *to;
-    int  i_char = 0;
-    int  if_rec, dummy;  /* if this state has already been created */
-    char *c;
+    int k;             /* byte class of the transition */
+    int id;            /* target NFA state */
+};
+
+DEFINE_VECTOR(__target_state_vector, struct __target_state)
+DEFINE_VECTOR(__int_vector, int)
+
+/* Sweep through every NFA state in the i-th entry once and bucket the target
+ * of each character transition by the byte classes its range covers. Targets
+ * are written to sorted->data[] grouped by class, and the bucket of class k
+ * is sorted->data[begin[k] .. begin[k+1]-1]. */
+static void __NFA_bucket_target_states(
+    const struct __dfa_state_registry *reg, int i_entry,
+    struct __target_state_vector *targets, struct __int_vector *sorted,
+    int *begin)
+{
+    const uint32_t *bits = __registry_key(reg, i_entry);
+    const struct NFA_state *state;
+    const struct NFA_transition *trans;
+    const struct byte_classes *bc = &reg->classes;
+    struct __target_state target;
+    const struct __target_state *t;
+    uint32_t word;
+    int i_word, i_trans, n_trans, k, k_last, i_target;
+
+    __target_state_vector_clear(targets);
+    memset(begin, 0, (bc->n_classes + 1) * sizeof(int));
+
+    /* enumerate members of the bitset */
+    for (i_word = 0; i_word < reg->n_words; i_word++)
+    {
+        for (word = bits[i_word]; word != 0; word &= word - 1)
+        {
+            state = reg->states + i_word * 32 + __builtin_ctz(word);
+            n_trans = NFA_state_transition_num(state);
 
-    create_generic_list(char, &trans_char);
-    create_generic_list(struct NFA_state*, &new_states);
+            for (i_trans = 0; i_trans < n_trans; i_trans++)
+            {
+                trans = state->transition + i_trans;
+                if (trans->trans_type != NFATT_CHARACTER)  continue;
+
+                /* a range covers a run of consecutive classes */
+                target.id = state->to[i_trans];
+                k_last = bc->map[trans->hi];
+                for (k = bc->map[trans->lo]; k <= k_last; k++)
+                {
+                    target.k = k;
+                    __target_state_vector_push(targets, target);
+                    begin[k + 1]++;
+                }
+            }
+        }
+    }
 
-    /* get all transition characters in states, we gonna storm each way down in
-     * the next for loop. */
-    __NFA_collect_transition_chars(states, &trans_char);
+    /* counting sort of the targets by byte class */
+    for (k = 0; k < bc->n_classes; k++)  begin[k + 1] += begin[k];
 
-    for (c = (char*)trans_char.p_dat; 
-         i_char < trans_char.length; i_char++, c++)
+    if (sorted->capacity < targets->length)
     {
-        /* get the epsilon closure of target states under transition *c */
-        __NFA_collect_target_states(states, *c, &new_states);
-        __NFA_epsilon_closure(&new_states);
+        sorted->capacity = targets->length;
+        sorted->data = (int*)mem_realloc(
+            sorted->data, sorted->capacity * sizeof(int));
+    }
+    sorted->length = targets->length;
 
-        /* Here we need to add states and new_states to the DFA, and connect
-         * them together with transition. */
-        from = __get_DFA_state_address(dfa_state_entry_list, states, &dummy);
-        to   = __get_DFA_state_address(dfa_state_entry_list, &new_states, &if_rec);
-        DFA_add_transition(from, to, *c);
+    t = targets->data;
+    for (i_target = 0; i_target < targets->length; i_target++, t++) {
+        sorted->data[begin[t->k]++] = t->id;
+    }
 
-        /* DFS: storm down this way and get its all successor states */
-        if (if_rec)
-            __NFA_to_DFA_rec(&new_states, dfa_state_entry_list);
+    /* begin[k] now points to the end of bucket k, shift them back */
+    for (k = bc->n_classes; k > 0; k--)  begin[k] = begin[k - 1];
+    begin[0] = 0;
+}
+
+/* Subset construction driven by an explicit worklist. The entry list of the
+ * registry is the worklist itself: entries are processed in the order they
+ * are created, and a newly found set of NFA states is appended to it, so the
+ * construction is a BFS which does not consume any C stack. The budget is
+ * checked after each entry, it returns the error of the limit exceeded. */
+static enum compile_error __NFA_to_DFA_worklist(
+    struct __dfa_state_registry *reg)
+{
+    enum compile_error error = COMPILE_OK;
+    struct __target_state_vector targets;
+    struct sparse_set new_states;
+    const struct byte_classes *bc = &reg->classes;
+    struct __int_vector sorted;
+    int begin[257];
+    int i_entry = 0, k, i_target, from, to;
+
+    __target_state_vector_init(&targets);
+    __int_vector_init(&sorted);
+    create_sparse_set(reg->nfa->arena->n_states, &new_states);
+
+    for ( ; i_entry < reg->entries.length && error == COMPILE_OK; i_entry++)
+    {
+        __NFA_bucket_target_states(reg, i_entry, &targets, &sorted, begin);
+        from = reg->entries.data[i_entry].dfa_state;
+
+        for (k = 0; k < bc->n_classes; k++)
+        {
+            if (begin[k] == begin[k + 1]) continue;   /* empty bucket */
+
+            /* get the epsilon closure of target states under class k, and
+             * connect the DFA state of the entry to it, classes are visited
+             * in byte order so adjacent ones going to the same state are
+             * merged into one range */
+            sparse_set_clear(&new_states);
+            for (i_target = begin[k]; i_target < begin[k + 1]; i_target++) {
+                sparse_set_add(&new_states, sorted.data[i_target]);
+            }
+            NFA_epsilon_closure(reg->nfa, &new_states);
 
-        generic_list_clear(&new_states);
+            to = __get_DFA_state_id(reg, &new_states);
+            DFA_add_transition(reg->dfa, from, to,
+                bc->first[k], byte_class_last(bc, k));
+        }
+
+        error = budget_check(reg->budget, 0, reg->entries.length, reg->base);
     }
 
-    destroy_generic_list(&trans_char);
-    destroy_generic_list(&new_states);
+    __target_state_vector_destroy(&targets);
+    destroy_sparse_set(&new_states);
+    __int_vector_destroy(&sorted);
+    return error;
 }
 
 
-/* Convert an NFA to DFA, this function returns the start state of the
- * resulting DFA */
-struct DFA_state *NFA_to_DFA(const struct NFA *nfa)
+/* Subset construction of an NFA having a terminate state for each pattern,
+ * the DFA is stored to *dfa unless a limit of the budget is exceeded */
+static enum compile_error __NFA_to_DFA(const struct NFA *nfa,
+    const int *terminates, int n_patterns,
+    const struct compile_budget *budget, struct DFA **dfa)
 {
-    int i_list = 0;
-    struct generic_list start_states;
-    struct generic_list dfa_state_entry_list;
-    struct DFA_state *dfa_start_state;
+    struct sparse_set start_states;
+    struct __dfa_state_registry reg;
+    enum compile_error error;
+
+    create_sparse_set(nfa->arena->n_states, &start_states);
+    __create_dfa_state_registry(nfa, terminates, n_patterns, budget, &reg);
+
+    /* we start from the epsilon closure of the start state, which becomes
+     * the first entry of the worklist */
+    sparse_set_add(&start_states, nfa->start);
+    NFA_epsilon_closure(nfa, &start_states);
+    reg.dfa->start = __get_DFA_state_id(&reg, &start_states);
+    error = __NFA_to_DFA_worklist(&reg);
+
+    /* mark DFA states containing terminate states of NFA as acceptable, or
+     * throw the partial DFA away */
+    if (error == COMPILE_OK)
+    {
+        __mark_acceptable_states(&reg);
+        STATS_ADD(n_DFA_states, reg.entries.length);
+        *dfa = reg.dfa;
+    }
+    else {
+        DFA_dispose(reg.dfa);
+    }
 
-    create_generic_list(struct NFA_state*, &start_states);
-    create_generic_list(struct __dfa_state_entry, &dfa_state_entry_list);
+    /* The final clean ups */
+    destroy_sparse_set(&start_states);
+    __destroy_dfa_state_registry(&reg);
+
+    return error;
+}
 
-    /* recursive: we start from the epsilon closure of the start state and
-     * storm all the way down. */
-    generic_list_push_back(&start_states, &nfa->start);
-    __NFA_epsilon_closure(&start_states);
-    __NFA_to_DFA_rec(&start_states, &dfa_state_entry_list);
+/* Convert an NFA to DFA */
+struct DFA *NFA_to_DFA(const struct NFA *nfa)
+{
+    struct DFA *dfa;
 
-    /* mark DFA states containing the terminate state of NFA as acceptable */
-    __mark_acceptable_states(nfa->terminate, &dfa_state_entry_list);
+    __NFA_to_DFA(nfa, &nfa->terminate, 1, NULL, &dfa);
+    return dfa;
+}
 
-    /* start state of generated DFA should be the first created one */
-    dfa_start_state = 
-        ((struct __dfa_state_entry*) dfa_state_entry_list.p_dat)[0].dfa_state;
+/* Convert the NFA of a set of patterns to one DFA, each state of it knows
+ * which patterns are accepted there */
+struct DFA *NFA_set_to_DFA(const struct NFA_set *set)
+{
+    struct DFA *dfa;
 
-    /* The final clean ups */
-    for ( ; i_list < dfa_state_entry_list.length; i_list++)
-    {
-        /* we need to destroy all sublists */
-        __destroy_dfa_state_entry(
-            ((struct __dfa_state_entry *) dfa_state_entry_list.p_dat) + i_list);
-    }
+    __NFA_to_DFA(&set->nfa, set->terminates, set->n_patterns, NULL, &dfa);
+    return dfa;
+}
 
-    destroy_generic_list(&start_states);
-    destroy_generic_list(&dfa_state_entry_list);
+/* Convert an NFA to DFA within the budget, the DFA is stored to *dfa on
+ * success. It returns COMPILE_OK, or the error of the limit exceeded and
+ * then nothing is left allocated. */
+enum compile_error NFA_to_DFA_within(const struct NFA *nfa,
+    const struct compile_budget *budget, struct DFA **dfa)
+{
+    return __NFA_to_DFA(nfa, &nfa->terminate, 1, budget, dfa);
+}
 
-    return dfa_start_state;
+/* Convert the NFA of a set of patterns to one DFA within the budget, just
+ * like NFA_to_DFA_within */
+enum compile_error NFA_set_to_DFA_within(const struct NFA_set *set,
+    const struct compile_budget *budget, struct DFA **dfa)
+{
+    return __NFA_to_DFA(&set->nfa, set->terminates, set->n_patterns,
+        budget, dfa);
 }
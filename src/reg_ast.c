@@ -0,0 +1,332 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "reg_ast.h"
+
+
+/* Key of a node in the index, ids of operands are less than 2^30 */
+#define __NODE_KEY(type, lhs, rhs)                                          \
+    ((uint64_t)(type) << 60 | (uint64_t)(lhs) << 30 | (uint64_t)(rhs))
+
+
+/* Get the id of the node with given fields, the node is created if there's
+ * no such node yet. No normalization is done here. */
+static int __intern(struct reg_pool *pool, int type, int lhs, int rhs)
+{
+    uint64_t key = __NODE_KEY(type, lhs, rhs);
+    struct reg_node *node;
+    int id = __reg_node_index_get(&pool->index, key);
+
+    if (id != -1)  return id;
+
+    if (pool->n_nodes == pool->_nodes_capacity)
+    {
+        pool->_nodes_capacity *= 2;   /* expand two-fold */
+        pool->nodes = (struct reg_node*)mem_realloc(pool->nodes,
+            pool->_nodes_capacity * sizeof(struct reg_node));
+    }
+
+    id = pool->n_nodes++;
+    node = REG_NODE(pool, id);
+    node->type = type;
+    node->lhs  = lhs;
+    node->rhs  = rhs;
+
+    switch (type)
+    {
+        case REG_EMPTY: case REG_SET:
+            node->is_nullable = 0; break;
+        case REG_EPSILON: case REG_STAR: case REG_ACCEPT:
+            node->is_nullable = 1; break;
+        case REG_CONCAT:
+            node->is_nullable = REG_NODE(pool, lhs)->is_nullable &&
+                REG_NODE(pool, rhs)->is_nullable;
+            break;
+        case REG_ALTERNATE:
+            node->is_nullable = REG_NODE(pool, lhs)->is_nullable ||
+                REG_NODE(pool, rhs)->is_nullable;
+            break;
+    }
+
+    __reg_node_index_put(&pool->index, key, id);
+    return id;
+}
+
+
+/* Create a pool holding only the EMPTY and EPSILON nodes */
+void create_reg_pool(struct reg_pool *pool)
+{
+    pool->_nodes_capacity = 64;
+    pool->n_nodes = 0;
+    pool->nodes = (struct reg_node*)mem_alloc(
+        pool->_nodes_capacity * sizeof(struct reg_node));
+
+    pool->_sets_capacity = 16;
+    pool->n_sets = 0;
+    pool->sets = (uint32_t*)mem_alloc(
+        pool->_sets_capacity * 8 * sizeof(uint32_t));
+
+    pool->_scratch_capacity = 64;
+    pool->_scratch = (int*)mem_alloc(pool->_scratch_capacity * sizeof(int));
+
+    __reg_node_index_init(&pool->index);
+    __reg_node_index_init(&pool->set_index);
+
+    __intern(pool, REG_EMPTY, 0, 0);      /* REG_EMPTY_NODE */
+    __intern(pool, REG_EPSILON, 0, 0);    /* REG_EPSILON_NODE */
+}
+
+/* Free every node and byte set of the pool */
+void destroy_reg_pool(struct reg_pool *pool)
+{
+    mem_free(pool->nodes);
+    mem_free(pool->sets);
+    mem_free(pool->_scratch);
+    __reg_node_index_destroy(&pool->index);
+    __reg_node_index_destroy(&pool->set_index);
+}
+
+
+/* Get the REG_SET node of the byte set in bitmap */
+static int __set_of_bitmap(struct reg_pool *pool, const uint32_t *bitmap)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;   /* FNV-1a */
+    int k, id;
+
+    for (k = 0; k < 8; k++)
+        hash = (hash ^ bitmap[k]) * 0x100000001b3ull;
+    hash >>= 1;     /* never the empty key */
+
+    /* equal bitmaps must be the same set to make equal nodes the same. A
+     * hash taken by another bitmap is probed linearly to the next one, and
+     * sets are never removed, so a bitmap is always found on the way to the
+     * first free hash. */
+    for ( ; (id = __reg_node_index_get(&pool->set_index, hash)) != -1;
+         hash = (hash + 1) & (~(uint64_t) 0 >> 1))
+    {
+        if (memcmp(pool->sets + id * 8, bitmap, 8 * sizeof(uint32_t)) == 0)
+            return __intern(pool, REG_SET, id, 0);
+    }
+
+    if (pool->n_sets == pool->_sets_capacity)
+    {
+        pool->_sets_capacity *= 2;    /* expand two-fold */
+        pool->sets = (uint32_t*)mem_realloc(pool->sets,
+            pool->_sets_capacity * 8 * sizeof(uint32_t));
+    }
+    memcpy(pool->sets + pool->n_sets * 8, bitmap, 8 * sizeof(uint32_t));
+    __reg_node_index_put(&pool->set_index, hash, pool->n_sets);
+
+    return __intern(pool, REG_SET, pool->n_sets++, 0);
+}
+
+/* Any single byte c where member[c] is non-zero */
+int reg_set(struct reg_pool *pool, const char *member)
+{
+    uint32_t bitmap[8];
+    int c;
+
+    memset(bitmap, 0, sizeof(bitmap));
+    for (c = 0; c < 256; c++)
+    {
+        if (member[c])  bitmap[c >> 5] |= (uint32_t) 1 << (c & 31);
+    }
+
+    return __set_of_bitmap(pool, bitmap);
+}
+
+/* Check if r matches nothing but what t matches, by syntax only */
+static int __is_included(const struct reg_pool *pool, int r, int t)
+{
+    const struct reg_node *x = REG_NODE(pool, r), *y = REG_NODE(pool, t);
+    int alt;
+
+    if (r == t || r == REG_EMPTY_NODE)  return 1;
+    if (r == REG_EPSILON_NODE)  return y->is_nullable;
+
+    /* split r into parts when t is a closure */
+    switch (x->type)
+    {
+        case REG_ALTERNATE:
+            return __is_included(pool, x->lhs, t) &&
+                __is_included(pool, x->rhs, t);
+        case REG_CONCAT: case REG_STAR:
+            if (y->type == REG_STAR && __is_included(pool, x->lhs, t) &&
+                (x->type == REG_STAR || __is_included(pool, x->rhs, t)))
+                return 1;
+            break;
+    }
+
+    /* r is included in a part of t */
+    switch (y->type)
+    {
+        case REG_ALTERNATE:
+            for (alt = t; REG_NODE(pool, alt)->type == REG_ALTERNATE;
+                alt = REG_NODE(pool, alt)->rhs)
+            {
+                if (__is_included(pool, r, REG_NODE(pool, alt)->lhs))
+                    return 1;
+            }
+            return __is_included(pool, r, alt);
+        case REG_CONCAT:
+            return (REG_NODE(pool, y->lhs)->is_nullable &&
+                    __is_included(pool, r, y->rhs)) ||
+                (REG_NODE(pool, y->rhs)->is_nullable &&
+                    __is_included(pool, r, y->lhs));
+        case REG_STAR:
+            return __is_included(pool, r, y->lhs);
+    }
+
+    return 0;
+}
+
+/* lhs rhs */
+int reg_concat(struct reg_pool *pool, int lhs, int rhs)
+{
+    const struct reg_node *node = REG_NODE(pool, lhs);
+    int a = node->lhs, b = node->rhs, head;
+
+    if (lhs == REG_EMPTY_NODE || rhs == REG_EMPTY_NODE)
+        return REG_EMPTY_NODE;
+    if (lhs == REG_EPSILON_NODE)  return rhs;
+    if (rhs == REG_EPSILON_NODE)  return lhs;
+
+    /* r s* = s* if r is nullable and included in s*, as in nested closures
+     * like ((a|b)*|c)*. Inclusion is checked by syntax only, so some of
+     * these are missed, which makes more DFA states but never wrong ones. */
+    head = REG_NODE(pool, rhs)->type == REG_CONCAT ?
+        REG_NODE(pool, rhs)->lhs : rhs;
+    if (REG_NODE(pool, head)->type == REG_STAR && node->is_nullable &&
+        __is_included(pool, lhs, head))
+        return rhs;
+
+    /* (a b) c = a (b c), node may be reallocated by the recursive call */
+    if (node->type == REG_CONCAT)
+        return __intern(pool, REG_CONCAT, a, reg_concat(pool, b, rhs));
+
+    return __intern(pool, REG_CONCAT, lhs, rhs);
+}
+
+/* lhs|rhs */
+int reg_alternate(struct reg_pool *pool, int lhs, int rhs)
+{
+    int ids[2];
+
+    if (lhs == rhs || rhs == REG_EMPTY_NODE)  return lhs;
+    if (lhs == REG_EMPTY_NODE)  return rhs;
+
+    ids[0] = lhs;
+    ids[1] = rhs;
+    return reg_alternate_n(pool, ids, 2);
+}
+
+/* Compare ids for qsort */
+static int __compare_ids(const void *a, const void *b)
+{
+    int x = *(const int*) a, y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+/* Make an alternation of n nodes */
+int reg_alternate_n(struct reg_pool *pool, const int *ids, int n)
+{
+    const struct reg_node *node;
+    uint32_t bitmap[8];
+    int i, k, n_alts = 0, n_sets = 0, id, ret = REG_EMPTY_NODE;
+
+    /* flatten the alternatives into the scratch space */
+    for (i = 0; i < n; i++)
+    {
+        for (id = ids[i]; ; id = node->rhs)
+        {
+            if (n_alts == pool->_scratch_capacity)
+            {
+                pool->_scratch_capacity *= 2;
+                pool->_scratch = (int*)mem_realloc(pool->_scratch,
+                    pool->_scratch_capacity * sizeof(int));
+            }
+
+            node = REG_NODE(pool, id);
+            if (node->type != REG_ALTERNATE) {
+                pool->_scratch[n_alts++] = id; break;
+            }
+            pool->_scratch[n_alts++] = node->lhs;
+        }
+    }
+
+    /* byte sets are merged into one, as [ab]|[bc] = [abc] */
+    memset(bitmap, 0, sizeof(bitmap));
+    for (i = k = 0; i < n_alts; i++)
+    {
+        node = REG_NODE(pool, pool->_scratch[i]);
+        if (node->type != REG_SET) {
+            pool->_scratch[k++] = pool->_scratch[i]; continue;
+        }
+        for (id = 0; id < 8; id++)
+            bitmap[id] |= pool->sets[node->lhs * 8 + id];
+        ret = pool->_scratch[i];
+        n_sets++;
+    }
+    if (n_sets > 1)  ret = __set_of_bitmap(pool, bitmap);
+    if (n_sets > 0)  pool->_scratch[k++] = ret;
+    n_alts = k;
+
+    /* sort them, and drop the duplicates and EMPTY */
+    qsort(pool->_scratch, n_alts, sizeof(int), __compare_ids);
+    for (i = k = 0; i < n_alts; i++)
+    {
+        id = pool->_scratch[i];
+        if (id != REG_EMPTY_NODE && (k == 0 || pool->_scratch[k - 1] != id))
+            pool->_scratch[k++] = id;
+    }
+
+    if (k == 0)  return REG_EMPTY_NODE;
+    for (ret = pool->_scratch[--k]; k > 0; )
+        ret = __intern(pool, REG_ALTERNATE, pool->_scratch[--k], ret);
+
+    return ret;
+}
+
+/* node* */
+int reg_star(struct reg_pool *pool, int node)
+{
+    int *alts, n_alts = 1, id, alt, is_last, ret;
+
+    if (node == REG_EMPTY_NODE || node == REG_EPSILON_NODE)
+        return REG_EPSILON_NODE;
+    if (REG_NODE(pool, node)->type == REG_STAR)  return node;
+    if (REG_NODE(pool, node)->type != REG_ALTERNATE)
+        return __intern(pool, REG_STAR, node, 0);
+
+    /* (EPSILON|r|s*)* = (r|s)*, since the closure matches EPSILON anyway
+     * and s* is included in (r|s)* */
+    for (id = node; REG_NODE(pool, id)->type == REG_ALTERNATE;
+        id = REG_NODE(pool, id)->rhs)
+        n_alts++;
+    alts = (int*)mem_alloc(n_alts * sizeof(int));
+
+    for (n_alts = 0, id = node; ; id = REG_NODE(pool, id)->rhs)
+    {
+        is_last = REG_NODE(pool, id)->type != REG_ALTERNATE;
+        alt = is_last ? id : REG_NODE(pool, id)->lhs;
+
+        if (REG_NODE(pool, alt)->type == REG_STAR)
+            alt = REG_NODE(pool, alt)->lhs;
+        alts[n_alts++] = alt == REG_EPSILON_NODE ? REG_EMPTY_NODE : alt;
+
+        if (is_last)  break;
+    }
+    ret = reg_alternate_n(pool, alts, n_alts);
+    mem_free(alts);
+
+    /* stripping the closures may flatten more alternatives out */
+    if (ret != node)  return reg_star(pool, ret);
+    return __intern(pool, REG_STAR, node, 0);
+}
+
+/* End of the pattern numbered pattern */
+int reg_accept(struct reg_pool *pool, int pattern)
+{
+    return __intern(pool, REG_ACCEPT, pattern, 0);
+}
@@ -0,0 +1,128 @@
+#ifndef __REG_AST_HEADER__
+#define __REG_AST_HEADER__
+
+
+#include <stdint.h>
+
+#include "hset.h"
+#include "budget.h"
+
+
+/* Types of nodes in the abstract syntax tree of regexps */
+enum reg_node_type
+{
+    REG_EMPTY,          /* matches nothing */
+    REG_EPSILON,        /* matches the empty string only */
+    REG_SET,            /* matches any single byte in a set */
+    REG_CONCAT,         /* lhs followed by rhs */
+    REG_ALTERNATE,      /* lhs or rhs */
+    REG_STAR,           /* zero or more lhs */
+    REG_ACCEPT          /* matches the empty string, and marks the end of
+                         * pattern numbered lhs in a set of patterns */
+};
+
+/* Node of the regexp AST. Nodes are hash-consed: structurally equal nodes
+ * are the same node, so nodes can be compared by their ids. Smart
+ * constructors keep every node in a normal form:
+
+       concatenations are nested to the right, and EMPTY r = r EMPTY = EMPTY,
+       EPSILON r = r EPSILON = r, and r s* = s* if r is nullable and made of
+       s* itself, s or alternatives of s
+
+       alternations are nested to the right with their alternatives in
+       ascending order of ids and no duplicates, EMPTY|r = r, and byte sets
+       among the alternatives are merged into one
+
+       (r*)* = r*, EPSILON* = EMPTY* = EPSILON, (EPSILON|r|s*)* = (r|s)*
+
+ * so regexps equal by these rules are the same node too. */
+struct reg_node
+{
+    int type;           /* enum reg_node_type */
+    int lhs, rhs;       /* ids of the operands, lhs is the set id of REG_SET
+                         * and the pattern of REG_ACCEPT */
+    int is_nullable;    /* if the node matches the empty string */
+};
+
+/* Index from the fields of a node to its id */
+DEFINE_HASH_MAP(__reg_node_index, uint64_t, ~(uint64_t) 0, hash_uint64)
+
+/* Pool of the nodes of regexp ASTs, which owns every node and byte set */
+struct reg_pool
+{
+    struct reg_node *nodes;         /* nodes[id] is the node numbered id */
+    int n_nodes;
+    int _nodes_capacity;
+
+    uint32_t *sets;                 /* bitmap of the i-th byte set is
+                                     * sets[i * 8 .. i * 8 + 7] */
+    int n_sets;
+    int _sets_capacity;
+
+    struct __reg_node_index index;      /* nodes by their fields */
+    struct __reg_node_index set_index;  /* sets by the hash of bitmaps */
+
+    int *_scratch;                  /* scratch space of alternations */
+    int _scratch_capacity;
+};
+
+/* Ids of the nodes every pool has */
+#define REG_EMPTY_NODE    0
+#define REG_EPSILON_NODE  1
+
+/* Get the address of node numbered id in the pool, the address is
+ * invalidated once more nodes are created */
+#define REG_NODE(pool, id)  ((pool)->nodes + (id))
+
+/* Check if byte c is a member of the byte set of a REG_SET node */
+#define REG_SET_CONTAINS(pool, node, c)                                     \
+    ((pool)->sets[(node)->lhs * 8 + ((c) >> 5)] >> ((c) & 31) & 1)
+
+
+/* Create a pool holding only the EMPTY and EPSILON nodes */
+void create_reg_pool(struct reg_pool *pool);
+
+/* Free every node and byte set of the pool */
+void destroy_reg_pool(struct reg_pool *pool);
+
+
+/* Smart constructors, they return the id of the node in normal form */
+
+/* Any single byte c where member[c] is non-zero */
+int reg_set(struct reg_pool *pool, const char *member);
+
+int reg_concat(struct reg_pool *pool, int lhs, int rhs);       /* lhs rhs */
+int reg_alternate(struct reg_pool *pool, int lhs, int rhs);    /* lhs|rhs */
+int reg_star(struct reg_pool *pool, int node);                 /* node*   */
+int reg_accept(struct reg_pool *pool, int pattern);      /* end of pattern */
+
+/* Make an alternation of the n nodes in ids[] */
+int reg_alternate_n(struct reg_pool *pool, const int *ids, int n);
+
+
+/* Parse a regexp to an AST in the pool and return the id of its root. The
+ * same LL parser builds both the ASTs and the Thompson NFAs, so they accept
+ * the same syntax. */
+int reg_to_AST(const char *regexp, struct reg_pool *pool);
+
+/* Parse a set of regexps to one AST: an alternation of every regexp
+ * followed by REG_ACCEPT of its number */
+int regs_to_AST(const char *const *regexps, int n_regexps,
+    struct reg_pool *pool);
+
+/* Parse a regexp to an AST in the pool within the budget, whose byte limit
+ * is the only one that applies, the id of its root is stored to *root on
+ * success. It returns COMPILE_OK, or the error found. Nodes made before the
+ * error are left in the pool, and go away with it. */
+enum compile_error reg_to_AST_within(const char *regexp,
+    const struct compile_budget *budget, struct reg_pool *pool, int *root);
+
+/* Parse a set of regexps to one AST within the budget, just like
+ * reg_to_AST_within, a set of no regexps is COMPILE_NO_PATTERNS */
+enum compile_error regs_to_AST_within(const char *const *regexps,
+    int n_regexps, const struct compile_budget *budget,
+    struct reg_pool *pool, int *root);
+
+
+
+#endif /* __REG_AST_HEADER__ */
@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "vec.h"
+#include "stats.h"
+#include "reg_ast.h"
+#include "dfa.h"
+
+
+DEFINE_VECTOR(__int_vector, int)
+
+/* Brzozowski derivatives. The derivative of a regexp r by byte c matches the
+ * strings s where cs is matched by r, so a DFA state can simply be a regexp:
+ * the transition of state r on c goes to the derivative of r by c, and r is
+ * acceptable if it is nullable. Derivatives are taken in normal form, which
+ * makes them finitely many (up to the normalization rules), and equal
+ * derivatives are the same node since nodes are hash-consed. No epsilon
+ * closure or set of NFA states is ever computed. */
+struct __derivative_context
+{
+    struct reg_pool *pool;
+    int c;                      /* byte being derived by */
+
+    int *memo;                  /* memo[id] is the derivative of node id */
+    int *memo_stamp;            /* memo[id] is valid if memo_stamp[id] is
+                                 * the current stamp */
+    int memo_capacity;
+    int stamp;
+
+    struct __int_vector alternatives;   /* stack of derivatives of
+                                         * alternatives */
+};
+
+
+/* Get the derivative of node id by ctx->c */
+static int __derive(struct __derivative_context *ctx, int id)
+{
+    struct reg_pool *pool = ctx->pool;
+    const struct reg_node *node = REG_NODE(pool, id);
+    int type = node->type, lhs = node->lhs, rhs = node->rhs;
+    int ret, base, alt;
+
+    if (ctx->memo_stamp[id] == ctx->stamp)  return ctx->memo[id];
+
+    /* nodes may be reallocated by constructors, so fields are copied above
+     * instead of being accessed through node */
+    switch (type)
+    {
+        case REG_SET:           /* c if c in set */
+            ret = REG_SET_CONTAINS(pool, node, ctx->c) ?
+                REG_EPSILON_NODE : REG_EMPTY_NODE;
+            break;
+
+        case REG_CONCAT:        /* d(l) r | d(r) if l is nullable */
+            ret = reg_concat(pool, __derive(ctx, lhs), rhs);
+            if (REG_NODE(pool, lhs)->is_nullable)
+                ret = reg_alternate(pool, ret, __derive(ctx, rhs));
+            break;
+
+        case REG_ALTERNATE:     /* d(a) | d(b) | ... */
+            base = ctx->alternatives.length;
+            for (alt = id; ; alt = rhs)
+            {
+                node = REG_NODE(pool, alt);
+                if (node->type != REG_ALTERNATE) {
+                    __int_vector_push(&ctx->alternatives, __derive(ctx, alt));
+                    break;
+                }
+                lhs = node->lhs;
+                rhs = node->rhs;
+                __int_vector_push(&ctx->alternatives, __derive(ctx, lhs));
+            }
+            ret = reg_alternate_n(pool, ctx->alternatives.data + base,
+                ctx->alternatives.length - base);
+            ctx->alternatives.length = base;
+            break;
+
+        case REG_STAR:          /* d(r) r* */
+            ret = reg_concat(pool, __derive(ctx, lhs), id);
+            break;
+
+        default:                /* EMPTY, EPSILON and ACCEPT */
+            ret = REG_EMPTY_NODE;
+    }
+
+    ctx->memo[id] = ret;
+    ctx->memo_stamp[id] = ctx->stamp;
+    return ret;
+}
+
+/* Start taking derivatives by byte c, the memo is cleared */
+static void __derive_by(struct __derivative_context *ctx, int c)
+{
+    int n_nodes = ctx->pool->n_nodes;
+
+    ctx->c = c;
+    if (n_nodes > ctx->memo_capacity)
+    {
+        while (n_nodes > ctx->memo_capacity)  ctx->memo_capacity *= 2;
+        ctx->memo = (int*)mem_realloc(ctx->memo,
+            ctx->memo_capacity * sizeof(int));
+        ctx->memo_stamp = (int*)mem_realloc(ctx->memo_stamp,
+            ctx->memo_capacity * sizeof(int));
+        memset(ctx->memo_stamp, 0, ctx->memo_capacity * sizeof(int));
+        ctx->stamp = 0;
+    }
+    ctx->stamp++;
+}
+
+/* Add the patterns whose REG_ACCEPT node can be reached by the empty string
+ * from node id to the vector */
+static void __accepted_patterns(const struct reg_pool *pool, int id,
+    struct __int_vector *patterns)
+{
+    const struct reg_node *node = REG_NODE(pool, id);
+
+    for ( ; node->type == REG_ALTERNATE; node = REG_NODE(pool, node->rhs))
+        __accepted_patterns(pool, node->lhs, patterns);
+
+    if (node->type == REG_ACCEPT)
+        __int_vector_push(patterns, node->lhs);
+    else if (node->type == REG_CONCAT &&
+        REG_NODE(pool, node->lhs)->is_nullable)
+        __accepted_patterns(pool, node->rhs, patterns);
+}
+
+/* Split bytes into classes that every byte set in the pool either contains
+ * as a whole or doesn't intersect, bytes of a class have the same derivatives
+ * then */
+static void __set_byte_classes(const struct reg_pool *pool,
+    struct byte_classes *bc)
+{
+    const uint32_t *bitmap;
+    int i, lo, hi;
+
+    byte_classes_init(bc);
+    for (i = 0; i < pool->n_sets; i++)
+    {
+        bitmap = pool->sets + i * 8;
+        for (lo = 0; lo < 256; lo = hi + 1)
+        {
+            hi = lo;
+            if (!(bitmap[lo >> 5] >> (lo & 31) & 1))  continue;
+            while (hi < 255 && (bitmap[(hi + 1) >> 5] >> ((hi + 1) & 31) & 1))
+                hi++;
+            byte_classes_add_range(bc, lo, hi);
+        }
+    }
+    byte_classes_finish(bc);
+}
+
+/* Compare pattern numbers for qsort */
+static int __compare_patterns(const void *a, const void *b)
+{
+    int x = *(const int*) a, y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+/* Build the DFA of the AST rooted at root by derivatives, the AST is made by
+ * regs_to_AST */
+struct DFA *AST_to_DFA(struct reg_pool *pool, int root)
+{
+    struct DFA *dfa;
+
+    AST_to_DFA_within(pool, root, NULL, &dfa);
+    return dfa;
+}
+
+/* Build the DFA of the AST by derivatives within the budget, the DFA is
+ * stored to *dfa on success. It returns COMPILE_OK, or the error of the
+ * limit exceeded and then nothing is left allocated. */
+enum compile_error AST_to_DFA_within(struct reg_pool *pool, int root,
+    const struct compile_budget *budget, struct DFA **dfa_out)
+{
+    struct DFA *dfa = create_DFA();
+    struct __derivative_context ctx;
+    struct __int_vector nodes, patterns;
+    struct byte_classes bc;
+    enum compile_error error = COMPILE_OK;
+    size_t base = budget_bytes_base();
+    int *state_of, n_state_of, i, k, from, to, target;
+
+    __set_byte_classes(pool, &bc);
+
+    ctx.pool = pool;
+    ctx.memo_capacity = 64;
+    ctx.memo = (int*)mem_alloc(ctx.memo_capacity * sizeof(int));
+    ctx.memo_stamp = (int*)mem_calloc(ctx.memo_capacity, sizeof(int));
+    ctx.stamp = 0;
+    __int_vector_init(&ctx.alternatives);
+
+    /* nodes.data[i] is the node of DFA state i, and state_of[] maps nodes
+     * back to DFA states */
+    __int_vector_init(&nodes);
+    __int_vector_init(&patterns);
+    n_state_of = pool->n_nodes;
+    state_of = (int*)mem_alloc(n_state_of * sizeof(int));
+    memset(state_of, -1, n_state_of * sizeof(int));
+
+    dfa->start = alloc_DFA_state(dfa);
+    state_of[root] = dfa->start;
+    __int_vector_push(&nodes, root);
+
+    for (from = 0; from < nodes.length; from++)
+    {
+        /* states are added as they are found, so the budget is checked
+         * before each of them is derived */
+        if ((error = budget_check(budget, 0, dfa->n_states, base)) !=
+            COMPILE_OK)
+            break;
+
+        __int_vector_clear(&patterns);
+        __accepted_patterns(pool, nodes.data[from], &patterns);
+        qsort(patterns.data, patterns.length, sizeof(int),
+            __compare_patterns);
+        for (i = 0; i < patterns.length; i++)
+        {
+            if (i == 0 || patterns.data[i] != patterns.data[i - 1])
+                DFA_make_acceptable(dfa, from, patterns.data[i]);
+        }
+
+        for (k = 0; k < bc.n_classes; k++)
+        {
+            __derive_by(&ctx, bc.first[k]);
+            target = __derive(&ctx, nodes.data[from]);
+            if (target == REG_EMPTY_NODE)  continue;   /* dead */
+
+            if (target >= n_state_of)
+            {
+                state_of = (int*)mem_realloc(state_of,
+                    pool->n_nodes * sizeof(int));
+                memset(state_of + n_state_of, -1,
+                    (pool->n_nodes - n_state_of) * sizeof(int));
+                n_state_of = pool->n_nodes;
+            }
+            if ( (to = state_of[target]) == -1)
+            {
+                to = state_of[target] = alloc_DFA_state(dfa);
+                __int_vector_push(&nodes, target);
+            }
+
+            DFA_add_transition(dfa, from, to,
+                bc.first[k], byte_class_last(&bc, k));
+        }
+    }
+    STATS_ADD(n_DFA_states, dfa->n_states);
+
+    mem_free(state_of);
+    mem_free(ctx.memo);
+    mem_free(ctx.memo_stamp);
+    __int_vector_destroy(&ctx.alternatives);
+    __int_vector_destroy(&nodes);
+    __int_vector_destroy(&patterns);
+
+    if (error != COMPILE_OK) {
+        DFA_dispose(dfa); return error;
+    }
+    *dfa_out = dfa;
+    return COMPILE_OK;
+}
+
+/* Convert a set of regexps to one DFA by derivatives */
+struct DFA *regs_to_DFA_by_derivatives(const char *const *regexps,
+    int n_regexps)
+{
+    struct reg_pool pool;
+    struct DFA *dfa;
+
+    create_reg_pool(&pool);
+    dfa = AST_to_DFA(&pool, regs_to_AST(regexps, n_regexps, &pool));
+    destroy_reg_pool(&pool);
+
+    return dfa;
+}
+
+/* Convert a set of regexps to one DFA by derivatives within the budget, the
+ * DFA is stored to *dfa on success. It returns COMPILE_OK, or the error
+ * found and then nothing is left allocated. */
+enum compile_error regs_to_DFA_by_derivatives_within(
+    const char *const *regexps, int n_regexps,
+    const struct compile_budget *budget, struct DFA **dfa)
+{
+    struct reg_pool pool;
+    enum compile_error error;
+    int root;
+
+    create_reg_pool(&pool);
+    error = regs_to_AST_within(regexps, n_regexps, budget, &pool, &root);
+    if (error == COMPILE_OK)
+        error = AST_to_DFA_within(&pool, root, budget, dfa);
+    destroy_reg_pool(&pool);
+
+    return error;
+}
@@ -1,116 +1,643 @@
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <stdio.h>
 
+#include "mem.h"
+#include "vec.h"
 #include "nfa.h"
+#include "reg_ast.h"
+#include "budget.h"
+#include "stats.h"
+
+
+DEFINE_VECTOR(__int_vector, int)
+
+/* The parser builds either a Thompson NFA or an AST of the regexp, it builds
+ * an AST if arena is NULL. Once an error is found, each parsing routine
+ * returns at once and the fragments returned are garbage. */
+struct __LL_parser
+{
+    struct NFA_arena *arena;    /* NFA fragments are allocated from */
+    int is_reversed;            /* if operands of concatenations are swapped */
+
+    struct reg_pool *pool;      /* AST nodes are allocated from */
+    struct __int_vector pending;    /* stack of nodes to be concatenated */
+
+    const struct compile_budget *budget;    /* limits of the NFA, or NULL */
+    size_t base;                /* bytes in use when parsing started */
+    enum compile_error error;   /* the first error found */
+};
+
+/* Fragment of the regexp parsed so far. It is an NFA, or an AST node
+ * followed by the topmost n_pending nodes of the pending stack: terms of a
+ * long concatenation are collected and then concatenated from the right,
+ * since concatenations in the AST are nested to the right. */
+struct __LL_fragment
+{
+    struct NFA nfa;
+    int node;
+    int n_pending;
+};
 
 
 /* LL(1) parser modules */
-static struct NFA __LL_expression(char **statement);
-static struct NFA __LL_term(char **statement);
-static struct NFA __LL_primary(char **statement);
+static struct __LL_fragment __LL_expression(
+    char **statement, struct __LL_parser *parser);
+static struct __LL_fragment __LL_term(
+    char **statement, struct __LL_parser *parser);
+static struct __LL_fragment __LL_primary(
+    char **statement, struct __LL_parser *parser);
+static struct __LL_fragment __LL_bracket(
+    char **statement, struct __LL_parser *parser);
+
+
+/* Check if a primary may begin with ch, every character other than the
+ * operators stands for itself */
+static int __starts_primary(char ch)
+{
+    return ch != '\0' && strchr("|)*+?", ch) == NULL;
+}
+
+/* Add members of the escaped class \ch (\d, \w, \s or their negations \D,
+ * \W, \S) to member[], this function returns 0 if \ch is not a class */
+static int __add_escaped_class(char ch, char *member)
+{
+    int c = 0, is_member, is_negated = isupper((unsigned char) ch);
+
+    ch = (char) tolower((unsigned char) ch);
+    if (ch != 'd' && ch != 'w' && ch != 's')  return 0;
+
+    for ( ; c < 256; c++)
+    {
+        if (ch == 'd')       is_member = isdigit(c) != 0;
+        else if (ch == 'w')  is_member = isalnum(c) || c == '_';
+        else                 is_member = isspace(c) != 0;
+
+        if (is_member != is_negated)  member[c] = 1;
+    }
+
+    return 1;
+}
+
+/* Record the first error found by the parser */
+static void __LL_fail(struct __LL_parser *parser, enum compile_error error)
+{
+    if (parser->error == COMPILE_OK)  parser->error = error;
+}
+
+/* Get the byte denoted by the escape sequence \ch, a backslash in front of a
+ * punctuation makes it lose its special meaning */
+static int __escaped_byte(char ch, struct __LL_parser *parser)
+{
+    switch (ch)
+    {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+    }
+
+    if (ch == '\0' || isalnum((unsigned char) ch)) {
+        __LL_fail(parser, COMPILE_BAD_ESCAPE); return 0;
+    }
+
+    return (unsigned char) ch;
+}
+
+/* Make a fragment of a single byte class, member[c] is non-zero if byte c
+ * is in the class */
+static struct __LL_fragment __LL_class(
+    struct __LL_parser *parser, const char *member)
+{
+    struct __LL_fragment ret;
+
+    memset(&ret, 0, sizeof(ret));
+    if (parser->arena != NULL)
+        ret.nfa = NFA_create_class(parser->arena, member);
+    else
+        ret.node = reg_set(parser->pool, member);
+
+    return ret;
+}
+
+/* Make a fragment of a single byte */
+static struct __LL_fragment __LL_atomic(struct __LL_parser *parser, char c)
+{
+    struct __LL_fragment ret;
+    char member[256];
+
+    if (parser->arena == NULL)
+    {
+        memset(member, 0, sizeof(member));
+        member[(unsigned char) c] = 1;
+        return __LL_class(parser, member);
+    }
+
+    memset(&ret, 0, sizeof(ret));
+    ret.nfa = NFA_create_atomic(parser->arena, c);
+    return ret;
+}
+
+/* Concatenate the pending nodes of an AST fragment to its node */
+static void __LL_settle(
+    struct __LL_parser *parser, struct __LL_fragment *fragment)
+{
+    int rhs = REG_EPSILON_NODE;
+
+    if (parser->arena != NULL)  return;
+
+    for ( ; fragment->n_pending > 0; fragment->n_pending--)
+    {
+        rhs = reg_concat(parser->pool,
+            __int_vector_pop(&parser->pending), rhs);
+    }
+    fragment->node = reg_concat(parser->pool, fragment->node, rhs);
+}
+
+/* Concatenate the term rhs to the fragment lhs */
+static void __LL_concatenate(struct __LL_parser *parser,
+    struct __LL_fragment *lhs, const struct __LL_fragment *rhs)
+{
+    if (parser->arena == NULL) {
+        __int_vector_push(&parser->pending, rhs->node);
+        lhs->n_pending++;
+    }
+    else if (parser->is_reversed) {
+        lhs->nfa = NFA_concatenate(&rhs->nfa, &lhs->nfa);
+    }
+    else {
+        lhs->nfa = NFA_concatenate(&lhs->nfa, &rhs->nfa);
+    }
+}
+
+/* Alternate the fragment lhs with the term rhs */
+static void __LL_alternate(struct __LL_parser *parser,
+    struct __LL_fragment *lhs, const struct __LL_fragment *rhs)
+{
+    if (parser->arena == NULL) {
+        __LL_settle(parser, lhs);
+        lhs->node = reg_alternate(parser->pool, lhs->node, rhs->node);
+    }
+    else {
+        lhs->nfa = NFA_alternate(&lhs->nfa, &rhs->nfa);
+    }
+}
 
 /* expression:
        expression term
        expression | term
        term                */
-static struct NFA __LL_expression(char **statement)
+static struct __LL_fragment __LL_expression(
+    char **statement, struct __LL_parser *parser)
 {
-    struct NFA lhs = __LL_term(statement);
-    struct NFA ret, rhs;
+    struct __LL_fragment lhs = __LL_term(statement, parser);
+    struct __LL_fragment rhs;
     char ch;
 
-    for ( ; ; lhs = ret)
+    for ( ; ; )
     {
+        /* the NFA or the AST grows by a few nodes with each term, so the
+         * budget is checked as it grows */
+        if (parser->error == COMPILE_OK)
+        {
+            parser->error = budget_check(parser->budget,
+                parser->arena != NULL ? parser->arena->n_states : 0, 0,
+                parser->base);
+        }
+        if (parser->error != COMPILE_OK)  return lhs;
+
         ch = **statement;
 
-        if (isalnum(ch) || ch == '(') { /* expression term */
-            rhs = __LL_term(statement);
-            ret = NFA_concatenate(&lhs, &rhs);
+        if (__starts_primary(ch)) {     /* expression term */
+            rhs = __LL_term(statement, parser);
+            if (parser->error != COMPILE_OK)  return lhs;
+            __LL_concatenate(parser, &lhs, &rhs);
         }
         else if (ch == '|') {           /* expression | term */
             *statement += 1;            /* eat '|' */
-            rhs = __LL_term(statement);
-            ret = NFA_alternate(&lhs, &rhs);
+            rhs = __LL_term(statement, parser);
+            if (parser->error != COMPILE_OK)  return lhs;
+            __LL_alternate(parser, &lhs, &rhs);
         }
         else {
+            __LL_settle(parser, &lhs);
             return lhs;                 /* term  */
         }
     }
-
-    return ret;   /* we should never reach here */
 }
 
 /* term:
        term *
        term +
        primary    */
-static struct NFA __LL_term(char **statement)
+static struct __LL_fragment __LL_term(
+    char **statement, struct __LL_parser *parser)
 {
-    struct NFA lhs = __LL_primary(statement);
-    struct NFA ret;
+    struct __LL_fragment lhs = __LL_primary(statement, parser);
+    struct __LL_fragment ret = lhs;
+    struct reg_pool *pool = parser->pool;
     char ch = **statement;
 
+    if (parser->error != COMPILE_OK)  return ret;
+
     if (ch == '*') {            /* term * */
-        ret = NFA_Kleene_closure(&lhs);
+        if (parser->arena != NULL)
+            ret.nfa = NFA_Kleene_closure(&lhs.nfa);
+        else
+            ret.node = reg_star(pool, lhs.node);
         *statement += 1;        /* eat the Kleene star */
     }
     else if (ch == '+') {       /* term + */
-        ret = NFA_positive_closure(&lhs);
+        if (parser->arena != NULL)
+            ret.nfa = NFA_positive_closure(&lhs.nfa);
+        else
+            ret.node = reg_concat(pool, lhs.node, reg_star(pool, lhs.node));
         *statement += 1;        /* eat the positive closure */
     }
     else if (ch == '?') {       /* term ? */
-        ret = NFA_optional(&lhs);
+        if (parser->arena != NULL)
+            ret.nfa = NFA_optional(&lhs.nfa);
+        else
+            ret.node = reg_alternate(pool, lhs.node, REG_EPSILON_NODE);
         *statement += 1;        /* eat the optional (question) mark */
     }
-    else {
-        return lhs;             /* primary */
-    }
 
-    return ret;
+    return ret;                 /* primary */
 }
 
 /* primary:
-       ALNUM
+       CHAR
+       \ CHAR
+       .
+       [ bracket ]
        ( expression )    */
-static struct NFA __LL_primary(char **statement)
+static struct __LL_fragment __LL_primary(
+    char **statement, struct __LL_parser *parser)
 {
-    struct NFA ret;
+    struct __LL_fragment ret;
+    char member[256];
     char ch = **statement;
+    int c;
 
-    if (isalnum(ch)) {          /* ALNUM */
-        ret = NFA_create_atomic(ch);
-        *statement += 1;        /* eat the character */
+    memset(&ret, 0, sizeof(ret));
+    if (ch == '\\')             /* \ CHAR */
+    {
+        *statement += 1;        /* eat '\' */
+        ch = **statement;
+
+        memset(member, 0, sizeof(member));
+        if (__add_escaped_class(ch, member)) {
+            ret = __LL_class(parser, member);
+        }
+        else
+        {
+            c = __escaped_byte(ch, parser);
+            if (parser->error != COMPILE_OK)  return ret;   /* ch is bad */
+            ret = __LL_atomic(parser, (char) c);
+        }
+        *statement += 1;        /* eat the escaped character */
+    }
+    else if (ch == '.')         /* . */
+    {
+        memset(member, 1, sizeof(member));
+        member['\n'] = 0;       /* any byte but newline */
+        ret = __LL_class(parser, member);
+        *statement += 1;        /* eat '.' */
+    }
+    else if (ch == '[') {       /* [ bracket ] */
+        ret = __LL_bracket(statement, parser);
     }
     else if (ch == '(')         /* ( expression ) */
     {
         *statement += 1;        /* eat '(' */
-        ret = __LL_expression(statement);
+        ret = __LL_expression(statement, parser);
+        if (parser->error != COMPILE_OK)  return ret;
         if (**statement != ')') {
-            fprintf(stderr, "no matching ')' found\n"); exit(-1);
+            __LL_fail(parser, COMPILE_UNMATCHED_PAREN); return ret;
         }
         *statement +=1;         /* eat ')' */
     }
+    else if (__starts_primary(ch)) {    /* CHAR */
+        ret = __LL_atomic(parser, ch);
+        *statement += 1;        /* eat the character */
+    }
     else {
-        fprintf(stderr, "unrecognized character \"%c\"\n", ch);
-        exit(-1);
+        __LL_fail(parser, COMPILE_UNEXPECTED_CHAR);
     }
 
     return ret;
 }
 
-/* LL parser driver/interface */
-struct NFA reg_to_NFA(const char *regexp)
+/* Get a member byte of a bracket expression, which is either a character or
+ * an escape sequence */
+static int __bracket_byte(char **statement, struct __LL_parser *parser)
+{
+    int c = (unsigned char) **statement;
+
+    if (c == '\\')
+    {
+        *statement += 1;    /* eat '\' */
+        c = __escaped_byte(**statement, parser);
+        if (parser->error != COMPILE_OK)  return c;     /* c may be '\0' */
+    }
+    *statement += 1;        /* eat the character */
+
+    return c;
+}
+
+/* bracket:
+       [ ITEMS ]
+       [ ^ ITEMS ]
+
+   where each item is a character, an escape sequence or a range like a-z. A
+   ']' right after the opening bracket and a '-' at either end are taken
+   literally. */
+static struct __LL_fragment __LL_bracket(
+    char **statement, struct __LL_parser *parser)
+{
+    struct __LL_fragment ret;
+    char member[256];
+    int is_negated = 0, is_first = 1, lo, hi, c;
+
+    memset(&ret, 0, sizeof(ret));
+    memset(member, 0, sizeof(member));
+    *statement += 1;            /* eat '[' */
+    if (**statement == '^') {
+        is_negated = 1;
+        *statement += 1;        /* eat '^' */
+    }
+
+    for ( ; **statement != ']' || is_first; is_first = 0)
+    {
+        if (**statement == '\0') {
+            __LL_fail(parser, COMPILE_UNMATCHED_BRACKET); return ret;
+        }
+
+        /* escaped classes like \d are merged as a whole */
+        if (**statement == '\\' &&
+            __add_escaped_class((*statement)[1], member))
+        {
+            *statement += 2;    /* eat the escaped class */
+            continue;
+        }
+
+        lo = hi = __bracket_byte(statement, parser);
+        if (**statement == '-' &&
+            (*statement)[1] != ']' && (*statement)[1] != '\0')
+        {
+            *statement += 1;    /* eat '-' */
+            hi = __bracket_byte(statement, parser);
+            if (hi < lo)  __LL_fail(parser, COMPILE_BAD_RANGE);
+        }
+        if (parser->error != COMPILE_OK)  return ret;
+
+        for (c = lo; c <= hi; c++)  member[c] = 1;
+    }
+    *statement += 1;            /* eat ']' */
+
+    if (is_negated)
+    {
+        for (c = 0; c < 256; c++)  member[c] = !member[c];
+    }
+
+    return __LL_class(parser, member);
+}
+
+/* Parse a whole regexp with the parser, parser->error tells if it's done */
+static struct __LL_fragment __LL_parse_with(
+    const char *regexp, struct __LL_parser *parser)
 {
     char **cur = (char **)(&regexp);
-    struct NFA nfa = __LL_expression(cur); /* creating NFA for regexp is just
-                                            * like assembling building blocks
-                                            * as what the regexp says */
+    struct __LL_fragment ret = __LL_expression(cur, parser);
+
+    if (parser->error == COMPILE_OK && **cur != '\0')
+        __LL_fail(parser, COMPILE_UNEXPECTED_CHAR);
+
+    return ret;
+}
+
+/* Parse a whole regexp, the NFA is allocated from specified arena. If
+ * is_reversed is non-zero, operands of every concatenation are swapped while
+ * the other Thompson fragments are kept as they are, so the NFA recognizes
+ * the reversal of the strings the regexp matches. Bytes allocated are
+ * counted from base. */
+static enum compile_error __LL_parse(const char *regexp,
+    struct NFA_arena *arena, int is_reversed,
+    const struct compile_budget *budget, size_t base, struct NFA *nfa)
+{
+    struct __LL_parser parser;
+
+    /* creating NFA for regexp is just like assembling building blocks as what
+     * the regexp says, all blocks are allocated from one arena */
+    parser.arena = arena;
+    parser.is_reversed = is_reversed;
+    parser.pool = NULL;
+    parser.budget = budget;
+    parser.base = base;
+    parser.error = COMPILE_OK;
+
+    *nfa = __LL_parse_with(regexp, &parser).nfa;
+    return parser.error;
+}
+
+/* Print the error and quit, compiling routines without a budget fail only on
+ * malformed regexps */
+static void __exit_on_error(enum compile_error error)
+{
+    if (error != COMPILE_OK) {
+        fprintf(stderr, "%s\n", compile_error_string(error)); exit(-1);
+    }
+}
+
+/* Parse a regexp to an NFA of its own arena within the budget */
+static enum compile_error __reg_to_NFA(const char *regexp, int is_reversed,
+    const struct compile_budget *budget, struct NFA *nfa)
+{
+    struct NFA_arena *arena = create_NFA_arena();
+    enum compile_error error;
+
+    error = __LL_parse(regexp, arena, is_reversed, budget,
+        budget_bytes_base(), nfa);
+    if (error != COMPILE_OK) {
+        destroy_NFA_arena(arena); return error;
+    }
+
+    STATS_ADD(n_NFA_states, arena->n_states);
+    return COMPILE_OK;
+}
+
+/* Compile basic regular expression to NFA within the budget, the NFA is
+ * stored to *nfa on success. It returns COMPILE_OK, or the error found and
+ * then nothing is left allocated. */
+enum compile_error reg_to_NFA_within(const char *regexp,
+    const struct compile_budget *budget, struct NFA *nfa)
+{
+    return __reg_to_NFA(regexp, 0, budget, nfa);
+}
+
+/* Compile basic regular expression to the NFA of its reversal within the
+ * budget, just like reg_to_NFA_within */
+enum compile_error reg_to_reversed_NFA_within(const char *regexp,
+    const struct compile_budget *budget, struct NFA *nfa)
+{
+    return __reg_to_NFA(regexp, 1, budget, nfa);
+}
+
+/* Parse a set of regexps to one NFA of its own arena within the budget */
+static enum compile_error __regs_to_NFA_set(const char *const *regexps,
+    int n_regexps, int is_reversed, const struct compile_budget *budget,
+    struct NFA_set *set)
+{
+    struct NFA_arena *arena;
+    struct NFA *nfas;
+    enum compile_error error = COMPILE_OK;
+    size_t base = budget_bytes_base();
+    int i = 0;
+
+    if (n_regexps <= 0)  return COMPILE_NO_PATTERNS;
+
+    arena = create_NFA_arena();
+    nfas  = (struct NFA*)mem_alloc(n_regexps * sizeof(struct NFA));
+    for ( ; i < n_regexps && error == COMPILE_OK; i++) {
+        error = __LL_parse(regexps[i], arena, is_reversed, budget, base,
+            nfas + i);
+    }
+    if (error != COMPILE_OK)
+    {
+        mem_free(nfas);
+        destroy_NFA_arena(arena);
+        return error;
+    }
+
+    *set = NFA_join(nfas, n_regexps);
+    mem_free(nfas);
 
-    if (**cur != '\0') {
-        fprintf(stderr, "unexcepted character \"%c\"\n", **cur);
-        exit(-1);
+    /* joining adds the common start state */
+    if ((error = budget_check(budget, arena->n_states, 0, base)) !=
+        COMPILE_OK)
+    {
+        NFA_set_dispose(set); return error;
     }
 
+    STATS_ADD(n_NFA_states, arena->n_states);
+    return COMPILE_OK;
+}
+
+/* Compile a set of regular expressions to one NFA within the budget, the
+ * set is stored to *set on success. It returns COMPILE_OK, or the error
+ * found and then nothing is left allocated. A set of no regexps is
+ * COMPILE_NO_PATTERNS. */
+enum compile_error regs_to_NFA_set_within(const char *const *regexps,
+    int n_regexps, const struct compile_budget *budget, struct NFA_set *set)
+{
+    return __regs_to_NFA_set(regexps, n_regexps, 0, budget, set);
+}
+
+/* Compile a set of regular expressions to one NFA of their reversals within
+ * the budget, just like regs_to_NFA_set_within */
+enum compile_error regs_to_reversed_NFA_set_within(
+    const char *const *regexps, int n_regexps,
+    const struct compile_budget *budget, struct NFA_set *set)
+{
+    return __regs_to_NFA_set(regexps, n_regexps, 1, budget, set);
+}
+
+/* LL parser driver/interface */
+struct NFA reg_to_NFA(const char *regexp)
+{
+    struct NFA nfa;
+
+    __exit_on_error(reg_to_NFA_within(regexp, NULL, &nfa));
+    return nfa;
+}
+
+/* Compile basic regular expression to an NFA recognizing the reversal of the
+ * strings matched by the regexp, which can be run backwards over an input */
+struct NFA reg_to_reversed_NFA(const char *regexp)
+{
+    struct NFA nfa;
+
+    __exit_on_error(reg_to_reversed_NFA_within(regexp, NULL, &nfa));
     return nfa;
 }
+
+/* Compile a set of regular expressions to one NFA, the i-th regexp becomes
+ * the i-th pattern of the set */
+struct NFA_set regs_to_NFA_set(const char *const *regexps, int n_regexps)
+{
+    struct NFA_set set;
+
+    __exit_on_error(regs_to_NFA_set_within(regexps, n_regexps, NULL, &set));
+    return set;
+}
+
+/* Parse a regexp to an AST in the pool and return the id of its root */
+int reg_to_AST(const char *regexp, struct reg_pool *pool)
+{
+    int root;
+
+    __exit_on_error(reg_to_AST_within(regexp, NULL, pool, &root));
+    return root;
+}
+
+/* Parse a set of regexps to one AST: an alternation of every regexp
+ * followed by REG_ACCEPT of its number */
+int regs_to_AST(const char *const *regexps, int n_regexps,
+    struct reg_pool *pool)
+{
+    int root;
+
+    __exit_on_error(regs_to_AST_within(regexps, n_regexps, NULL, pool, &root));
+    return root;
+}
+
+/* Parse a regexp to an AST in the pool within the budget, whose byte limit
+ * is the only one that applies, the id of its root is stored to *root on
+ * success. It returns COMPILE_OK, or the error found. Nodes made before the
+ * error are left in the pool, and go away with it. */
+enum compile_error reg_to_AST_within(const char *regexp,
+    const struct compile_budget *budget, struct reg_pool *pool, int *root)
+{
+    struct __LL_parser parser;
+    int node;
+
+    parser.arena = NULL;
+    parser.is_reversed = 0;
+    parser.pool = pool;
+    parser.budget = budget;
+    parser.base = budget_bytes_base();
+    parser.error = COMPILE_OK;
+    __int_vector_init(&parser.pending);
+
+    node = __LL_parse_with(regexp, &parser).node;
+
+    __int_vector_destroy(&parser.pending);
+    if (parser.error == COMPILE_OK)  *root = node;
+    return parser.error;
+}
+
+/* Parse a set of regexps to one AST within the budget, just like
+ * reg_to_AST_within, a set of no regexps is COMPILE_NO_PATTERNS */
+enum compile_error regs_to_AST_within(const char *const *regexps,
+    int n_regexps, const struct compile_budget *budget,
+    struct reg_pool *pool, int *root)
+{
+    int *roots;
+    enum compile_error error = COMPILE_OK;
+    int i;
+
+    if (n_regexps <= 0)  return COMPILE_NO_PATTERNS;
+
+    roots = (int*)mem_alloc(n_regexps * sizeof(int));
+    for (i = 0; i < n_regexps && error == COMPILE_OK; i++)
+    {
+        error = reg_to_AST_within(regexps[i], budget, pool, roots + i);
+        if (error == COMPILE_OK)
+            roots[i] = reg_concat(pool, roots[i], reg_accept(pool, i));
+    }
+    if (error == COMPILE_OK)
+        *root = reg_alternate_n(pool, roots, n_regexps);
+    mem_free(roots);
+
+    return error;
+}
@@ -0,0 +1,310 @@
+#include "mem.h"
+#include "nfa.h"
+#include "dfa.h"
+#include "dfa_table.h"
+#include "dfa_search.h"
+#include "lazy_dfa.h"
+#include "glushkov.h"
+#include "reviz.h"
+
+
+/* Compiled pattern. It holds either the table of the minimized DFA and the
+ * searcher, the NFA matching any regexp of the set if it is lazy, or the
+ * position automaton of a single regexp if it is bit-parallel. */
+struct reviz_pattern
+{
+    int n_patterns;         /* num of regexps compiled */
+    int is_lazy;            /* if the NFA is kept instead of the DFA */
+    int is_bit_parallel;    /* if the position automaton is kept instead of
+                             * the DFA */
+    size_t lazy_memory;     /* bytes of the state cache of each scratch, if
+                             * is_lazy */
+
+    struct DFA_table table; /* compiled DFA, unless is_lazy */
+    struct DFA_searcher searcher;   /* searcher of any regexp of the set,
+                                     * unless is_lazy */
+    struct NFA_set set;     /* NFA of the regexps, if is_lazy */
+    struct glushkov_NFA positions;  /* position automaton of the regexp, of
+                                     * a single word, if is_bit_parallel */
+};
+
+struct reviz_scratch
+{
+    const struct reviz_pattern *pattern;    /* pattern it is created for */
+    struct lazy_DFA lazy;   /* state cache of the lazy DFA, if the pattern
+                             * is lazy */
+};
+
+
+/* Make the NFA of the set match any of its patterns: the terminate states
+ * of the patterns, which have no transitions, all move to a common
+ * terminate state. A set which has one already is left as it is. */
+static void __join_terminates(struct NFA_set *set)
+{
+    struct NFA_arena *arena = set->nfa.arena;
+    int i = 0, terminate;
+
+    if (set->nfa.terminate != -1)  return;
+
+    terminate = alloc_NFA_state(arena);
+    for ( ; i < set->n_patterns; i++)
+        NFA_epsilon_move(arena, set->terminates[i], terminate);
+    set->nfa.terminate = terminate;
+}
+
+/* Compile the tables of the pattern within the budget: the minimized DFA of
+ * the set, and the searcher, which looks for any of the regexps and so is
+ * built from NFAs having a common terminate state */
+static enum compile_error __compile_tables(const char *const *regexps,
+    int n_regexps, struct NFA_set *set, const struct compile_budget *budget,
+    struct reviz_pattern *pattern)
+{
+    struct NFA_set reversed;
+    struct DFA *dfa, *dfa_opt;
+    enum compile_error error;
+
+    if ((error = NFA_set_to_DFA_within(set, budget, &dfa)) != COMPILE_OK)
+        return error;
+    error = DFA_optimize_within(dfa, budget, &dfa_opt);
+    DFA_dispose(dfa);
+    if (error != COMPILE_OK)  return error;
+
+    error = regs_to_reversed_NFA_set_within(regexps, n_regexps, budget,
+        &reversed);
+    if (error == COMPILE_OK)
+    {
+        error = NFA_set_reduce_within(&reversed, budget);
+        if (error == COMPILE_OK)
+        {
+            __join_terminates(&reversed);
+            __join_terminates(set);
+            error = create_DFA_searcher_within(&set->nfa, &reversed.nfa,
+                DFA_LEFTMOST_LONGEST, budget, &pattern->searcher);
+        }
+        NFA_set_dispose(&reversed);
+    }
+    if (error != COMPILE_OK)
+    {
+        DFA_dispose(dfa_opt); return error;
+    }
+
+    DFA_compile(dfa_opt, &pattern->table);
+    DFA_dispose(dfa_opt);
+    return COMPILE_OK;
+}
+
+/* Build the position automaton of a single regexp, the pattern is made
+ * bit-parallel if it has no more than 64 positions. It returns COMPILE_OK, or
+ * the error found. */
+static enum compile_error __compile_positions(const char *regexp,
+    const struct compile_budget *budget, struct reviz_pattern *pattern)
+{
+    struct NFA nfa;
+    enum compile_error error;
+
+    /* positions are read off the unreduced NFA */
+    if ((error = reg_to_NFA_within(regexp, budget, &nfa)) != COMPILE_OK)
+        return error;
+    create_glushkov_NFA(&nfa, &pattern->positions);
+    NFA_dispose(&nfa);
+
+    if (pattern->positions.n_positions <= 64)
+        pattern->is_bit_parallel = 1;
+    else
+        destroy_glushkov_NFA(&pattern->positions);
+    return COMPILE_OK;
+}
+
+/* Compile a set of regexps to a pattern within the budget (which may be
+ * NULL), the i-th regexp is the i-th pattern of the set. It returns
+ * COMPILE_OK and stores the pattern to *pattern, or the error found and
+ * then nothing is left allocated. A set of no regexps is
+ * COMPILE_NO_PATTERNS. */
+enum compile_error reviz_compile(const char *const *regexps, int n_regexps,
+    const struct compile_budget *budget, int flags,
+    struct reviz_pattern **pattern)
+{
+    struct reviz_pattern *ret;
+    struct NFA_set set;
+    enum compile_error error;
+
+    if ((error = regs_to_NFA_set_within(regexps, n_regexps, budget, &set))
+        != COMPILE_OK)
+        return error;
+
+    ret = (struct reviz_pattern*)mem_calloc(1, sizeof(struct reviz_pattern));
+    if (ret == NULL)
+    {
+        NFA_set_dispose(&set); return COMPILE_OUT_OF_MEMORY;
+    }
+    ret->n_patterns = n_regexps;
+
+    /* a single regexp of few positions needs no DFA at all */
+    if ((flags & REVIZ_BIT_PARALLEL) && n_regexps == 1)
+    {
+        error = __compile_positions(regexps[0], budget, ret);
+        if (error != COMPILE_OK || ret->is_bit_parallel)
+        {
+            NFA_set_dispose(&set);
+            if (error != COMPILE_OK)
+            {
+                mem_free(ret); return error;
+            }
+            *pattern = ret;
+            return COMPILE_OK;
+        }
+    }
+
+    error = NFA_set_reduce_within(&set, budget);
+    if (error == COMPILE_OK)
+        error = __compile_tables(regexps, n_regexps, &set, budget, ret);
+
+    /* a reduction or tables too large to build leave the pattern to the
+     * lazy DFA, the NFA is within the budget already */
+    if (error != COMPILE_OK &&
+        !(compile_error_is_limit(error) && (flags & REVIZ_LAZY_FALLBACK)))
+    {
+        NFA_set_dispose(&set);
+        mem_free(ret);
+        return error;
+    }
+
+    if (error == COMPILE_OK) {
+        NFA_set_dispose(&set);
+    }
+    else
+    {
+        __join_terminates(&set);
+        ret->is_lazy = 1;
+        ret->set = set;
+
+        /* the state cache is held to the byte limit of the budget */
+        ret->lazy_memory = budget != NULL && budget->max_bytes > 0 ?
+            budget->max_bytes : LAZY_DFA_DEFAULT_MEMORY;
+    }
+
+    *pattern = ret;
+    return COMPILE_OK;
+}
+
+/* Free the pattern, no thread may be matching with it */
+void reviz_free(struct reviz_pattern *pattern)
+{
+    if (pattern == NULL)  return;
+
+    if (pattern->is_lazy)
+        NFA_set_dispose(&pattern->set);
+    else if (pattern->is_bit_parallel)
+        destroy_glushkov_NFA(&pattern->positions);
+    else
+    {
+        DFA_table_dispose(&pattern->table);
+        destroy_DFA_searcher(&pattern->searcher);
+    }
+    mem_free(pattern);
+}
+
+/* Get the num of regexps the pattern is compiled from */
+int reviz_n_patterns(const struct reviz_pattern *pattern) {
+    return pattern->n_patterns;
+}
+
+/* Check if the pattern is matched by a lazy DFA, which only tells whether
+ * any of its regexps matches */
+int reviz_is_lazy(const struct reviz_pattern *pattern) {
+    return pattern->is_lazy;
+}
+
+/* Check if the pattern is matched by the bit-parallel position automaton,
+ * which can't search */
+int reviz_is_bit_parallel(const struct reviz_pattern *pattern) {
+    return pattern->is_bit_parallel;
+}
+
+
+/* Create the scratch space for a thread matching with the pattern, it
+ * returns NULL if it fails to allocate memory */
+struct reviz_scratch *reviz_create_scratch(
+    const struct reviz_pattern *pattern)
+{
+    struct reviz_scratch *scratch = (struct reviz_scratch*)
+        mem_calloc(1, sizeof(struct reviz_scratch));
+
+    if (scratch == NULL)  return NULL;
+
+    scratch->pattern = pattern;
+    if (pattern->is_lazy &&
+        create_lazy_DFA(&pattern->set.nfa, pattern->lazy_memory,
+            &scratch->lazy) != 0)
+    {
+        mem_free(scratch); return NULL;
+    }
+
+    return scratch;
+}
+
+/* Free the scratch space */
+void reviz_free_scratch(struct reviz_scratch *scratch)
+{
+    if (scratch == NULL)  return;
+
+    if (scratch->pattern->is_lazy)  destroy_lazy_DFA(&scratch->lazy);
+    mem_free(scratch);
+}
+
+
+/* Run the position automaton of a bit-parallel pattern, a single word
+ * automaton never touches its scratch sets, so it's shared by threads */
+static int __match_positions(const struct reviz_pattern *pattern,
+    const char *buf, size_t len)
+{
+    return glushkov_NFA_match((struct glushkov_NFA*) &pattern->positions,
+        buf, len);
+}
+
+/* Check if the whole buffer matches any regexp of the pattern. The scratch
+ * must be created for the pattern, it may be NULL unless the pattern is
+ * lazy. */
+int reviz_match(const struct reviz_pattern *pattern,
+    struct reviz_scratch *scratch, const char *buf, size_t len)
+{
+    if (pattern->is_lazy)
+        return lazy_DFA_match(&scratch->lazy, buf, len);
+    if (pattern->is_bit_parallel)
+        return __match_positions(pattern, buf, len);
+
+    return DFA_match(&pattern->table, buf, len);
+}
+
+/* Find all regexps of the pattern matching the whole buffer, it returns the
+ * num of them and stores their numbers, in ascending order, to *ids. The ids
+ * belong to the pattern. It returns -1 if the pattern is lazy. */
+int reviz_match_patterns(const struct reviz_pattern *pattern,
+    const char *buf, size_t len, const int **ids)
+{
+    static const int first_id = 0;
+
+    if (pattern->is_lazy)  return -1;
+
+    /* a bit-parallel pattern is a single regexp */
+    if (pattern->is_bit_parallel)
+    {
+        *ids = &first_id;
+        return __match_positions(pattern, buf, len);
+    }
+
+    return DFA_match_patterns(&pattern->table, buf, len, ids);
+}
+
+/* Find the leftmost-longest substring of buf matching any regexp of the
+ * pattern, it returns 1 and stores its offsets to [*match_start,
+ * *match_end) if there's one, 0 if there's none, or -1 if the pattern is
+ * lazy or bit-parallel */
+int reviz_search(const struct reviz_pattern *pattern, const char *buf,
+    size_t len, size_t *match_start, size_t *match_end)
+{
+    if (pattern->is_lazy || pattern->is_bit_parallel)  return -1;
+
+    return DFA_searcher_find(&pattern->searcher, buf, len, match_start,
+        match_end);
+}
@@ -0,0 +1,97 @@
+#ifndef __REVIZ_HEADER__
+#define __REVIZ_HEADER__
+
+
+#include <stddef.h>
+
+#include "budget.h"
+
+
+/* Reentrant interface of libreviz. A set of regexps is compiled once to an
+ * opaque pattern, which is never modified afterwards, so any num of threads
+ * may match with the same pattern at the same time. Nothing in the library
+ * exits the process or keeps global state: errors are returned, and the
+ * memory accounting and instrumentation are per thread.
+ *
+ * A pattern is normally a minimized DFA compiled to a table, along with the
+ * forward and reverse DFAs of a searcher (see src/dfa_search.h), and
+ * matching with it needs no memory of its own. If any of them would exceed
+ * the budget and REVIZ_LAZY_FALLBACK is given, the pattern keeps the NFA
+ * instead and is matched by a lazy DFA, whose state cache is the scratch of
+ * each thread. The cache of a scratch takes no more than the byte limit of
+ * the budget (or LAZY_DFA_DEFAULT_MEMORY if there's none), it is flushed
+ * when full.
+ *
+ * With REVIZ_BIT_PARALLEL, a single regexp of no more than 64 positions (the
+ * bytes, classes and dots in it) is compiled to its position automaton
+ * instead, see src/glushkov.h. It's matched by a few word operations per
+ * byte, with no DFA to build and no state explosion, but it can't search. */
+struct reviz_pattern;
+
+/* Scratch space of a thread matching with a pattern, it must not be shared
+ * by threads running at the same time */
+struct reviz_scratch;
+
+/* Flags of reviz_compile */
+enum {
+    REVIZ_LAZY_FALLBACK = 1,    /* match lazily if the DFA is too large */
+    REVIZ_BIT_PARALLEL  = 2     /* match a single regexp of up to 64
+                                 * positions by its position automaton */
+};
+
+
+/* Compile a set of regexps to a pattern within the budget (which may be
+ * NULL), the i-th regexp is the i-th pattern of the set. It returns
+ * COMPILE_OK and stores the pattern to *pattern, or the error found and
+ * then nothing is left allocated. A set of no regexps is
+ * COMPILE_NO_PATTERNS. */
+enum compile_error reviz_compile(const char *const *regexps, int n_regexps,
+    const struct compile_budget *budget, int flags,
+    struct reviz_pattern **pattern);
+
+/* Free the pattern, no thread may be matching with it */
+void reviz_free(struct reviz_pattern *pattern);
+
+/* Get the num of regexps the pattern is compiled from */
+int reviz_n_patterns(const struct reviz_pattern *pattern);
+
+/* Check if the pattern is matched by a lazy DFA, which only tells whether
+ * any of its regexps matches */
+int reviz_is_lazy(const struct reviz_pattern *pattern);
+
+/* Check if the pattern is matched by the bit-parallel position automaton,
+ * which can't search */
+int reviz_is_bit_parallel(const struct reviz_pattern *pattern);
+
+
+/* Create the scratch space for a thread matching with the pattern, it
+ * returns NULL if it fails to allocate memory */
+struct reviz_scratch *reviz_create_scratch(
+    const struct reviz_pattern *pattern);
+
+/* Free the scratch space */
+void reviz_free_scratch(struct reviz_scratch *scratch);
+
+
+/* Check if the whole buffer matches any regexp of the pattern. The scratch
+ * must be created for the pattern, it may be NULL unless the pattern is
+ * lazy. */
+int reviz_match(const struct reviz_pattern *pattern,
+    struct reviz_scratch *scratch, const char *buf, size_t len);
+
+/* Find all regexps of the pattern matching the whole buffer, it returns the
+ * num of them and stores their numbers, in ascending order, to *ids. The ids
+ * belong to the pattern. It returns -1 if the pattern is lazy. */
+int reviz_match_patterns(const struct reviz_pattern *pattern,
+    const char *buf, size_t len, const int **ids);
+
+/* Find the leftmost-longest substring of buf matching any regexp of the
+ * pattern, it returns 1 and stores its offsets to [*match_start,
+ * *match_end) if there's one, 0 if there's none, or -1 if the pattern is
+ * lazy or bit-parallel */
+int reviz_search(const struct reviz_pattern *pattern, const char *buf,
+    size_t len, size_t *match_start, size_t *match_end);
+
+
+
+#endif /* __REVIZ_HEADER__ */
@@ -0,0 +1,367 @@
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mem.h"
+#include "dfa_stream.h"
+#include "dfa_parallel.h"
+#include "scan.h"
+
+
+#define __CHUNK_SIZE  (1 << 16)     /* bytes read at a time from an input
+                                     * which can't be mapped */
+
+/* Bytes of an input read in chunks which are still needed, buf[0] is the
+ * byte at the given offset of the input */
+struct __window
+{
+    char  *buf;
+    size_t len;         /* num of bytes in buf */
+    size_t capacity;    /* num of bytes buf can hold */
+    size_t offset;      /* offset of buf[0] in the input */
+    int is_eof;         /* if the whole input has been read */
+};
+
+
+/* Check if a line has a match. Only the forward table of the searcher is run
+ * over the line, since where the match starts doesn't matter. */
+static int __line_has_match(const struct DFA_searcher *searcher,
+    const char *line, size_t len)
+{
+    struct DFA_stream stream;
+
+    DFA_stream_init(&stream, &searcher->forward);
+    DFA_stream_feed(&stream, line, len);
+    return stream.is_matched;
+}
+
+/* Print the lines containing a match. Each line is searched alone, so a match
+ * never runs over the end of its line, and no byte is read more than once. */
+static long __scan_lines(const struct DFA_searcher *searcher,
+    const char *buf, size_t len, FILE *fp)
+{
+    const char *eol;
+    size_t pos = 0, line_len;
+    long n_lines = 0;
+
+    while (pos < len)
+    {
+        eol = (const char*) memchr(buf + pos, '\n', len - pos);
+        line_len = (eol != NULL ? (size_t)(eol - buf) : len) - pos;
+
+        if (__line_has_match(searcher, buf + pos, line_len))
+        {
+            fwrite(buf + pos, 1, line_len, fp);
+            fputc('\n', fp);
+            n_lines++;
+        }
+        pos += line_len + 1;
+    }
+
+    return n_lines;
+}
+
+/* Print the offsets of non-overlapping matches from left to right, an empty
+ * match is followed by a search from the next byte */
+static long __scan_offsets(const struct DFA_searcher *searcher,
+    const char *buf, size_t len, FILE *fp)
+{
+    size_t pos = 0, start, end;
+    long n_matches = 0;
+
+    while (pos <= len &&
+        DFA_searcher_find(searcher, buf + pos, len - pos, &start, &end))
+    {
+        fprintf(fp, "%lu %lu\n",
+            (unsigned long)(pos + start), (unsigned long)(pos + end));
+        n_matches++;
+
+        pos += (end > start) ? end : end + 1;
+    }
+
+    return n_matches;
+}
+
+/* Read the next chunk of the input to the end of the window, it returns 0
+ * on success or -1 on failure */
+static int __read_chunk(int fd, struct __window *w)
+{
+    ssize_t n_read;
+
+    if (w->capacity - w->len < __CHUNK_SIZE)
+    {
+        char *buf = (char*)mem_realloc(w->buf, w->len + __CHUNK_SIZE);
+        if (buf == NULL) {
+            errno = ENOMEM; return -1;
+        }
+        w->buf = buf;
+        w->capacity = w->len + __CHUNK_SIZE;
+    }
+
+    do {
+        n_read = read(fd, w->buf + w->len, __CHUNK_SIZE);
+    } while (n_read == -1 && errno == EINTR);
+
+    if (n_read == -1)  return -1;
+    if (n_read == 0)   w->is_eof = 1;
+    w->len += (size_t) n_read;
+    return 0;
+}
+
+/* Drop the bytes of the window before the given offset of the input */
+static void __drop_before(struct __window *w, size_t offset)
+{
+    size_t n_dropped = offset - w->offset;
+
+    if (n_dropped == 0)  return;
+    memmove(w->buf, w->buf + n_dropped, w->len - n_dropped);
+    w->len   -= n_dropped;
+    w->offset = offset;
+}
+
+/* Print the lines of a streamed input containing a match, each line is
+ * searched alone once it's read to its end */
+static long __stream_lines(const struct DFA_searcher *searcher, int fd,
+    FILE *fp)
+{
+    struct __window w = {NULL, 0, 0, 0, 0};
+    size_t line = 0, from = 0, line_len;
+    const char *eol;
+    long n_lines = 0;
+
+    for (;;)
+    {
+        /* the line begins at w.buf[line], and has no newline before
+         * w.buf[from] */
+        eol = (from < w.len) ?
+            (const char*) memchr(w.buf + from, '\n', w.len - from) : NULL;
+        if (eol == NULL && !w.is_eof)
+        {
+            __drop_before(&w, w.offset + line);
+            line = 0;
+            from = w.len;
+            if (__read_chunk(fd, &w) == -1) {
+                n_lines = -1; break;
+            }
+            continue;
+        }
+
+        /* the last line may have no newline, but it isn't empty then */
+        line_len = (eol != NULL ? (size_t)(eol - w.buf) : w.len) - line;
+        if (eol == NULL && line_len == 0)  break;
+
+        if (__line_has_match(searcher, w.buf + line, line_len))
+        {
+            fwrite(w.buf + line, 1, line_len, fp);
+            fputc('\n', fp);
+            n_lines++;
+        }
+        if (eol == NULL)  break;
+
+        line = from = line + line_len + 1;
+    }
+
+    mem_free(w.buf);
+    return n_lines;
+}
+
+/* Print the offsets of the matches of a streamed input just like
+ * __scan_offsets. The forward table of the searcher is fed chunk by chunk
+ * until the match is settled, then the start of the match is found
+ * backwards from its end. No match starts before the last offset where the
+ * table was in its start state, so the window keeps only the bytes from
+ * there, and an input with few partial matches takes constant memory. */
+static long __stream_offsets(const struct DFA_searcher *searcher, int fd,
+    FILE *fp)
+{
+    struct __window w = {NULL, 0, 0, 0, 0};
+    struct DFA_stream stream;
+    size_t pos = 0, fed = 0, from, start, end;
+    long n_matches = 0;
+    int is_alive = 1;
+
+    DFA_stream_init(&stream, &searcher->forward);
+    for (;;)
+    {
+        if (is_alive && fed == w.offset + w.len && !w.is_eof)
+        {
+            __drop_before(&w, stream.last_start);
+            if (__read_chunk(fd, &w) == -1) {
+                n_matches = -1; break;
+            }
+            continue;
+        }
+        if (is_alive && fed < w.offset + w.len)
+        {
+            is_alive = DFA_stream_feed(&stream, w.buf + (fed - w.offset),
+                w.offset + w.len - fed);
+            fed = w.offset + w.len;
+            continue;
+        }
+
+        /* the DFA is dead or the input is over, the match is settled */
+        if (!stream.is_matched)  break;
+
+        /* the start is searched from pos at the earliest, since a match
+         * never overlaps the previous one */
+        from  = pos > w.offset ? pos : w.offset;
+        end   = stream.match_end;
+        start = from + DFA_searcher_match_start(searcher,
+            w.buf + (from - w.offset), end - from);
+        fprintf(fp, "%lu %lu\n", (unsigned long) start, (unsigned long) end);
+        n_matches++;
+
+        /* an empty match at the end of the input is the last one */
+        pos = (end > start) ? end : end + 1;
+        if (pos > w.offset + w.len)  break;
+
+        DFA_stream_init_at(&stream, &searcher->forward, pos);
+        fed = pos;
+        is_alive = 1;
+    }
+
+    mem_free(w.buf);
+    return n_matches;
+}
+
+/* Check if a streamed input has a match, the DFA of NFA_containing accepts
+ * every prefix once a match is seen, so reading stops right there */
+static int __stream_contains(const struct DFA_table *table, int fd)
+{
+    struct __window w = {NULL, 0, 0, 0, 0};
+    struct DFA_stream stream;
+    int is_alive = 1, is_matched;
+
+    DFA_stream_init(&stream, table);
+    while (is_alive && !stream.is_matched && !w.is_eof)
+    {
+        if (__read_chunk(fd, &w) == -1)
+        {
+            mem_free(w.buf); return -1;
+        }
+        is_alive = DFA_stream_feed(&stream, w.buf, w.len);
+        __drop_before(&w, w.offset + w.len);
+    }
+
+    is_matched = stream.is_matched;
+    mem_free(w.buf);
+    return is_matched;
+}
+
+
+/* Open the input at path, which is the standard input if path is "-", it
+ * returns the file descriptor or -1 on failure */
+static int __open_input(const char *path)
+{
+    return strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+}
+
+/* Close the input opened by __open_input */
+static void __close_input(int fd)
+{
+    if (fd != STDIN_FILENO)  close(fd);
+}
+
+/* Map the whole file into memory for reading it sequentially, it returns 1
+ * if it's mapped, 0 if it isn't a regular file, which is read in chunks
+ * instead, or -1 on failure. An empty file can't be mapped, it gets a NULL
+ * buffer instead. */
+static int __map_file(int fd, char **buf, size_t *len)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) == -1)  return -1;
+    if (!S_ISREG(st.st_mode))  return 0;
+
+    *buf = NULL;
+    *len = (size_t) st.st_size;
+    if (*len != 0)
+    {
+        *buf = (char*)mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (*buf == MAP_FAILED)  return -1;
+        madvise(*buf, *len, MADV_SEQUENTIAL);
+    }
+
+    return 1;
+}
+
+/* Unmap a file mapped by __map_file */
+static void __unmap_file(char *buf, size_t len)
+{
+    if (buf != NULL)  munmap(buf, len);
+}
+
+
+/* Scan a file for matches of the searcher and print them to fp, mode is
+ * either SCAN_LINES or SCAN_OFFSETS. A regular file is mapped into memory
+ * rather than read, so it's scanned in place without being copied. Any other
+ * input, such as a pipe or the standard input given as "-", is read in
+ * chunks. This function returns the num of matches (or matching lines)
+ * found, or -1 if the file can't be mapped or read. */
+long scan_file(const struct DFA_searcher *searcher, const char *path,
+    enum scan_mode mode, FILE *fp)
+{
+    char *buf;
+    size_t len;
+    long n_found;
+    int fd, is_mapped;
+
+    if ((fd = __open_input(path)) == -1)  return -1;
+
+    if ((is_mapped = __map_file(fd, &buf, &len)) == 1)
+    {
+        if (mode == SCAN_LINES)
+            n_found = __scan_lines(searcher, buf, len, fp);
+        else
+            n_found = __scan_offsets(searcher, buf, len, fp);
+        __unmap_file(buf, len);
+    }
+    else if (is_mapped == 0)
+    {
+        if (mode == SCAN_LINES)
+            n_found = __stream_lines(searcher, fd, fp);
+        else
+            n_found = __stream_offsets(searcher, fd, fp);
+    }
+    else {
+        n_found = -1;
+    }
+
+    __close_input(fd);
+    return n_found;
+}
+
+/* Check if a file has a match of a pattern, with n_threads threads running
+ * the DFA over different parts of the mapped file at once. An input which
+ * can't be mapped is streamed through the DFA by one thread instead. The
+ * table must be compiled from the DFA of NFA_containing(the NFA of the
+ * pattern). It returns 1 if there's a match, 0 if not, or -1 if the file
+ * can't be mapped or read. */
+int scan_file_contains(const struct DFA_table *table, const char *path,
+    int n_threads)
+{
+    char *buf;
+    size_t len;
+    int fd, is_mapped, is_matched;
+
+    if ((fd = __open_input(path)) == -1)  return -1;
+
+    if ((is_mapped = __map_file(fd, &buf, &len)) == 1)
+    {
+        is_matched = DFA_parallel_match(table, buf, len, n_threads);
+        __unmap_file(buf, len);
+    }
+    else if (is_mapped == 0) {
+        is_matched = __stream_contains(table, fd);
+    }
+    else {
+        is_matched = -1;
+    }
+
+    __close_input(fd);
+    return is_matched;
+}
@@ -0,0 +1,41 @@
+#ifndef __SCAN_HEADER__
+#define __SCAN_HEADER__
+
+
+#include <stdio.h>
+
+#include "dfa_table.h"
+#include "dfa_search.h"
+
+
+/* What to report when scanning a file */
+enum scan_mode
+{
+    SCAN_LINES,     /* lines containing a match, like grep */
+    SCAN_OFFSETS,   /* start and end offsets of every match */
+    SCAN_QUIET      /* nothing, only whether there's a match at all, which
+                     * is checked by scan_file_contains */
+};
+
+
+/* Scan a file for matches of the searcher and print them to fp, mode is
+ * either SCAN_LINES or SCAN_OFFSETS. A regular file is mapped into memory
+ * rather than read, so it's scanned in place without being copied. Any other
+ * input, such as a pipe or the standard input given as "-", is read in
+ * chunks. This function returns the num of matches (or matching lines)
+ * found, or -1 if the file can't be mapped or read. */
+long scan_file(const struct DFA_searcher *searcher, const char *path,
+    enum scan_mode mode, FILE *fp);
+
+/* Check if a file has a match of a pattern, with n_threads threads running
+ * the DFA over different parts of the mapped file at once. An input which
+ * can't be mapped is streamed through the DFA by one thread instead. The
+ * table must be compiled from the DFA of NFA_containing(the NFA of the
+ * pattern). It returns 1 if there's a match, 0 if not, or -1 if the file
+ * can't be mapped or read. */
+int scan_file_contains(const struct DFA_table *table, const char *path,
+    int n_threads);
+
+
+
+#endif /* __SCAN_HEADER__ */
@@ -0,0 +1,28 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include "mem.h"
+#include "sset.h"
+
+
+
+/* Create an empty sparse set which is able to hold integers in the range of
+ * [0, capacity) */
+void create_sparse_set(int capacity, struct sparse_set *set)
+{
+    assert(capacity >= 0);
+
+    /* sparse[] is zero-filled so that membership tests never read an
+     * indeterminate value, the algorithm itself does not depend on it */
+    set->capacity = capacity;
+    set->length   = 0;
+    set->dense    = (int*)mem_alloc((capacity + 1) * sizeof(int));
+    set->sparse   = (int*)mem_calloc(capacity + 1, sizeof(int));
+}
+
+/* Free the memory allocated for the sparse set */
+void destroy_sparse_set(struct sparse_set *set)
+{
+    mem_free(set->dense);
+    mem_free(set->sparse);
+}
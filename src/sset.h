@@ -0,0 +1,51 @@
+#ifndef __SPARSE_SET_HEADER__
+#define __SPARSE_SET_HEADER__
+
+
+
+/* Sparse set of small non-negative integers (Briggs & Torczon). Insertion,
+ * membership test and clear are all O(1), and the members can be enumerated
+ * in insertion order through dense[0 .. length-1]. Every element must be in
+ * the range [0, capacity). */
+struct sparse_set
+{
+    int capacity;    /* elements are in [0, capacity) */
+    int length;      /* num of elements in the set */
+    int *dense;      /* members in insertion order */
+    int *sparse;     /* sparse[e] is the index of e in dense */
+};
+
+/* Create an empty sparse set which is able to hold integers in the range of
+ * [0, capacity) */
+void create_sparse_set(int capacity, struct sparse_set *set);
+
+/* Free the memory allocated for the sparse set */
+void destroy_sparse_set(struct sparse_set *set);
+
+
+/* Check if elem is a member of the set */
+static inline int sparse_set_contains(const struct sparse_set *set, int elem)
+{
+    int i = set->sparse[elem];
+    return i < set->length && set->dense[i] == elem;
+}
+
+/* Add elem to the set, it returns 1 if elem is actually added, or 0 if elem is
+ * already in the set */
+static inline int sparse_set_add(struct sparse_set *set, int elem)
+{
+    if (sparse_set_contains(set, elem)) return 0;
+
+    set->sparse[elem] = set->length;
+    set->dense[set->length++] = elem;
+    return 1;
+}
+
+/* Empty the set */
+static inline void sparse_set_clear(struct sparse_set *set) {
+    set->length = 0;
+}
+
+
+
+#endif /* __SPARSE_SET_HEADER__ */
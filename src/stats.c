@@ -0,0 +1,122 @@
+#include <string.h>
+#include <time.h>
+
+#include "mem.h"
+#include "stats.h"
+
+
+_Thread_local struct stats *g_stats = NULL;
+
+/* names of the phases in the output */
+static const char *__phase_names[STATS_N_PHASES] = {
+    "parse", "reduce", "determinize", "minimize", "dump", "dispose"
+};
+
+
+/* Turn on instrumentation of the calling thread, all counters of stats are
+ * reset */
+void stats_enable(struct stats *stats)
+{
+    memset(stats, 0, sizeof(struct stats));
+    g_stats = stats;
+}
+
+/* Take the current time, a phase is timed by the difference of the times
+ * taken before and after it */
+void stats_now(struct stats_time *now)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now->wall = ts.tv_sec + ts.tv_nsec * 1e-9;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    now->cpu  = ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Charge the time elapsed since "since" to the phase */
+void stats_end_phase(enum stats_phase phase, const struct stats_time *since)
+{
+    struct stats_time now;
+
+    if (g_stats == NULL)  return;
+
+    stats_now(&now);
+    g_stats->phases[phase].wall += now.wall - since->wall;
+    g_stats->phases[phase].cpu  += now.cpu  - since->cpu;
+}
+
+/* Record the memory usage collected by the accounting allocator */
+void stats_collect_memory_usage(void)
+{
+    const struct mem_usage *usage = mem_get_usage();
+
+    if (g_stats == NULL)  return;
+
+    g_stats->bytes_allocated = usage->total;
+    g_stats->peak_memory     = usage->peak;
+}
+
+
+/* Print the stats as human readable text */
+void stats_dump_text(const struct stats *stats, FILE *fp)
+{
+    int phase = 0;
+
+    fprintf(fp, "%-12s %12s %12s\n", "phase", "wall (ms)", "cpu (ms)");
+    for ( ; phase < STATS_N_PHASES; phase++)
+    {
+        fprintf(fp, "%-12s %12.3f %12.3f\n", __phase_names[phase],
+            stats->phases[phase].wall * 1e3, stats->phases[phase].cpu * 1e3);
+    }
+
+    fprintf(fp,
+        "NFA states:        %ld\n"
+        "reduced NFA:       %ld\n"
+        "DFA states:        %ld\n"
+        "DFA opt states:    %ld\n"
+        "epsilon closures:  %ld\n"
+        "set lookups:       %ld\n"
+        "hash probes:       %ld\n"
+        "bytes allocated:   %lu\n"
+        "peak memory:       %lu\n",
+        stats->n_NFA_states, stats->n_reduced_NFA_states,
+        stats->n_DFA_states, stats->n_DFA_opt_states,
+        stats->n_epsilon_closures, stats->n_set_lookups,
+        stats->n_hash_probes, (unsigned long) stats->bytes_allocated,
+        (unsigned long) stats->peak_memory);
+}
+
+/* Print the stats as a JSON object */
+void stats_dump_json(const struct stats *stats, FILE *fp)
+{
+    int phase = 0;
+
+    fprintf(fp, "{\n    \"phases\": {\n");
+    for ( ; phase < STATS_N_PHASES; phase++)
+    {
+        fprintf(fp,
+            "        \"%s\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f}%s\n",
+            __phase_names[phase], stats->phases[phase].wall * 1e3,
+            stats->phases[phase].cpu * 1e3,
+            phase + 1 < STATS_N_PHASES ? "," : "");
+    }
+
+    fprintf(fp,
+        "    },\n"
+        "    \"nfa_states\": %ld,\n"
+        "    \"reduced_nfa_states\": %ld,\n"
+        "    \"dfa_states\": %ld,\n"
+        "    \"dfa_opt_states\": %ld,\n"
+        "    \"epsilon_closures\": %ld,\n"
+        "    \"set_lookups\": %ld,\n"
+        "    \"hash_probes\": %ld,\n"
+        "    \"bytes_allocated\": %lu,\n"
+        "    \"peak_memory\": %lu\n"
+        "}\n",
+        stats->n_NFA_states, stats->n_reduced_NFA_states,
+        stats->n_DFA_states, stats->n_DFA_opt_states,
+        stats->n_epsilon_closures, stats->n_set_lookups,
+        stats->n_hash_probes, (unsigned long) stats->bytes_allocated,
+        (unsigned long) stats->peak_memory);
+}
@@ -0,0 +1,80 @@
+#ifndef __STATS_HEADER__
+#define __STATS_HEADER__
+
+
+#include <stdio.h>
+#include <stddef.h>
+
+
+/* Phases of compiling a regexp to automatons */
+enum stats_phase {
+    STATS_PARSE,         /* regexp to NFA */
+    STATS_REDUCE,        /* NFA reduction */
+    STATS_DETERMINIZE,   /* NFA to DFA */
+    STATS_MINIMIZE,      /* DFA optimization */
+    STATS_DUMP,          /* graphviz code generation */
+    STATS_DISPOSE,       /* freeing everything */
+    STATS_N_PHASES
+};
+
+/* Time spent in a phase, in seconds */
+struct stats_time
+{
+    double wall;    /* elapsed real time */
+    double cpu;     /* CPU time of the process */
+};
+
+/* Instrumentation data collected while compiling the regexp */
+struct stats
+{
+    struct stats_time phases[STATS_N_PHASES];
+
+    long n_NFA_states;        /* num of states in the NFA */
+    long n_reduced_NFA_states; /* num of NFA states left by reduction */
+    long n_DFA_states;        /* num of states in the DFA */
+    long n_DFA_opt_states;    /* num of states in the optimized DFA */
+
+    long n_epsilon_closures;  /* num of epsilon closures computed */
+    long n_set_lookups;       /* num of state set lookups in hash tables */
+    long n_hash_probes;       /* num of hash table slots inspected */
+
+    size_t bytes_allocated;   /* total bytes allocated */
+    size_t peak_memory;       /* max num of bytes in use at the same time */
+};
+
+/* Where the counters of the calling thread go. It is NULL unless
+ * instrumentation is turned on by the thread, so a counter costs only a test
+ * when nobody is watching, and threads never count into the same stats. */
+extern _Thread_local struct stats *g_stats;
+
+/* Increase a counter by n if instrumentation is on */
+#define STATS_ADD(counter, n)                                   \
+    do { if (g_stats != NULL) g_stats->counter += (n); } while (0)
+
+#define STATS_INC(counter)  STATS_ADD(counter, 1)
+
+
+/* Turn on instrumentation of the calling thread, all counters of stats are
+ * reset */
+void stats_enable(struct stats *stats);
+
+/* Take the current time, a phase is timed by the difference of the times
+ * taken before and after it */
+void stats_now(struct stats_time *now);
+
+/* Charge the time elapsed since "since" to the phase */
+void stats_end_phase(enum stats_phase phase, const struct stats_time *since);
+
+/* Record the memory usage collected by the accounting allocator */
+void stats_collect_memory_usage(void);
+
+
+/* Print the stats as human readable text */
+void stats_dump_text(const struct stats *stats, FILE *fp);
+
+/* Print the stats as a JSON object */
+void stats_dump_json(const struct stats *stats, FILE *fp);
+
+
+
+#endif /* __STATS_HEADER__ */
@@ -0,0 +1,61 @@
+#ifndef __VECTOR_HEADER__
+#define __VECTOR_HEADER__
+
+
+#include "mem.h"
+
+
+#define INITIAL_VECTOR_CAPACITY  8   /* default capacity of new vectors */
+
+/* Define a growable array of elements of certain type, named struct name.
+ * Unlike the generic list, elements are copied by assignment and the methods
+ * are generated for each type, so they can be inlined by the compiler:
+
+       name_init(v)         create an empty vector
+       name_destroy(v)      free the memory allocated for the vector
+       name_push(v, elem)   append elem to the tail of the vector
+       name_pop(v)          remove and return the last element
+       name_clear(v)        empty the vector
+
+   Elements are v->data[0 .. v->length-1]. */
+#define DEFINE_VECTOR(name, type)                                           \
+    struct name                                                             \
+    {                                                                       \
+        type *data;      /* elements */                                     \
+        int length;      /* num of elements in the vector */                \
+        int capacity;    /* num of elements data can hold */                \
+    };                                                                      \
+                                                                            \
+    static inline void name##_init(struct name *v)                          \
+    {                                                                       \
+        v->length   = 0;                                                    \
+        v->capacity = INITIAL_VECTOR_CAPACITY;                              \
+        v->data     = (type*)mem_alloc(v->capacity * sizeof(type));         \
+    }                                                                       \
+                                                                            \
+    static inline void name##_destroy(struct name *v) {                     \
+        mem_free(v->data);                                                  \
+    }                                                                       \
+                                                                            \
+    static inline void name##_push(struct name *v, type elem)               \
+    {                                                                       \
+        if (v->length == v->capacity)                                       \
+        {                                                                   \
+            v->capacity *= 2;   /* expand two-fold */                       \
+            v->data = (type*)mem_realloc(                                   \
+                v->data, v->capacity * sizeof(type));                       \
+        }                                                                   \
+        v->data[v->length++] = elem;                                        \
+    }                                                                       \
+                                                                            \
+    static inline type name##_pop(struct name *v) {                         \
+        return v->data[--v->length];                                        \
+    }                                                                       \
+                                                                            \
+    static inline void name##_clear(struct name *v) {                       \
+        v->length = 0;                                                      \
+    }
+
+
+
+#endif /* __VECTOR_HEADER__ */
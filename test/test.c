@@ -0,0 +1,576 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "mem.h"
+#include "nfa.h"
+#include "dfa.h"
+#include "dfa_table.h"
+#include "dfa_search.h"
+#include "dfa_stream.h"
+#include "dfa_parallel.h"
+#include "lazy_dfa.h"
+#include "glushkov.h"
+#include "scan.h"
+#include "reviz.h"
+
+
+/* Regression tests of the matching engines. Every engine is run over all
+ * short strings of a small alphabet and checked against the Thompson
+ * simulation NFA_pattern_match of the unreduced NFA, which is the reference
+ * since it follows the construction directly. Inputs holding NUL bytes,
+ * which NFA_pattern_match can't take, are checked against expected results
+ * written down instead. The program prints every mismatch and exits with 1 if
+ * there's any. */
+
+
+#define ALPHABET     "abc"
+#define MAX_LENGTH   6      /* strings of up to MAX_LENGTH bytes are tried */
+#define MAX_PATTERNS 4
+
+/* Patterns of a single regexp, they include the ones which backtrack
+ * exponentially, closures of nullable bodies making epsilon cycles, and
+ * regexps matching the empty string */
+static const char *__regexps[] = {
+    "(a|aa)*b", "(a?)*", "(a*)*", "((a|b)?)*c", "a*", "a|ab|abc", "(ab|a)*",
+    "[a-b]*c?", "[^a]*", "a.c", "(a|b)*a(a|b)", "c+(a|b)+", "((ab)*|c)*",
+    "a?a?a?aaa",
+};
+
+/* Sets of regexps, each pattern is reported by its number */
+struct __pattern_set
+{
+    int n_regexps;
+    const char *regexps[MAX_PATTERNS];
+};
+
+static const struct __pattern_set __pattern_sets[] = {
+    {3, {"a*", "(a|b)*b", "ab"}},
+    {3, {"(a|aa)*b", "a*b", "b"}},
+    {4, {"(a?)*", "a", "aa*", "c|a"}},
+    {2, {"[^c]*", "(ab)*"}},
+};
+
+/* Inputs holding NUL bytes along with the expected result of matching the
+ * whole input */
+struct __nul_case
+{
+    const char *regexp;
+    const char *str;
+    size_t len;
+    int is_matched;
+};
+
+static const struct __nul_case __nul_cases[] = {
+    {"a.b",     "a\0b",    3, 1},
+    {"[^a]*",   "\0\0b",   3, 1},
+    {"[^a]*",   "\0a\0",   3, 0},
+    {"a*",      "a\0",     2, 0},
+    {"(.|\\n)*", "\0\n\0", 3, 1},
+    {"a[^b]",   "a\0",     2, 1},
+    {"[a-z]*",  "ab\0",    3, 0},
+    {"(a|aa)*b", "aa\0b",  4, 0},
+};
+
+/* Inputs streamed through a pipe, n_fill bytes of fill repeated followed by
+ * tail, with the only match expected in them. The memory usage of the scan
+ * must grow by no more than max_growth bytes, unless it's 0, since the
+ * window keeps only the bytes a match may start from. */
+struct __stream_case
+{
+    const char *regexp;
+    const char *fill;
+    size_t n_fill;
+    const char *tail;
+    long start, end;
+    size_t max_growth;
+};
+
+static const struct __stream_case __stream_cases[] = {
+    {"foo",  "x",    32 << 20, "foo", 32 << 20, (32 << 20) + 3, 1 << 20},
+    {"ab*c", "abbx", 32 << 20, "abc", 32 << 20, (32 << 20) + 3, 1 << 20},
+    {"x*y",  "x",    1 << 20,  "y",   0,        (1 << 20) + 1,  0},
+};
+
+/* Regexps which must be rejected with an error rather than ending the
+ * process */
+static const char *__malformed[] = { "", "()", "(a|)", "a||b", "(a", "a\\" };
+
+
+static int n_checks, n_failures;
+
+/* Count a check and report it if it fails */
+static void __check(const char *engine, const char *regexp,
+    const char *str, size_t len, long got, long expected)
+{
+    size_t i;
+
+    n_checks++;
+    if (got == expected)  return;
+
+    n_failures++;
+    printf("FAIL %s /%s/ \"", engine, regexp);
+    for (i = 0; i < len; i++)
+    {
+        if (str[i] == '\0')  printf("\\0");
+        else                 putchar(str[i]);
+    }
+    printf("\": got %ld, expected %ld\n", got, expected);
+}
+
+/* Get the i-th string over the alphabet in shortlex order, it returns its
+ * length, or -1 if there are no more strings of up to MAX_LENGTH bytes */
+static int __nth_string(long i, char *str)
+{
+    const int n_letters = (int) strlen(ALPHABET);
+    long n_of_len = 1;
+    int len = 0, k;
+
+    while (i >= n_of_len)
+    {
+        i -= n_of_len;
+        n_of_len *= n_letters;
+        if (++len > MAX_LENGTH)  return -1;
+    }
+
+    for (k = len - 1; k >= 0; k--)
+    {
+        str[k] = ALPHABET[i % n_letters];
+        i /= n_letters;
+    }
+    str[len] = '\0';
+    return len;
+}
+
+/* Find the leftmost-longest match in str by the Thompson simulation of every
+ * substring, it returns 1 and stores its offsets, or 0 if there's none */
+static int __reference_search(const struct NFA *nfa, const char *str,
+    int len, size_t *start, size_t *end)
+{
+    char sub[MAX_LENGTH + 1];
+    int i, j;
+
+    for (i = 0; i <= len; i++)
+    {
+        for (j = len; j >= i; j--)
+        {
+            memcpy(sub, str + i, j - i);
+            sub[j - i] = '\0';
+            if (!NFA_pattern_match(nfa, sub))  continue;
+
+            *start = i;
+            *end   = j;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Find the earliest end of a match in str by the Thompson simulation, it
+ * returns it, or -1 if nothing in str matches */
+static long __reference_earliest_end(const struct NFA *nfa, const char *str,
+    int len)
+{
+    char sub[MAX_LENGTH + 1];
+    int i, j;
+
+    for (j = 0; j <= len; j++)
+    {
+        for (i = 0; i <= j; i++)
+        {
+            memcpy(sub, str + i, j - i);
+            sub[j - i] = '\0';
+            if (NFA_pattern_match(nfa, sub))  return j;
+        }
+    }
+
+    return -1;
+}
+
+
+/* Every engine compiled from one regexp */
+struct __engines
+{
+    const char *regexp;
+    struct NFA nfa, reduced;
+    struct DFA_table table, subset, derivative, containing;
+    struct lazy_DFA lazy, tiny_lazy;
+    struct glushkov_NFA glushkov;
+    struct DFA_searcher searcher;
+    struct reviz_pattern *reviz, *reviz_lazy, *reviz_bits;
+    struct reviz_scratch *scratch;
+};
+
+/* Compile the DFA to a table and dispose it */
+static void __compile_table(struct DFA *dfa, struct DFA_table *table)
+{
+    DFA_compile(dfa, table);
+    DFA_dispose(dfa);
+}
+
+static void __create_engines(const char *regexp, struct __engines *e)
+{
+    struct compile_budget one_state = {0, 1, 0};
+    struct NFA reversed, copy, containing;
+    struct DFA *dfa;
+
+    e->regexp = regexp;
+    e->nfa = reg_to_NFA(regexp);
+    e->reduced = NFA_duplicate(&e->nfa);
+    NFA_reduce(&e->reduced);
+
+    dfa = NFA_to_DFA(&e->nfa);
+    __compile_table(DFA_optimize(dfa), &e->table);
+    __compile_table(dfa, &e->subset);
+    __compile_table(regs_to_DFA_by_derivatives(&regexp, 1), &e->derivative);
+
+    /* NFA_containing grows the NFA it's given, so it's given a copy */
+    copy = NFA_duplicate(&e->nfa);
+    containing = NFA_containing(&copy);
+    __compile_table(NFA_to_DFA(&containing), &e->containing);
+    NFA_dispose(&containing);
+
+    /* the tiny cache is flushed all the time, and falls back to simulating
+     * the NFA */
+    create_lazy_DFA(&e->nfa, LAZY_DFA_DEFAULT_MEMORY, &e->lazy);
+    create_lazy_DFA(&e->nfa, 0, &e->tiny_lazy);
+    create_glushkov_NFA(&e->nfa, &e->glushkov);
+
+    reversed = reg_to_reversed_NFA(regexp);
+    create_DFA_searcher(&e->reduced, &reversed, DFA_LEFTMOST_LONGEST,
+        &e->searcher);
+    NFA_dispose(&reversed);
+
+    reviz_compile(&regexp, 1, NULL, 0, &e->reviz);
+    reviz_compile(&regexp, 1, &one_state, REVIZ_LAZY_FALLBACK,
+        &e->reviz_lazy);
+    e->scratch = reviz_create_scratch(e->reviz_lazy);
+    reviz_compile(&regexp, 1, NULL, REVIZ_BIT_PARALLEL, &e->reviz_bits);
+    __check("reviz-bits", regexp, "", 0,
+        reviz_is_bit_parallel(e->reviz_bits), 1);
+}
+
+static void __destroy_engines(struct __engines *e)
+{
+    reviz_free_scratch(e->scratch);
+    reviz_free(e->reviz);
+    reviz_free(e->reviz_lazy);
+    reviz_free(e->reviz_bits);
+    destroy_DFA_searcher(&e->searcher);
+    destroy_glushkov_NFA(&e->glushkov);
+    destroy_lazy_DFA(&e->lazy);
+    destroy_lazy_DFA(&e->tiny_lazy);
+    DFA_table_dispose(&e->table);
+    DFA_table_dispose(&e->subset);
+    DFA_table_dispose(&e->derivative);
+    DFA_table_dispose(&e->containing);
+    NFA_dispose(&e->nfa);
+    NFA_dispose(&e->reduced);
+}
+
+/* Match the whole input by every engine taking a length */
+static void __check_match(struct __engines *e, const char *str, size_t len,
+    int expected)
+{
+    struct DFA_stream stream;
+    const int *ids;
+    size_t i;
+
+    __check("table", e->regexp, str, len,
+        DFA_match(&e->table, str, len), expected);
+    __check("subset", e->regexp, str, len,
+        DFA_match(&e->subset, str, len), expected);
+    __check("derivative", e->regexp, str, len,
+        DFA_match(&e->derivative, str, len), expected);
+    __check("parallel", e->regexp, str, len,
+        DFA_parallel_match(&e->table, str, len, 2), expected);
+    __check("lazy", e->regexp, str, len,
+        lazy_DFA_match(&e->lazy, str, len), expected);
+    __check("lazy-tiny", e->regexp, str, len,
+        lazy_DFA_match(&e->tiny_lazy, str, len), expected);
+    __check("glushkov", e->regexp, str, len,
+        glushkov_NFA_match(&e->glushkov, str, len), expected);
+    __check("reviz", e->regexp, str, len,
+        reviz_match(e->reviz, NULL, str, len), expected);
+    __check("reviz-lazy", e->regexp, str, len,
+        reviz_match(e->reviz_lazy, e->scratch, str, len), expected);
+    __check("reviz-bits", e->regexp, str, len,
+        reviz_match(e->reviz_bits, NULL, str, len), expected);
+    __check("reviz-bits-patterns", e->regexp, str, len,
+        reviz_match_patterns(e->reviz_bits, str, len, &ids), expected);
+
+    /* the stream is fed a byte at a time */
+    DFA_stream_init(&stream, &e->table);
+    for (i = 0; i < len; i++)  DFA_stream_feed(&stream, str + i, 1);
+    __check("stream", e->regexp, str, len,
+        DFA_stream_finish(&stream), expected);
+}
+
+/* Search the input by every searching engine */
+static void __check_search(struct __engines *e, const char *str, int len)
+{
+    struct DFA_stream stream;
+    size_t start = 0, end = 0, ref_start = 0, ref_end = 0, glushkov_end = 0;
+    int is_found, i;
+
+    is_found = __reference_search(&e->nfa, str, len, &ref_start, &ref_end);
+
+    __check("searcher", e->regexp, str, len,
+        DFA_searcher_find(&e->searcher, str, len, &start, &end), is_found);
+    if (is_found)
+    {
+        __check("searcher-start", e->regexp, str, len, start, ref_start);
+        __check("searcher-end", e->regexp, str, len, end, ref_end);
+    }
+
+    __check("reviz-search", e->regexp, str, len,
+        reviz_search(e->reviz, str, len, &start, &end), is_found);
+    if (is_found)
+    {
+        __check("reviz-search-start", e->regexp, str, len, start, ref_start);
+        __check("reviz-search-end", e->regexp, str, len, end, ref_end);
+    }
+
+    __check("contains", e->regexp, str, len,
+        DFA_parallel_match(&e->containing, str, len, 2), is_found);
+
+    /* the forward table of the searcher fed a byte at a time finds the end
+     * of the match across the chunks */
+    DFA_stream_init(&stream, &e->searcher.forward);
+    for (i = 0; i < len; i++)  DFA_stream_feed(&stream, str + i, 1);
+    __check("stream-search", e->regexp, str, len,
+        stream.is_matched ? (long) stream.match_end : -1,
+        is_found ? (long) ref_end : -1);
+
+    __check("glushkov-search", e->regexp, str, len,
+        glushkov_NFA_search(&e->glushkov, str, len, &glushkov_end) ?
+            (long) glushkov_end : -1,
+        __reference_earliest_end(&e->nfa, str, len));
+}
+
+static void __test_regexp(const char *regexp)
+{
+    struct __engines e;
+    char str[MAX_LENGTH + 1];
+    long i;
+    int len, expected;
+
+    __create_engines(regexp, &e);
+    for (i = 0; (len = __nth_string(i, str)) != -1; i++)
+    {
+        expected = NFA_pattern_match(&e.nfa, str);
+        __check("reduced", regexp, str, len,
+            NFA_pattern_match(&e.reduced, str), expected);
+        __check_match(&e, str, len, expected);
+        __check_search(&e, str, len);
+    }
+    __destroy_engines(&e);
+}
+
+static void __test_nul_case(const struct __nul_case *c)
+{
+    struct __engines e;
+
+    __create_engines(c->regexp, &e);
+    __check_match(&e, c->str, c->len, c->is_matched);
+    __destroy_engines(&e);
+}
+
+
+/* Check the patterns reported for the input against the ones whose NFA
+ * matches it, in ascending order */
+static void __check_patterns(const char *engine, const char *str, int len,
+    const int *ids, int n_ids, const int *expected, int n_expected)
+{
+    int i;
+
+    __check(engine, "set", str, len, n_ids, n_expected);
+    for (i = 0; i < n_ids && i < n_expected; i++)
+        __check(engine, "set", str, len, ids[i], expected[i]);
+}
+
+static void __test_pattern_set(const struct __pattern_set *ps)
+{
+    struct NFA nfas[MAX_PATTERNS];
+    struct NFA_set set;
+    struct DFA_table table, reduced, derivative;
+    struct reviz_pattern *reviz;
+    struct DFA *dfa;
+    char str[MAX_LENGTH + 1];
+    const int *ids;
+    int expected[MAX_PATTERNS], n_expected, n_ids, len, k;
+    long i;
+
+    for (k = 0; k < ps->n_regexps; k++)  nfas[k] = reg_to_NFA(ps->regexps[k]);
+
+    set = regs_to_NFA_set(ps->regexps, ps->n_regexps);
+    dfa = NFA_set_to_DFA(&set);
+    __compile_table(DFA_optimize(dfa), &table);
+    DFA_dispose(dfa);
+    NFA_set_reduce(&set);
+    dfa = NFA_set_to_DFA(&set);
+    __compile_table(DFA_optimize(dfa), &reduced);
+    DFA_dispose(dfa);
+    NFA_set_dispose(&set);
+    __compile_table(
+        regs_to_DFA_by_derivatives(ps->regexps, ps->n_regexps), &derivative);
+    reviz_compile(ps->regexps, ps->n_regexps, NULL, 0, &reviz);
+
+    for (i = 0; (len = __nth_string(i, str)) != -1; i++)
+    {
+        for (n_expected = k = 0; k < ps->n_regexps; k++)
+            if (NFA_pattern_match(nfas + k, str))  expected[n_expected++] = k;
+
+        n_ids = DFA_match_patterns(&table, str, len, &ids);
+        __check_patterns("set-table", str, len, ids, n_ids,
+            expected, n_expected);
+        n_ids = DFA_match_patterns(&reduced, str, len, &ids);
+        __check_patterns("set-reduced", str, len, ids, n_ids,
+            expected, n_expected);
+        n_ids = DFA_match_patterns(&derivative, str, len, &ids);
+        __check_patterns("set-derivative", str, len, ids, n_ids,
+            expected, n_expected);
+        n_ids = reviz_match_patterns(reviz, str, len, &ids);
+        __check_patterns("set-reviz", str, len, ids, n_ids,
+            expected, n_expected);
+    }
+
+    reviz_free(reviz);
+    DFA_table_dispose(&table);
+    DFA_table_dispose(&reduced);
+    DFA_table_dispose(&derivative);
+    for (k = 0; k < ps->n_regexps; k++)  NFA_dispose(nfas + k);
+}
+
+
+/* Write the input of the case to fd by a child process */
+static void __write_stream_input(const struct __stream_case *c, int fd)
+{
+    char buf[4096];
+    size_t n_left = c->n_fill, fill_len = strlen(c->fill), n;
+
+    /* the length of fill divides the size of buf */
+    for (n = 0; n < sizeof(buf); n++)  buf[n] = c->fill[n % fill_len];
+    while (n_left != 0)
+    {
+        n = n_left < sizeof(buf) ? n_left : sizeof(buf);
+        if (write(fd, buf, n) != (ssize_t) n)  _exit(1);
+        n_left -= n;
+    }
+    if (write(fd, c->tail, strlen(c->tail)) == -1)  _exit(1);
+    _exit(0);
+}
+
+/* Scan the offsets of a pipe, the peak of the memory usage is checked, so
+ * this runs before anything else */
+static void __test_stream_case(const struct __stream_case *c)
+{
+    struct NFA nfa, reversed;
+    struct DFA_searcher searcher;
+    char path[32];
+    FILE *fp = tmpfile();
+    size_t current;
+    long n_found, start = -1, end = -1;
+    int fds[2];
+    pid_t pid;
+
+    nfa = reg_to_NFA(c->regexp);
+    reversed = reg_to_reversed_NFA(c->regexp);
+    create_DFA_searcher(&nfa, &reversed, DFA_LEFTMOST_LONGEST, &searcher);
+    NFA_dispose(&nfa);
+    NFA_dispose(&reversed);
+
+    if (fp == NULL || pipe(fds) == -1 || (pid = fork()) == -1)
+    {
+        perror("test");
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        __write_stream_input(c, fds[1]);
+    }
+    close(fds[1]);
+
+    current = mem_get_usage()->current;
+    snprintf(path, sizeof(path), "/dev/fd/%d", fds[0]);
+    n_found = scan_file(&searcher, path, SCAN_OFFSETS, fp);
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+
+    rewind(fp);
+    if (fscanf(fp, "%ld %ld", &start, &end) != 2)  start = end = -1;
+    fclose(fp);
+
+    __check("stream", c->regexp, c->tail, strlen(c->tail), n_found, 1);
+    __check("stream-start", c->regexp, c->tail, strlen(c->tail),
+        start, c->start);
+    __check("stream-end", c->regexp, c->tail, strlen(c->tail), end, c->end);
+    if (c->max_growth != 0)
+        __check("stream-memory", c->regexp, c->tail, strlen(c->tail),
+            mem_get_usage()->peak - current <= c->max_growth, 1);
+
+    destroy_DFA_searcher(&searcher);
+}
+
+
+/* Malformed regexps come back as errors from every error-returning entry */
+static void __test_malformed(const char *regexp)
+{
+    struct reviz_pattern *reviz;
+    struct NFA nfa;
+    struct DFA *dfa;
+
+    __check("NFA-error", regexp, "", 0,
+        reg_to_NFA_within(regexp, NULL, &nfa) != COMPILE_OK, 1);
+    __check("derivative-error", regexp, "", 0,
+        regs_to_DFA_by_derivatives_within(&regexp, 1, NULL, &dfa) !=
+            COMPILE_OK, 1);
+    __check("reviz-error", regexp, "", 0,
+        reviz_compile(&regexp, 1, NULL, REVIZ_LAZY_FALLBACK, &reviz) !=
+            COMPILE_OK, 1);
+}
+
+/* A set of no regexps is rejected like a malformed regexp */
+static void __test_no_patterns(void)
+{
+    const char *regexp = "a";
+    struct reviz_pattern *reviz;
+    struct NFA_set set;
+    struct DFA *dfa;
+
+    __check("set-error", "", "", 0,
+        regs_to_NFA_set_within(&regexp, 0, NULL, &set), COMPILE_NO_PATTERNS);
+    __check("derivative-error", "", "", 0,
+        regs_to_DFA_by_derivatives_within(&regexp, 0, NULL, &dfa),
+        COMPILE_NO_PATTERNS);
+    __check("reviz-error", "", "", 0,
+        reviz_compile(&regexp, 0, NULL, 0, &reviz), COMPILE_NO_PATTERNS);
+    __check("reviz-error", "", "", 0,
+        reviz_compile(&regexp, -1, NULL, REVIZ_LAZY_FALLBACK, &reviz),
+        COMPILE_NO_PATTERNS);
+}
+
+
+int main(void)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(__stream_cases) / sizeof(__stream_cases[0]); i++)
+        __test_stream_case(__stream_cases + i);
+    for (i = 0; i < sizeof(__regexps) / sizeof(__regexps[0]); i++)
+        __test_regexp(__regexps[i]);
+    for (i = 0; i < sizeof(__nul_cases) / sizeof(__nul_cases[0]); i++)
+        __test_nul_case(__nul_cases + i);
+    for (i = 0; i < sizeof(__pattern_sets) / sizeof(__pattern_sets[0]); i++)
+        __test_pattern_set(__pattern_sets + i);
+    for (i = 0; i < sizeof(__malformed) / sizeof(__malformed[0]); i++)
+        __test_malformed(__malformed[i]);
+    __test_no_patterns();
+
+    printf("%d checks, %d failures\n", n_checks, n_failures);
+    return n_failures != 0;
+}